@@ -0,0 +1,20 @@
+#version 420 core
+
+flat in vec3 fColor;
+noperspective in vec2 fLocal;
+flat in float fLength;
+out vec4 FragColor;
+
+uniform float line_width;
+
+void main()
+{
+    /* Distance to the segment in pixels: a capsule, so the round caps of consecutive segments make round joins.
+       Coverage falls off over one pixel at its border */
+    float distance = length(vec2(fLocal.x - clamp(fLocal.x, 0.0, fLength), fLocal.y));
+    float coverage = clamp(line_width * 0.5 + 0.5 - distance, 0.0, 1.0);
+    if(coverage <= 0.0){
+        discard;
+    }
+    FragColor = vec4(fColor, coverage);
+}
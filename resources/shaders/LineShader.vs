@@ -0,0 +1,131 @@
+#version 420 core
+/* One instance per segment: the start and the end vertex are the same buffer read one vertex apart */
+layout (location = 0) in vec3 aStart;
+layout (location = 2) in vec3 aEnd;
+/* Color of the stroke, alpha is 0 for the last vertex of a strip(no segment starts there) */
+layout (location = 1) in vec4 aStyle;
+
+flat out vec3 fColor;
+/* Fragment position in pixels: along the segment from its start, and across it from its axis */
+noperspective out vec2 fLocal;
+flat out float fLength;
+
+uniform mat4 world_t;
+
+/* Per-frame camera matrices shared by all programs, see Renderer::CameraUniforms */
+layout (std140, binding = 0) uniform Camera{
+    mat4 view_t;
+    mat4 projection_t;
+};
+
+/* Size of the viewport in pixels and the line width in pixels */
+uniform vec2 viewport;
+uniform float line_width;
+
+/* 0 - sphere(as drawn), 1 - cylinder, 2 - unfolded plane, the same mapping as UnfoldShader.vs/.gs */
+uniform int unfold_mode;
+uniform float s_radius;
+uniform float camera_y_shift;
+
+const float PI = 3.14159265358;
+
+/* Two triangles per quad: which end of the segment and which side of its axis every corner is on */
+const vec2 corners[6] = vec2[](vec2(0.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(0.0, -1.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+vec3 toCylinder(vec3 position){
+    float xz_distance = length(position.xz);
+    float y_angle = degrees(asin(clamp((position.y - camera_y_shift) / s_radius, -1.0, 1.0)));
+    return vec3(position.x / xz_distance * s_radius,
+                PI * s_radius / 2.0 * y_angle / 90.0 + camera_y_shift,
+                position.z / xz_distance * s_radius);
+}
+
+vec3 projectPoint(vec3 position){
+    if(unfold_mode != 2){
+        return position;
+    }
+    float z_asin = asin(clamp(-position.z / s_radius, -1.0, 1.0));
+    position.x = position.x >= 0.0 ? PI / 2.0 - z_asin : -PI / 2.0 + z_asin;
+    position.z = -s_radius;
+    return position;
+}
+
+void collapse(){
+    /* Every corner at the same point: the triangles have no area and are dropped */
+    gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    fColor = vec3(0.0);
+    fLocal = vec2(0.0);
+    fLength = 0.0;
+}
+
+void main(){
+    int quad = gl_VertexID / 6;
+    vec2 corner = corners[gl_VertexID % 6];
+    if(aStyle.a < 0.5){
+        collapse();
+        return;
+    }
+
+    vec3 start = aStart, end = aEnd;
+    if(unfold_mode >= 1){
+        start = toCylinder(start);
+        end = toCylinder(end);
+
+        /* A segment crossing the seam on the back side is cut there: the first quad ends on one edge of the
+           unfolded plane, the second one starts on the other edge */
+        if(end.z > 0.00001 && (start.x < 0.0) != (end.x < 0.0)){
+            float z_inter = -end.x * (start.z - end.z) / (start.x - end.x) + end.z;
+            float y_inter = -end.x * (start.y - end.y) / (start.x - end.x) + end.y;
+            float seam_x = start.x < 0.0 ? -0.000001 : 0.000001;
+            if(quad == 0){
+                end = vec3(seam_x, y_inter, z_inter);
+            }
+            else{
+                start = vec3(-seam_x, y_inter, z_inter);
+            }
+        }
+        else if(quad == 1){
+            collapse();
+            return;
+        }
+        start = projectPoint(start);
+        end = projectPoint(end);
+    }
+    else if(quad == 1){
+        collapse();
+        return;
+    }
+
+    /* Cut at the near plane(z = -w in clip space), the screen position of a point behind the camera is meaningless */
+    vec4 clip_start = projection_t * view_t * world_t * vec4(start, 1.0);
+    vec4 clip_end = projection_t * view_t * world_t * vec4(end, 1.0);
+    float near_start = clip_start.z + clip_start.w, near_end = clip_end.z + clip_end.w;
+    if(near_start < 0.0 && near_end < 0.0){
+        collapse();
+        return;
+    }
+    if(near_start < 0.0){
+        clip_start = mix(clip_start, clip_end, near_start / (near_start - near_end));
+    }
+    else if(near_end < 0.0){
+        clip_end = mix(clip_start, clip_end, near_start / (near_start - near_end));
+    }
+
+    /* The quad covers the segment with a half width(plus a pixel for anti-aliasing) of margin around it, caps included */
+    vec2 half_viewport = viewport * 0.5;
+    vec2 screen_start = clip_start.xy / clip_start.w * half_viewport;
+    vec2 screen_end = clip_end.xy / clip_end.w * half_viewport;
+    vec2 axis = screen_end - screen_start;
+    float axis_length = length(axis);
+    vec2 direction = axis_length > 0.0001 ? axis / axis_length : vec2(1.0, 0.0);
+    vec2 normal = vec2(-direction.y, direction.x);
+    float reach = line_width * 0.5 + 1.0;
+
+    vec4 clip = corner.x == 0.0 ? clip_start : clip_end;
+    vec2 screen = (corner.x == 0.0 ? screen_start - direction * reach : screen_end + direction * reach) + normal * corner.y * reach;
+    gl_Position = vec4(screen / half_viewport * clip.w, clip.z, clip.w);
+
+    fColor = aStyle.rgb;
+    fLocal = vec2(corner.x == 0.0 ? -reach : axis_length + reach, corner.y * reach);
+    fLength = axis_length;
+}
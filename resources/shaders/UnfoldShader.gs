@@ -0,0 +1,61 @@
+#version 420 core
+layout (lines) in;
+layout (line_strip, max_vertices = 4) out;
+
+in vec3 gPos[];
+in vec3 gColor[];
+
+out vec3 fColor;
+
+uniform mat4 world_t;
+
+/* Per-frame camera matrices shared by all programs, see Renderer::CameraUniforms */
+layout (std140, binding = 0) uniform Camera{
+    mat4 view_t;
+    mat4 projection_t;
+};
+
+uniform int unfold_mode;
+uniform float s_radius;
+
+const float PI = 3.14159265358;
+
+/* Cylinder -> plane z = -s_radius */
+vec3 projectPoint(vec3 position){
+    if(unfold_mode != 2){
+        return position;
+    }
+    float z_asin = asin(clamp(-position.z / s_radius, -1.0, 1.0));
+    position.x = position.x >= 0.0 ? PI / 2.0 - z_asin : -PI / 2.0 + z_asin;
+    position.z = -s_radius;
+    return position;
+}
+
+void emitPoint(vec3 position, vec3 color){
+    gl_Position = projection_t * view_t * world_t * vec4(projectPoint(position), 1.0f);
+    fColor = color;
+    EmitVertex();
+}
+
+void main(){
+    vec3 prev = gPos[0], curr = gPos[1];
+
+    /* A segment crossing the x = 0 seam on the back side would span the whole plane: it is cut at the seam,
+       both halves end on their own edge of the unfolded plane */
+    if(unfold_mode >= 1 && curr.z > 0.00001 && (prev.x < 0.0) != (curr.x < 0.0)){
+        float z_inter = -curr.x * (prev.z - curr.z) / (prev.x - curr.x) + curr.z;
+        float y_inter = -curr.x * (prev.y - curr.y) / (prev.x - curr.x) + curr.y;
+        float seam_x = prev.x < 0.0 ? -0.000001 : 0.000001;
+
+        emitPoint(prev, gColor[0]);
+        emitPoint(vec3(seam_x, y_inter, z_inter), gColor[0]);
+        EndPrimitive();
+        emitPoint(vec3(-seam_x, y_inter, z_inter), gColor[0]);
+        emitPoint(curr, gColor[1]);
+        EndPrimitive();
+        return;
+    }
+    emitPoint(prev, gColor[0]);
+    emitPoint(curr, gColor[1]);
+    EndPrimitive();
+}
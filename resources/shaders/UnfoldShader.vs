@@ -0,0 +1,27 @@
+#version 420 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+
+out vec3 gPos;
+out vec3 gColor;
+
+/* 0 - sphere(as drawn), 1 - cylinder, 2 - unfolded plane, the same mapping as Geometry/SphereUnfold.cpp */
+uniform int unfold_mode;
+uniform float s_radius;
+uniform float camera_y_shift;
+
+const float PI = 3.14159265358;
+
+void main(){
+    vec3 position = aPos;
+    if(unfold_mode >= 1){
+        /* Sphere -> cylinder: the direction in the xz plane is kept, latitude becomes the arc length height */
+        float xz_distance = length(position.xz);
+        float y_angle = degrees(asin(clamp((position.y - camera_y_shift) / s_radius, -1.0, 1.0)));
+        position = vec3(position.x / xz_distance * s_radius,
+                        PI * s_radius / 2.0 * y_angle / 90.0 + camera_y_shift,
+                        position.z / xz_distance * s_radius);
+    }
+    gPos = position;
+    gColor = aColor;
+}
@@ -5,8 +5,12 @@ layout (location = 1) in vec3 aColor;
 out vec3 fColor;  
 
 uniform mat4 world_t;
-uniform mat4 view_t;
-uniform mat4 projection_t;
+
+/* Per-frame camera matrices shared by all programs, see Renderer::CameraUniforms */
+layout (std140, binding = 0) uniform Camera{
+    mat4 view_t;
+    mat4 projection_t;
+};
 
 void main(){
     gl_Position = projection_t * view_t * world_t * vec4(aPos, 1.0f); 
@@ -0,0 +1,22 @@
+#include "ImageWriter.h"
+
+#include <iostream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace Export{
+    bool writePng(const std::string& filePath, int width, int height, int channels, const void* pixels, int stride, bool flip_vertically){
+        const unsigned char* first_row = static_cast<const unsigned char*>(pixels);
+        if(flip_vertically){
+            first_row += (size_t)stride * (height - 1);
+            stride = -stride;
+        }
+
+        if(!stbi_write_png(filePath.c_str(), width, height, channels, first_row, stride)){
+            std::cerr << "Failed to write image: " << filePath << "\n";
+            return false;
+        }
+        return true;
+    }
+}
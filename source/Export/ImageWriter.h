@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+namespace Export{
+    /*
+        Writes 8-bit pixels into a PNG file. Vertical flip is done through a negative row stride,
+        so no global stb state is touched and the function can be called from several threads.
+    */
+    bool writePng(const std::string& filePath, int width, int height, int channels, const void* pixels, int stride, bool flip_vertically = false);
+}
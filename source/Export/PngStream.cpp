@@ -0,0 +1,245 @@
+#include "PngStream.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Export{
+    static const size_t IDAT_CHUNK_SIZE = 1 << 16;
+
+    static const uint16_t LENGTH_BASE[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const uint8_t LENGTH_EXTRA[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+
+    static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size){
+        static uint32_t table[256] = {};
+        static bool table_ready = [](){
+            for(uint32_t n = 0; n < 256; ++n){
+                uint32_t c = n;
+                for(int k = 0; k < 8; ++k){
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return true;
+        }();
+        (void)table_ready;
+
+        crc = ~crc;
+        for(size_t i = 0; i < size; ++i){
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    static void putBigEndian(unsigned char* out, uint32_t value){
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+
+    PngStreamWriter::~PngStreamWriter(){
+        if(file){
+            abort();
+        }
+    }
+    bool PngStreamWriter::open(const std::string& filePath, int width, int height, int channels){
+        if(file || width <= 0 || height <= 0 || (channels != 3 && channels != 4)){
+            return false;
+        }
+        file = std::fopen(filePath.c_str(), "wb");
+        if(!file){
+            std::cerr << "Failed to open image for writing: " << filePath << "\n";
+            return false;
+        }
+        file_path = filePath;
+        this->width = width;
+        this->height = height;
+        this->channels = channels;
+        rows_written = 0;
+        failed = false;
+        bit_buffer = 0;
+        bit_count = 0;
+        adler_a = 1;
+        adler_b = 0;
+        idat.clear();
+        filtered.resize((size_t)width * channels + 1);
+
+        static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        std::fwrite(signature, 1, sizeof(signature), file);
+
+        unsigned char header[13];
+        putBigEndian(header, (uint32_t)width);
+        putBigEndian(header + 4, (uint32_t)height);
+        header[8] = 8;
+        header[9] = channels == 4 ? 6 : 2;
+        header[10] = header[11] = header[12] = 0;
+        writeChunk("IHDR", header, sizeof(header));
+
+        /* zlib header: deflate with a 32K window, no preset dictionary */
+        idat.push_back(0x78);
+        idat.push_back(0x01);
+        return !failed;
+    }
+    bool PngStreamWriter::writeRows(const unsigned char* rows, int count, int stride){
+        if(!file || failed || count <= 0 || rows_written + count > height){
+            return false;
+        }
+
+        /* Non-final block with fixed Huffman codes */
+        putBits(0, 1);
+        putBits(1, 2);
+
+        size_t row_size = (size_t)width * channels;
+        for(int row = 0; row < count; ++row, rows += stride){
+            /* "Sub" filter: every byte minus the same channel of the pixel on the left */
+            filtered[0] = 1;
+            for(size_t i = 0; i < row_size; ++i){
+                filtered[i + 1] = (unsigned char)(rows[i] - (i >= (size_t)channels ? rows[i - channels] : 0));
+            }
+
+            /* Adler-32 of the uncompressed stream, reduced often enough to never overflow */
+            for(size_t done = 0; done < filtered.size();){
+                size_t block = std::min<size_t>(5552, filtered.size() - done);
+                for(size_t i = 0; i < block; ++i){
+                    adler_a += filtered[done + i];
+                    adler_b += adler_a;
+                }
+                adler_a %= 65521;
+                adler_b %= 65521;
+                done += block;
+            }
+
+            /* Runs of an equal byte become matches at distance 1, everything else goes as literals */
+            for(size_t i = 0; i < filtered.size();){
+                unsigned char value = filtered[i];
+                size_t run_end = i + 1;
+                while(run_end < filtered.size() && filtered[run_end] == value){
+                    ++run_end;
+                }
+                putLiteral(value);
+                size_t repeats = run_end - i - 1;
+                while(repeats >= 3){
+                    int length = (int)std::min<size_t>(repeats, 258);
+                    putMatch(length);
+                    repeats -= length;
+                }
+                while(repeats-- > 0){
+                    putLiteral(value);
+                }
+                i = run_end;
+            }
+            flushIdat(false);
+        }
+
+        /* End of block */
+        putCode(0, 7);
+        rows_written += count;
+        return !failed;
+    }
+    bool PngStreamWriter::close(){
+        if(!file){
+            return false;
+        }
+        if(rows_written != height){
+            std::cerr << "Image is incomplete(" << rows_written << " of " << height << " rows): " << file_path << "\n";
+            abort();
+            return false;
+        }
+
+        /* Empty final block, then the Adler-32 checksum of the zlib stream */
+        putBits(1, 1);
+        putBits(1, 2);
+        putCode(0, 7);
+        alignToByte();
+        unsigned char adler[4];
+        putBigEndian(adler, (adler_b << 16) | adler_a);
+        idat.insert(idat.end(), adler, adler + 4);
+        flushIdat(true);
+
+        writeChunk("IEND", nullptr, 0);
+        bool ok = !failed && std::fclose(file) == 0;
+        file = nullptr;
+        if(!ok){
+            std::cerr << "Failed to write image: " << file_path << "\n";
+        }
+        return ok;
+    }
+    void PngStreamWriter::putBits(uint32_t bits, int count){
+        bit_buffer |= (uint64_t)bits << bit_count;
+        bit_count += count;
+        while(bit_count >= 8){
+            idat.push_back((unsigned char)bit_buffer);
+            bit_buffer >>= 8;
+            bit_count -= 8;
+        }
+    }
+    void PngStreamWriter::putCode(uint32_t code, int length){
+        /* Huffman codes are stored starting from the most significant bit */
+        uint32_t reversed = 0;
+        for(int i = 0; i < length; ++i){
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        putBits(reversed, length);
+    }
+    void PngStreamWriter::putLiteral(unsigned char literal){
+        if(literal < 144){
+            putCode(0x30 + literal, 8);
+        }
+        else{
+            putCode(0x190 + literal - 144, 9);
+        }
+    }
+    void PngStreamWriter::putMatch(int length){
+        int index = 28;
+        while(LENGTH_BASE[index] > length){
+            --index;
+        }
+        int symbol = 257 + index;
+        if(symbol < 280){
+            putCode(symbol - 256, 7);
+        }
+        else{
+            putCode(0xC0 + symbol - 280, 8);
+        }
+        putBits(length - LENGTH_BASE[index], LENGTH_EXTRA[index]);
+
+        /* Distance 1 is code 0 */
+        putCode(0, 5);
+    }
+    void PngStreamWriter::alignToByte(){
+        if(bit_count > 0){
+            putBits(0, 8 - bit_count);
+        }
+    }
+    void PngStreamWriter::flushIdat(bool force){
+        if(idat.size() >= IDAT_CHUNK_SIZE || (force && !idat.empty())){
+            writeChunk("IDAT", idat.data(), idat.size());
+            idat.clear();
+        }
+    }
+    void PngStreamWriter::writeChunk(const char type[4], const unsigned char* data, size_t size){
+        unsigned char length[4], crc[4];
+        putBigEndian(length, (uint32_t)size);
+        uint32_t chunk_crc = crc32(0, reinterpret_cast<const unsigned char*>(type), 4);
+        if(size > 0){
+            chunk_crc = crc32(chunk_crc, data, size);
+        }
+        putBigEndian(crc, chunk_crc);
+
+        bool ok = std::fwrite(length, 1, 4, file) == 4 && std::fwrite(type, 1, 4, file) == 4;
+        ok = ok && (size == 0 || std::fwrite(data, 1, size, file) == size);
+        ok = ok && std::fwrite(crc, 1, 4, file) == 4;
+        failed = failed || !ok;
+    }
+    void PngStreamWriter::abort(){
+        std::fclose(file);
+        file = nullptr;
+        std::remove(file_path.c_str());
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Export{
+    /*
+        PNG writer that takes the image in bands of rows, so the whole picture never has to be in memory.
+        Every band becomes its own deflate block(fixed Huffman codes, runs of equal bytes after the "Sub"
+        filter are coded as matches), which suits renders with large flat areas well enough.
+    */
+    class PngStreamWriter{
+    public:
+        PngStreamWriter() = default;
+        ~PngStreamWriter();
+
+        PngStreamWriter(const PngStreamWriter&) = delete;
+        PngStreamWriter& operator=(const PngStreamWriter&) = delete;
+
+        /* channels is 3(RGB) or 4(RGBA) */
+        bool open(const std::string& filePath, int width, int height, int channels = 3);
+
+        /* Appends rows from top to bottom */
+        bool writeRows(const unsigned char* rows, int count, int stride);
+
+        /* Finishes the file, fails if not all rows were written */
+        bool close();
+
+        bool isOpen() const { return file != nullptr; }
+        int getRowsWritten() const { return rows_written; }
+
+    private:
+        std::FILE* file = nullptr;
+        std::string file_path;
+        int width = 0, height = 0, channels = 3, rows_written = 0;
+        bool failed = false;
+
+        std::vector<unsigned char> filtered, idat;
+        uint64_t bit_buffer = 0;
+        int bit_count = 0;
+        uint32_t adler_a = 1, adler_b = 0;
+
+        void putBits(uint32_t bits, int count);
+        void putCode(uint32_t code, int length);
+        void putLiteral(unsigned char literal);
+        void putMatch(int length);
+        void alignToByte();
+        void flushIdat(bool force);
+        void writeChunk(const char type[4], const unsigned char* data, size_t size);
+        void abort();
+    };
+}
@@ -0,0 +1,86 @@
+#include "SoftwareRaster.h"
+#include "../Geometry/SphereUnfold.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Export{
+    SoftwareRaster::SoftwareRaster(int width, int height) : center_y(Geometry::camera_y_shift), width(width), height(height){
+        pixels.assign((size_t)width * height * 3, 0);
+    }
+
+    void SoftwareRaster::clear(unsigned char r, unsigned char g, unsigned char b){
+        for(size_t i = 0; i < pixels.size(); i += 3){
+            pixels[i] = r;
+            pixels[i + 1] = g;
+            pixels[i + 2] = b;
+        }
+    }
+
+    void SoftwareRaster::drawStrips(const std::vector<std::vector<double>>& strips, size_t first_strip){
+        const double aspect = (double)width / (double)height;
+        const double half_w = 0.5 * width, half_h = 0.5 * height;
+
+        /* Same mapping as glm::ortho(-aspect * scale, aspect * scale, -scale, scale) seen from (0, center_y, 0) */
+        auto toPixelX = [&](double x){ return (x / (aspect * ortho_scale) + 1.0) * half_w; };
+        auto toPixelY = [&](double y){ return (1.0 - (y - center_y) / ortho_scale) * half_h; };
+
+        for(size_t strip_num = first_strip; strip_num < strips.size(); ++strip_num){
+            const std::vector<double>& strip = strips[strip_num];
+            for(size_t v_num = 0; v_num < strip.size(); v_num += Geometry::VERTEX_STRIDE){
+                unsigned char color[3];
+                for(int c = 0; c < 3; ++c){
+                    color[c] = (unsigned char)std::lround(std::clamp(strip[v_num + 3 + c], 0.0, 1.0) * 255.0);
+                }
+
+                double px = toPixelX(strip[v_num]), py = toPixelY(strip[v_num + 1]);
+                if(v_num == 0){
+                    stamp(px, py, color);
+                }
+                else{
+                    drawSegment(toPixelX(strip[v_num - 6]), toPixelY(strip[v_num - 5]), px, py, color);
+                }
+            }
+        }
+    }
+
+    void SoftwareRaster::drawSegment(double x0, double y0, double x1, double y1, const unsigned char color[3]){
+        double dx = x1 - x0, dy = y1 - y0, length = std::max(std::fabs(dx), std::fabs(dy));
+        if(!std::isfinite(length) || length > 4.0 * (width + height)){
+            /* Skip degenerate segments(NaN vertices or far outside of the frame) */
+            return;
+        }
+        int steps = (int)std::ceil(length);
+        for(int step = 1; step <= steps; ++step){
+            double t = (double)step / steps;
+            stamp(x0 + dx * t, y0 + dy * t, color);
+        }
+    }
+
+    void SoftwareRaster::stamp(double px, double py, const unsigned char color[3]){
+        const double radius = 0.5 * line_width;
+        if(!(px + radius >= 0.0 && py + radius >= 0.0 && px - radius < width && py - radius < height)){
+            /* Outside of the image(or NaN) */
+            return;
+        }
+        int x_min = (int)std::floor(px - radius), x_max = (int)std::ceil(px + radius);
+        int y_min = (int)std::floor(py - radius), y_max = (int)std::ceil(py + radius);
+        x_min = std::max(x_min, 0);
+        y_min = std::max(y_min, 0);
+        x_max = std::min(x_max, width - 1);
+        y_max = std::min(y_max, height - 1);
+
+        for(int y = y_min; y <= y_max; ++y){
+            double cy = y + 0.5 - py;
+            for(int x = x_min; x <= x_max; ++x){
+                double cx = x + 0.5 - px;
+                if(cx * cx + cy * cy <= radius * radius){
+                    unsigned char* pixel = pixels.data() + ((size_t)y * width + x) * 3;
+                    pixel[0] = color[0];
+                    pixel[1] = color[1];
+                    pixel[2] = color[2];
+                }
+            }
+        }
+    }
+}
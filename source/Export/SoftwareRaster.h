@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace Export{
+    /*
+        Minimal CPU rasterizer for unfolded drawings. It reproduces the orthographic "photo" the interactive
+        drawer takes after unfolding(same frustum, camera height and line width), but needs no GL context,
+        so batch jobs can run on machines without a display or a GPU.
+    */
+    class SoftwareRaster{
+    public:
+        SoftwareRaster(int width, int height);
+
+        void clear(unsigned char r, unsigned char g, unsigned char b);
+
+        /* Draws strips of interleaved XYZRGB doubles as line strips, Z is ignored */
+        void drawStrips(const std::vector<std::vector<double>>& strips, size_t first_strip = 0);
+
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+        int getStride() const { return width * 3; }
+
+        /* Rows are stored from top to bottom, RGB, without padding */
+        const unsigned char* data() const { return pixels.data(); }
+
+        float line_width = 3.0f;
+        float ortho_scale = 1.9f;
+        double center_y;
+
+    private:
+        int width, height;
+        std::vector<unsigned char> pixels;
+
+        void drawSegment(double x0, double y0, double x1, double y1, const unsigned char color[3]);
+        void stamp(double px, double py, const unsigned char color[3]);
+    };
+}
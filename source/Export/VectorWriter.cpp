@@ -0,0 +1,183 @@
+#include "VectorWriter.h"
+#include "../Geometry/StrokeBuffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace Export{
+    static int colorByte(float value){
+        return (int)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    bool writeSvg(const std::string& filePath, const Geometry::StrokeBuffer& strokes, const SvgOptions& options){
+        FILE* file = std::fopen(filePath.c_str(), "wb");
+        if(!file){
+            std::cerr << "Failed to create SVG file: " << filePath << "\n";
+            return false;
+        }
+
+        /* The view box is the bounding box of the strokes with a small margin, y is flipped by the group transform */
+        float min_x = std::numeric_limits<float>::max(), min_y = min_x, max_x = -min_x, max_y = -min_x;
+        for(size_t v_num = 0; v_num < strokes.vertexCount(); ++v_num){
+            min_x = std::min(min_x, strokes.x[v_num]);
+            max_x = std::max(max_x, strokes.x[v_num]);
+            min_y = std::min(min_y, strokes.y[v_num]);
+            max_y = std::max(max_y, strokes.y[v_num]);
+        }
+        if(strokes.vertexCount() == 0){
+            min_x = min_y = -1.0f;
+            max_x = max_y = 1.0f;
+        }
+        float margin = 0.02f * std::max(std::max(max_x - min_x, max_y - min_y), 1e-3f);
+        min_x -= margin;
+        min_y -= margin;
+        max_x += margin;
+        max_y += margin;
+
+        std::fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"%.7g %.7g %.7g %.7g\">\n",
+                     min_x, -max_y, max_x - min_x, max_y - min_y);
+        if(options.background){
+            std::fprintf(file, "<rect x=\"%.7g\" y=\"%.7g\" width=\"%.7g\" height=\"%.7g\" fill=\"#000000\"/>\n",
+                         min_x, -max_y, max_x - min_x, max_y - min_y);
+        }
+        std::fprintf(file, "<g transform=\"scale(1,-1)\" fill=\"none\" stroke-width=\"%.7g\" stroke-linejoin=\"round\" stroke-linecap=\"round\">\n",
+                     options.line_width);
+
+        /* Points are formatted into one buffer per stroke and written at once */
+        std::string line;
+        char number[128];
+        for(size_t stroke = 0; stroke < strokes.strokeCount(); ++stroke){
+            size_t begin = strokes.strokeBegin(stroke), end = begin + strokes.strokeSize(stroke);
+            if(begin == end){
+                continue;
+            }
+            const Geometry::StrokeColor& color = strokes.colors[stroke];
+            std::snprintf(number, sizeof(number), "<polyline stroke=\"#%02x%02x%02x\" vector-effect=\"non-scaling-stroke\" points=\"",
+                          colorByte(color.r), colorByte(color.g), colorByte(color.b));
+            line = number;
+            for(size_t v_num = begin; v_num < end; ++v_num){
+                int length = std::snprintf(number, sizeof(number), v_num + 1 < end ? "%.7g,%.7g " : "%.7g,%.7g", strokes.x[v_num], strokes.y[v_num]);
+                line.append(number, length);
+            }
+            line += "\"/>\n";
+            std::fwrite(line.data(), 1, line.size(), file);
+        }
+        std::fputs("</g>\n</svg>\n", file);
+
+        bool ok = std::ferror(file) == 0;
+        ok = std::fclose(file) == 0 && ok;
+        if(!ok){
+            std::cerr << "Failed to write SVG file: " << filePath << "\n";
+        }
+        return ok;
+    }
+
+    static void putUint32(std::vector<unsigned char>& out, uint32_t value){
+        unsigned char bytes[4] = {(unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24)};
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+    static void putFloat(std::vector<unsigned char>& out, float value){
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        putUint32(out, bits);
+    }
+    static uint32_t getUint32(const unsigned char* in){
+        return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    }
+    static float getFloat(const unsigned char* in){
+        uint32_t bits = getUint32(in);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    bool writePolylines(const std::string& filePath, const Geometry::StrokeBuffer& strokes){
+        FILE* file = std::fopen(filePath.c_str(), "wb");
+        if(!file){
+            std::cerr << "Failed to create polyline file: " << filePath << "\n";
+            return false;
+        }
+
+        std::vector<unsigned char> chunk;
+        chunk.insert(chunk.end(), POLYLINE_MAGIC, POLYLINE_MAGIC + 4);
+        putUint32(chunk, (uint32_t)strokes.strokeCount());
+        putUint32(chunk, (uint32_t)strokes.vertexCount());
+        for(size_t stroke = 0; stroke < strokes.strokeCount(); ++stroke){
+            size_t begin = strokes.strokeBegin(stroke), size = strokes.strokeSize(stroke);
+            const Geometry::StrokeColor& color = strokes.colors[stroke];
+            putUint32(chunk, (uint32_t)size);
+            putFloat(chunk, color.r);
+            putFloat(chunk, color.g);
+            putFloat(chunk, color.b);
+            for(size_t v_num = begin; v_num < begin + size; ++v_num){
+                putFloat(chunk, strokes.x[v_num]);
+                putFloat(chunk, strokes.y[v_num]);
+            }
+            if(chunk.size() >= (1 << 16)){
+                std::fwrite(chunk.data(), 1, chunk.size(), file);
+                chunk.clear();
+            }
+        }
+        std::fwrite(chunk.data(), 1, chunk.size(), file);
+
+        bool ok = std::ferror(file) == 0;
+        ok = std::fclose(file) == 0 && ok;
+        if(!ok){
+            std::cerr << "Failed to write polyline file: " << filePath << "\n";
+        }
+        return ok;
+    }
+
+    bool readPolylines(const std::string& filePath, Geometry::StrokeBuffer& strokes){
+        FILE* file = std::fopen(filePath.c_str(), "rb");
+        if(!file){
+            std::cerr << "Failed to open polyline file: " << filePath << "\n";
+            return false;
+        }
+        std::vector<unsigned char> data;
+        unsigned char block[1 << 16];
+        size_t read;
+        while((read = std::fread(block, 1, sizeof(block), file)) > 0){
+            data.insert(data.end(), block, block + read);
+        }
+        std::fclose(file);
+
+        if(data.size() < 12 || std::memcmp(data.data(), POLYLINE_MAGIC, 4) != 0){
+            std::cerr << "Not a polyline file: " << filePath << "\n";
+            return false;
+        }
+        uint32_t stroke_count = getUint32(data.data() + 4), vertex_count = getUint32(data.data() + 8);
+
+        strokes.clear();
+        /* The counts come from the file, do not trust them more than its size */
+        strokes.reserve(std::min<size_t>(stroke_count, data.size() / 16), std::min<size_t>(vertex_count, data.size() / 8));
+        size_t position = 12;
+        for(uint32_t stroke = 0; stroke < stroke_count; ++stroke){
+            if(data.size() - position < 16){
+                break;
+            }
+            uint32_t size = getUint32(data.data() + position);
+            Geometry::StrokeColor color;
+            color.r = getFloat(data.data() + position + 4);
+            color.g = getFloat(data.data() + position + 8);
+            color.b = getFloat(data.data() + position + 12);
+            position += 16;
+            if((data.size() - position) / 8 < size){
+                break;
+            }
+            strokes.beginStroke(color);
+            for(uint32_t v_num = 0; v_num < size; ++v_num, position += 8){
+                strokes.append(getFloat(data.data() + position), getFloat(data.data() + position + 4), 0.0f);
+            }
+        }
+        if(strokes.strokeCount() != stroke_count || strokes.vertexCount() != vertex_count){
+            std::cerr << "Polyline file is truncated or damaged: " << filePath << "\n";
+            return false;
+        }
+        return true;
+    }
+}
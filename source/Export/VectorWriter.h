@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Geometry{
+    class StrokeBuffer;
+}
+
+namespace Export{
+    struct SvgOptions{
+        /* Line width in output pixels, it does not change with the zoom of the viewer */
+        float line_width = 3.0f;
+        /* Black background like in the rendered images, off for plotting on paper */
+        bool background = true;
+    };
+
+    /*
+        Writes unfolded strokes as SVG polylines in the plane coordinates(y goes up, as on the screen).
+        Every stroke of the buffer becomes its own polyline, so the pieces cut on the seam stay separate.
+    */
+    bool writeSvg(const std::string& filePath, const Geometry::StrokeBuffer& strokes, const SvgOptions& options = SvgOptions());
+
+    /*
+        Compact binary polylines, all values little-endian:
+            char[4] "SPL1", uint32 stroke count, uint32 vertex count,
+            then for every stroke: uint32 vertex count, float r, g, b, and vertex count pairs of float x, y.
+    */
+    const char POLYLINE_MAGIC[4] = {'S', 'P', 'L', '1'};
+
+    bool writePolylines(const std::string& filePath, const Geometry::StrokeBuffer& strokes);
+
+    /* Reads a file written by writePolylines(), z of the read vertices is 0 */
+    bool readPolylines(const std::string& filePath, Geometry::StrokeBuffer& strokes);
+}
@@ -0,0 +1,57 @@
+#include "DrawingHistory.h"
+
+#include <algorithm>
+
+namespace Geometry{
+    DrawingHistory::DrawingHistory(size_t depth) : depth(std::max(depth, (size_t)1)){}
+
+    void DrawingHistory::commit(StrokeArena& strokes, StrokeArena* raw){
+        State state;
+        state.strokes = strokes.snapshot();
+        if(raw){
+            state.raw = raw->snapshot();
+        }
+        if(!states.empty() && state.strokes.sharesAll(states[current].strokes) && state.raw.sharesAll(states[current].raw)){
+            return;
+        }
+
+        if(!states.empty()){
+            states.erase(states.begin() + current + 1, states.end());
+        }
+        states.push_back(std::move(state));
+        if(states.size() > depth){
+            states.pop_front();
+        }
+        current = states.size() - 1;
+    }
+
+    bool DrawingHistory::undo(StrokeArena& strokes, StrokeArena* raw, StrokeChanges* changes, StrokeChanges* rawChanges){
+        if(!canUndo()){
+            return false;
+        }
+        --current;
+        restore(strokes, raw, changes, rawChanges);
+        return true;
+    }
+
+    bool DrawingHistory::redo(StrokeArena& strokes, StrokeArena* raw, StrokeChanges* changes, StrokeChanges* rawChanges){
+        if(!canRedo()){
+            return false;
+        }
+        ++current;
+        restore(strokes, raw, changes, rawChanges);
+        return true;
+    }
+
+    void DrawingHistory::clear(){
+        states.clear();
+        current = 0;
+    }
+
+    void DrawingHistory::restore(StrokeArena& strokes, StrokeArena* raw, StrokeChanges* changes, StrokeChanges* rawChanges) const{
+        strokes.restore(states[current].strokes, changes);
+        if(raw){
+            raw->restore(states[current].raw, rawChanges);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "StrokeArena.h"
+
+#include <cstddef>
+#include <deque>
+
+namespace Geometry{
+    /*
+        Undo and redo of the drawing: the states after every change as snapshots of its arenas(the strokes, and
+        the raw strokes when they are kept). The snapshots share every stroke that did not change and the pages of
+        the stroke list holding only such strokes, so a state costs a reference per page plus the pages and the
+        strokes changed since the previous one, and going back to it only compares and replaces those.
+    */
+    class DrawingHistory{
+    public:
+        /* depth is the number of states kept, the oldest ones are dropped */
+        explicit DrawingHistory(size_t depth = 100);
+
+        /* Records the current drawing after a change, the undone states can not be redone any more. Nothing
+           is recorded if the drawing is the same as the current state */
+        void commit(StrokeArena& strokes, StrokeArena* raw = nullptr);
+
+        /* Puts the previous/next state into the arenas, false if there is none. Only the strokes that differ are
+           replaced, changes and rawChanges(if given) get them(see StrokeArena::restore()) */
+        bool undo(StrokeArena& strokes, StrokeArena* raw = nullptr, StrokeChanges* changes = nullptr, StrokeChanges* rawChanges = nullptr);
+        bool redo(StrokeArena& strokes, StrokeArena* raw = nullptr, StrokeChanges* changes = nullptr, StrokeChanges* rawChanges = nullptr);
+
+        /* Drops every state, before the arenas they came from go away */
+        void clear();
+
+        bool canUndo() const { return current > 0; }
+        bool canRedo() const { return current + 1 < states.size(); }
+
+    private:
+        struct State{
+            StrokeArena::Snapshot strokes, raw;
+        };
+        std::deque<State> states;
+        size_t current = 0;
+        size_t depth;
+
+        void restore(StrokeArena& strokes, StrokeArena* raw, StrokeChanges* changes, StrokeChanges* rawChanges) const;
+    };
+}
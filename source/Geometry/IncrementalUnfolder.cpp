@@ -0,0 +1,235 @@
+#include "IncrementalUnfolder.h"
+#include "StrokeArena.h"
+
+#include <algorithm>
+
+namespace Geometry{
+    template<typename Strips>
+    void IncrementalUnfolder::sync(const Strips& strips, size_t mutableTail){
+        if(!appendStrips(strips, mutableTail)){
+            reset();
+            appendStrips(strips, 0);
+        }
+    }
+    void IncrementalUnfolder::reset(){
+        unfolded.clear();
+        consumed.clear();
+        pieces.clear();
+        checkpoints.clear();
+        has_previous = false;
+        last_final = false;
+        markChanged(0, 0);
+    }
+    bool IncrementalUnfolder::takeChanged(size_t& strip, size_t& vertex){
+        if(changed_strip == SIZE_MAX){
+            return false;
+        }
+        strip = changed_strip;
+        vertex = changed_vertex;
+        changed_strip = SIZE_MAX;
+        return true;
+    }
+    void IncrementalUnfolder::markChanged(size_t strip, size_t vertex){
+        if(strip < changed_strip || (strip == changed_strip && vertex < changed_vertex)){
+            changed_strip = strip;
+            changed_vertex = vertex;
+        }
+    }
+    template<typename Strips>
+    bool IncrementalUnfolder::appendStrips(const Strips& strips, size_t mutableTail){
+        if(strips.size() < consumed.size()){
+            return false;
+        }
+        max_checkpoints = mutableTail;
+
+        /* Only the last synced strip may have grown, all strips before it are finished */
+        size_t strip_num = consumed.empty() ? 0 : consumed.size() - 1;
+        if(!consumed.empty()){
+            size_t vertices = strips[strip_num].size() / VERTEX_STRIDE;
+            if(vertices < consumed[strip_num] || (!last_final && !rewind(std::min(mutableTail, consumed[strip_num])))){
+                return false;
+            }
+        }
+
+        for(; strip_num < strips.size(); ++strip_num){
+            const auto& strip = strips[strip_num];
+            if(strip_num == consumed.size()){
+                /* Every source strip starts an unfolded strip of its own */
+                consumed.push_back(0);
+                pieces.push_back(1);
+                unfolded.addStroke();
+                checkpoints.clear();
+                has_previous = false;
+                last_final = false;
+            }
+            size_t vertices = strip.size() / VERTEX_STRIDE;
+            if(vertices < consumed[strip_num]){
+                return false;
+            }
+            for(size_t v_num = consumed[strip_num]; v_num < vertices; ++v_num){
+                appendVertex(strip.data() + v_num * VERTEX_STRIDE);
+            }
+            consumed[strip_num] = vertices;
+        }
+        return true;
+    }
+    bool IncrementalUnfolder::rewind(size_t vertices){
+        if(vertices == 0){
+            return true;
+        }
+        if(vertices > checkpoints.size()){
+            return false;
+        }
+        const Checkpoint& checkpoint = checkpoints[checkpoints.size() - vertices];
+        markChanged(checkpoint.strip_count - 1, checkpoint.last_strip_size / VERTEX_STRIDE);
+        pieces.back() -= unfolded.size() - checkpoint.strip_count;
+        while(unfolded.size() > checkpoint.strip_count){
+            unfolded.removeStroke(unfolded.size() - 1);
+        }
+        unfolded.truncate(unfolded.size() - 1, checkpoint.last_strip_size);
+        std::copy(checkpoint.previous, checkpoint.previous + VERTEX_STRIDE, previous);
+        has_previous = checkpoint.has_previous;
+
+        checkpoints.resize(checkpoints.size() - vertices);
+        consumed.back() -= vertices;
+        return true;
+    }
+    void IncrementalUnfolder::appendVertex(const double* vertex){
+        if(max_checkpoints > 0){
+            Checkpoint checkpoint;
+            checkpoint.strip_count = unfolded.size();
+            checkpoint.last_strip_size = unfolded.back().size();
+            std::copy(previous, previous + VERTEX_STRIDE, checkpoint.previous);
+            checkpoint.has_previous = has_previous;
+            checkpoints.push_back(checkpoint);
+            while(checkpoints.size() > max_checkpoints){
+                checkpoints.pop_front();
+            }
+        }
+
+        size_t strip_count = unfolded.size();
+        unfoldVertex(vertex, previous, has_previous, unfolded);
+        pieces.back() += unfolded.size() - strip_count;
+    }
+    void IncrementalUnfolder::unfoldVertex(const double* vertex, double* previous, bool& hasPrevious, StrokeArena& strips){
+        double current[VERTEX_STRIDE];
+        std::copy(vertex, vertex + VERTEX_STRIDE, current);
+        vertexToCylinder(current);
+
+        /* A seam crossing closes the current piece and continues the strip in a new one */
+        if(hasPrevious && crossesSeam(previous, current)){
+            double closing[VERTEX_STRIDE], opening[VERTEX_STRIDE];
+            seamVertices(previous, current, closing, opening);
+            projectVertex(closing);
+            projectVertex(opening);
+            strips.append(strips.size() - 1, closing, VERTEX_STRIDE);
+            strips.addStroke();
+            strips.append(strips.size() - 1, opening, VERTEX_STRIDE);
+        }
+        std::copy(current, current + VERTEX_STRIDE, previous);
+        hasPrevious = true;
+
+        projectVertex(current);
+        strips.append(strips.size() - 1, current, VERTEX_STRIDE);
+    }
+
+    template<typename Strips>
+    void IncrementalUnfolder::apply(const Strips& strips, const StrokeChanges& changes, StrokeChanges& unfoldedChanges){
+        unfoldedChanges.clear();
+        if(consumed.empty() || changes.empty()){
+            return;
+        }
+        std::vector<size_t> next_consumed, next_pieces;
+
+        /* First unfolded strip of the source strip being walked before the change, and the unfolded strips after it */
+        size_t piece = 0, next = 0;
+        size_t last = consumed.size() - 1, last_piece = unfolded.size() - pieces.back();
+        size_t first_touched = SIZE_MAX, shift = 0;
+        bool last_kept = false;
+        auto drop = [&](size_t before){
+            first_touched = std::min(first_touched, next);
+            for(size_t k = 0; k < pieces[before]; ++k){
+                unfoldedChanges.removed.push_back(piece + k);
+            }
+            piece += pieces[before];
+        };
+        auto unfoldStrip = [&](size_t after){
+            first_touched = std::min(first_touched, next);
+            const auto& strip = strips[after];
+            size_t vertices = strip.size() / VERTEX_STRIDE, first = scratch.size();
+            double previous_vertex[VERTEX_STRIDE];
+            bool has_previous_vertex = false;
+            scratch.addStroke();
+            for(size_t v_num = 0; v_num < vertices; ++v_num){
+                unfoldVertex(strip.data() + v_num * VERTEX_STRIDE, previous_vertex, has_previous_vertex, scratch);
+            }
+            next_consumed.push_back(vertices);
+            next_pieces.push_back(scratch.size() - first);
+            for(size_t k = first; k < scratch.size(); ++k){
+                unfoldedChanges.inserted.push_back(next);
+                unfoldedChanges.changed.push_back(next++);
+            }
+        };
+        size_t walked = changes.walk(consumed.size(), drop, unfoldStrip, [&](size_t before, size_t after, bool changed){
+            if(changed){
+                drop(before);
+                unfoldStrip(after);
+                return;
+            }
+            if(before == last){
+                last_kept = true;
+                shift = next - piece;
+            }
+            next += pieces[before];
+            next_consumed.push_back(consumed[before]);
+            next_pieces.push_back(pieces[before]);
+            piece += pieces[before];
+        });
+        for(size_t before = walked; before < consumed.size(); ++before){
+            drop(before);
+        }
+        /* The kept pieces stay where they are, the new ones go in between */
+        unfolded.removeStrokes(unfoldedChanges.removed);
+        unfolded.insertStrokes(unfoldedChanges.inserted);
+        for(size_t k = 0; k < scratch.size(); ++k){
+            unfolded.assign(unfoldedChanges.inserted[k], scratch[k].data(), scratch[k].size());
+        }
+        scratch.clear();
+        consumed.swap(next_consumed);
+        pieces.swap(next_pieces);
+
+        /* The pieces of the last strip moved with the strips inserted in front of them */
+        if(last_kept){
+            for(Checkpoint& checkpoint : checkpoints){
+                checkpoint.strip_count += shift;
+            }
+        }
+        else{
+            checkpoints.clear();
+            has_previous = !consumed.empty() && consumed.back() > 0;
+            if(has_previous){
+                const double* vertex = strips[consumed.size() - 1].data() + (consumed.back() - 1) * VERTEX_STRIDE;
+                std::copy(vertex, vertex + VERTEX_STRIDE, previous);
+                vertexToCylinder(previous);
+            }
+            last_final = !consumed.empty();
+        }
+
+        /* A change still to be taken(takeChanged()) moves along, or starts where this one did */
+        if(changed_strip != SIZE_MAX){
+            if(last_kept && changed_strip >= last_piece){
+                changed_strip += shift;
+            }
+            else if(changed_strip >= first_touched){
+                changed_strip = first_touched;
+                changed_vertex = 0;
+            }
+        }
+    }
+
+    template void IncrementalUnfolder::sync(const std::vector<std::vector<double>>& strips, size_t mutableTail);
+    template void IncrementalUnfolder::sync(const StrokeArena& strips, size_t mutableTail);
+    template void IncrementalUnfolder::apply(const std::vector<std::vector<double>>& strips, const StrokeChanges& changes,
+                                             StrokeChanges& unfoldedChanges);
+    template void IncrementalUnfolder::apply(const StrokeArena& strips, const StrokeChanges& changes, StrokeChanges& unfoldedChanges);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "SphereUnfold.h"
+#include "StrokeArena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace Geometry{
+    /*
+        Keeps the unfolded copy of a growing drawing up to date. Only vertices appended since the previous sync()
+        are transformed to the "cylinder" view, split on the seam and projected, so the flattened drawing is always
+        ready(for a live preview and for exports) at a cost proportional to what was drawn in between.
+        The result is the same as unfold() of the whole drawing, strips and seam pieces come in the same order.
+    */
+    class IncrementalUnfolder{
+    public:
+        /*
+            Unfolds the new strips and the new vertices of the last strips. Like Renderer::StrokeStore, strips are
+            expected to only grow at the end(anything else unfolds the whole drawing again), the last mutableTail
+            vertices of the last synced strip may have been changed in place.
+            Strips is std::vector<std::vector<double>> or StrokeArena.
+        */
+        template<typename Strips>
+        void sync(const Strips& strips, size_t mutableTail = 0);
+
+        /* Forgets everything, the next sync() unfolds the whole drawing */
+        void reset();
+
+        /*
+            Follows source strips changed in the middle(erased): only the changed and inserted strips are unfolded
+            again, the pieces of the others are kept. Strips are the source strips after the change; unfoldedChanges
+            gets the same description for the unfolded strips, for copies of them(StrokeStore::apply()).
+        */
+        template<typename Strips>
+        void apply(const Strips& strips, const StrokeChanges& changes, StrokeChanges& unfoldedChanges);
+
+        /*
+            First unfolded vertex(strip and vertex number) that may have changed since the last call, everything
+            after it may have too. Taking a mutable tail back can rewrite the closing vertex of an earlier seam piece
+            and drop pieces, so copies of the unfolded strips rewind to it(StrokeStore::rewind()) before syncing.
+            False if vertices were only appended.
+        */
+        bool takeChanged(size_t& strip, size_t& vertex);
+
+        /* Unfolded strips in the XYZRGB layout of the source ones */
+        const StrokeArena& getStrips() const { return unfolded; }
+        /* Read only version of the unfolded strips for another thread(a saved projection), see StrokeArena::Snapshot */
+        StrokeArena::Snapshot snapshot(){ return unfolded.snapshot(); }
+
+    private:
+        StrokeArena unfolded;
+        /* Strips unfolded again by apply() before they take the place of the dropped pieces */
+        StrokeArena scratch;
+
+        /* Number of source vertices unfolded per source strip, and of the unfolded strips(seam pieces) they gave */
+        std::vector<size_t> consumed, pieces;
+        /* The last synced source strip is finished(apply() dropped the one after it), no tail of it is taken back */
+        bool last_final = false;
+
+        /* The previous vertex of the last source strip in the "cylinder" view, for the seam test */
+        double previous[VERTEX_STRIDE];
+        bool has_previous = false;
+
+        /* State before each of the last few vertices of the last source strip, to take a mutable tail back */
+        struct Checkpoint{
+            size_t strip_count, last_strip_size;
+            double previous[VERTEX_STRIDE];
+            bool has_previous;
+        };
+        std::deque<Checkpoint> checkpoints;
+        size_t max_checkpoints = 0;
+
+        /* See takeChanged(), changed_strip is SIZE_MAX if nothing changed */
+        size_t changed_strip = SIZE_MAX, changed_vertex = 0;
+        void markChanged(size_t strip, size_t vertex);
+
+        template<typename Strips>
+        bool appendStrips(const Strips& strips, size_t mutableTail);
+        bool rewind(size_t vertices);
+        void appendVertex(const double* vertex);
+        /* Unfolds a vertex onto the end of the strips, previous is the vertex before it in the "cylinder" view */
+        static void unfoldVertex(const double* vertex, double* previous, bool& hasPrevious, StrokeArena& strips);
+    };
+}
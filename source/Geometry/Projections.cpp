@@ -0,0 +1,171 @@
+#include "Projections.h"
+#include "UnfoldKernel.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Geometry{
+    const char* projectionName(Projection projection){
+        switch(projection){
+        case Projection::Equirectangular:
+            return "equirectangular";
+        case Projection::Mercator:
+            return "mercator";
+        case Projection::LambertEqualArea:
+            return "lambert";
+        case Projection::Gnomonic:
+            return "gnomonic";
+        case Projection::Stereographic:
+            return "stereographic";
+        default:
+            return "cylinder";
+        }
+    }
+
+    bool parseProjection(const std::string& name, Projection& projection){
+        const Projection all[] = {Projection::Cylinder, Projection::Equirectangular, Projection::Mercator, Projection::LambertEqualArea,
+                                  Projection::Gnomonic, Projection::Stereographic};
+        for(Projection candidate : all){
+            if(name == projectionName(candidate)){
+                projection = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Unit direction of a vertex seen from the sphere center */
+    static inline void direction(const StrokeBuffer& strokes, size_t vertex, float u[3]){
+        float x = strokes.x[vertex], y = strokes.y[vertex] - (float)camera_y_shift, z = strokes.z[vertex];
+        float inv_length = 1.0f / std::sqrt(x * x + y * y + z * z);
+        u[0] = x * inv_length;
+        u[1] = y * inv_length;
+        u[2] = z * inv_length;
+    }
+
+    static inline void normalize(float u[3]){
+        float inv_length = 1.0f / std::sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+        u[0] *= inv_length;
+        u[1] *= inv_length;
+        u[2] *= inv_length;
+    }
+
+    template<typename Policy>
+    void unfoldWith(StrokeBuffer& strokes){
+        StrokeBuffer result;
+        result.reserve(strokes.strokeCount(), strokes.vertexCount() + strokes.vertexCount() / 64);
+
+        auto emit = [&](const float u[3]){
+            float px, py;
+            Policy::map(u[0], u[1], u[2], px, py);
+            result.append(px, py + (float)camera_y_shift, (float)-S_RADIUS);
+        };
+
+        for(size_t stroke = 0; stroke < strokes.strokeCount(); ++stroke){
+            size_t begin = strokes.strokeBegin(stroke), end = strokes.strokeBegin(stroke + 1);
+            const StrokeColor& color = strokes.colors[stroke];
+
+            float prev[3] = {0.0f, 0.0f, -1.0f};
+            bool prev_visible = true;
+            for(size_t curr = begin; curr < end; ++curr){
+                float u[3];
+                direction(strokes, curr, u);
+
+                if constexpr(Policy::cut == ProjectionCut::Seam){
+                    if(curr == begin){
+                        result.beginStroke(color);
+                    }
+                    else if(u[2] > 0.00001f && std::signbit(u[0]) != std::signbit(prev[0])){
+                        /* Close the piece exactly on the back meridian(longitude +-PI) and open the next one on the
+                           other side of it. A crossing in front of the camera is the continuous 0 meridian */
+                        float t = prev[0] / (prev[0] - u[0]);
+                        float seam[3] = {0.0f, prev[1] + t * (u[1] - prev[1]), prev[2] + t * (u[2] - prev[2])};
+                        if(seam[2] > 0.0f){
+                            normalize(seam);
+                            seam[0] = std::copysign(0.0f, prev[0]);
+                            emit(seam);
+                            result.beginStroke(color);
+                            seam[0] = -seam[0];
+                            emit(seam);
+                        }
+                    }
+                    emit(u);
+                }
+                else{
+                    /* The cos of the angle from the map center is -uz, interpolated linearly along the segment */
+                    bool visible = -u[2] >= Policy::min_cos;
+                    if(curr != begin && visible != prev_visible){
+                        float from = -prev[2] - Policy::min_cos, to = -u[2] - Policy::min_cos;
+                        float t = from / (from - to);
+                        float edge[3] = {prev[0] + t * (u[0] - prev[0]), prev[1] + t * (u[1] - prev[1]), prev[2] + t * (u[2] - prev[2])};
+                        normalize(edge);
+                        if(visible){
+                            result.beginStroke(color);
+                        }
+                        emit(edge);
+                    }
+                    else if(curr == begin && visible){
+                        result.beginStroke(color);
+                    }
+                    if(visible){
+                        emit(u);
+                    }
+                    prev_visible = visible;
+                }
+                std::memcpy(prev, u, sizeof(prev));
+            }
+        }
+        strokes = std::move(result);
+    }
+
+    template void unfoldWith<ProjectionPolicy::Equirectangular>(StrokeBuffer& strokes);
+    template void unfoldWith<ProjectionPolicy::Mercator>(StrokeBuffer& strokes);
+    template void unfoldWith<ProjectionPolicy::LambertEqualArea>(StrokeBuffer& strokes);
+    template void unfoldWith<ProjectionPolicy::Gnomonic>(StrokeBuffer& strokes);
+    template void unfoldWith<ProjectionPolicy::Stereographic>(StrokeBuffer& strokes);
+
+    void unfold(StrokeBuffer& strokes, Projection projection){
+        switch(projection){
+        case Projection::Equirectangular:
+            unfoldWith<ProjectionPolicy::Equirectangular>(strokes);
+            break;
+        case Projection::Mercator:
+            unfoldWith<ProjectionPolicy::Mercator>(strokes);
+            break;
+        case Projection::LambertEqualArea:
+            unfoldWith<ProjectionPolicy::LambertEqualArea>(strokes);
+            break;
+        case Projection::Gnomonic:
+            unfoldWith<ProjectionPolicy::Gnomonic>(strokes);
+            break;
+        case Projection::Stereographic:
+            unfoldWith<ProjectionPolicy::Stereographic>(strokes);
+            break;
+        default:
+            unfold(strokes);
+        }
+    }
+
+    template<typename Policy>
+    static float fitPolicy(float aspect){
+        return 1.05f * std::max(Policy::half_height, Policy::half_width / aspect);
+    }
+
+    float fitHalfHeight(Projection projection, float aspect){
+        switch(projection){
+        case Projection::Equirectangular:
+            return fitPolicy<ProjectionPolicy::Equirectangular>(aspect);
+        case Projection::Mercator:
+            return fitPolicy<ProjectionPolicy::Mercator>(aspect);
+        case Projection::LambertEqualArea:
+            return fitPolicy<ProjectionPolicy::LambertEqualArea>(aspect);
+        case Projection::Gnomonic:
+            return fitPolicy<ProjectionPolicy::Gnomonic>(aspect);
+        case Projection::Stereographic:
+            return fitPolicy<ProjectionPolicy::Stereographic>(aspect);
+        default:
+            /* Unrolled cylinder: longitude in radians across, arc length on the sphere upwards */
+            return 1.05f * std::max((float)(PI * S_RADIUS / 2), (float)PI / aspect);
+        }
+    }
+}
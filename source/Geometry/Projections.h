@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+
+#include "SphereUnfold.h"
+#include "StrokeBuffer.h"
+
+/*
+    Map projections of the drawing sphere besides the cylinder unroll. Every projection is a policy struct
+    with a constexpr cut kind and an inline map() from a unit direction(seen from the sphere center, -z is the
+    initial view direction and the map center, +y is up) to the plane. unfoldWith<Policy>() is instantiated
+    per policy, so the vertex loop has neither virtual calls nor a switch on the projection inside it.
+    The results lie on the same z = -S_RADIUS plane around y = camera_y_shift as the cylinder unfold.
+*/
+namespace Geometry{
+    enum class Projection{
+        Cylinder,
+        Equirectangular,
+        Mercator,
+        LambertEqualArea,
+        Gnomonic,
+        Stereographic
+    };
+
+    const char* projectionName(Projection projection);
+
+    /* Parses a name printed by projectionName(), returns false for an unknown one */
+    bool parseProjection(const std::string& name, Projection& projection);
+
+    /* How the sphere is cut before mapping it */
+    enum class ProjectionCut{
+        /* Cylindrical maps: strokes are split on the back meridian(the x = 0, z > 0 seam of the cylinder unroll) */
+        Seam,
+        /* Azimuthal maps: parts further than max_angle from the map center are clipped away */
+        Cap
+    };
+
+    namespace ProjectionPolicy{
+        /* Longitude of a unit direction, 0 in the -z view direction and +-PI on the seam */
+        inline float longitude(float ux, float uz){
+            return std::atan2(ux, -uz);
+        }
+
+        struct Equirectangular{
+            static constexpr ProjectionCut cut = ProjectionCut::Seam;
+            static constexpr float half_width = 3.14159265f, half_height = 1.57079633f;
+
+            static void map(float ux, float uy, float uz, float& px, float& py){
+                px = longitude(ux, uz);
+                py = std::atan2(uy, std::sqrt(ux * ux + uz * uz));
+            }
+        };
+
+        struct Mercator{
+            static constexpr ProjectionCut cut = ProjectionCut::Seam;
+            /* The poles go to infinity, latitudes are clamped to +-85 degrees(as in web maps) */
+            static constexpr float max_sin_latitude = 0.99619470f;
+            static constexpr float half_width = 3.14159265f, half_height = 3.13130951f;
+
+            static void map(float ux, float uy, float uz, float& px, float& py){
+                px = longitude(ux, uz);
+                py = std::atanh(std::fmin(std::fmax(uy, -max_sin_latitude), max_sin_latitude));
+            }
+        };
+
+        struct LambertEqualArea{
+            static constexpr ProjectionCut cut = ProjectionCut::Seam;
+            static constexpr float half_width = 3.14159265f, half_height = 1.0f;
+
+            static void map(float ux, float uy, float uz, float& px, float& py){
+                px = longitude(ux, uz);
+                py = uy;
+            }
+        };
+
+        struct Gnomonic{
+            static constexpr ProjectionCut cut = ProjectionCut::Cap;
+            /* Only a hemisphere has an image, it is clipped at 70 degrees from the center to keep the map finite */
+            static constexpr float min_cos = 0.34202014f;
+            static constexpr float half_width = 2.74747742f, half_height = 2.74747742f;
+
+            static void map(float ux, float uy, float uz, float& px, float& py){
+                float k = 1.0f / -uz;
+                px = ux * k;
+                py = uy * k;
+            }
+        };
+
+        struct Stereographic{
+            static constexpr ProjectionCut cut = ProjectionCut::Cap;
+            /* Everything but the antipode has an image, it is clipped at 120 degrees from the center */
+            static constexpr float min_cos = -0.5f;
+            static constexpr float half_width = 3.46410162f, half_height = 3.46410162f;
+
+            static void map(float ux, float uy, float uz, float& px, float& py){
+                float k = 2.0f / (1.0f - uz);
+                px = ux * k;
+                py = uy * k;
+            }
+        };
+    }
+
+    /* Sphere -> plane with the given policy, the drawing is expected in the "sphere" view(not transformed yet) */
+    template<typename Policy>
+    void unfoldWith(StrokeBuffer& strokes);
+
+    /* Picks the instantiation once per call. Cylinder runs the vectorized unfold(strokes) */
+    void unfold(StrokeBuffer& strokes, Projection projection);
+
+    /* Half height of an orthographic frame of the given aspect that holds the whole map, with a small margin */
+    float fitHalfHeight(Projection projection, float aspect);
+}
@@ -0,0 +1,362 @@
+#include "SessionLog.h"
+#include "SphereUnfold.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace Geometry{
+    static const size_t HEADER_SIZE = 16;
+    static const size_t RECORD_HEADER_SIZE = 24;
+
+    struct RecordHeader{
+        uint32_t type;
+        uint32_t count;
+        float color[3];
+        uint32_t flags;
+    };
+    static_assert(sizeof(RecordHeader) == RECORD_HEADER_SIZE, "session records are read in place");
+
+    /* Edits carry the index of their stroke in front of the positions */
+    static inline bool isEdit(uint32_t type){
+        return type == SESSION_INSERT || type == SESSION_REPLACE || type == SESSION_REMOVE;
+    }
+
+    SessionWriter::~SessionWriter(){
+        close();
+    }
+    bool SessionWriter::open(const std::string& filePath){
+        close();
+        written.clear();
+        last_strip = SIZE_MAX;
+
+        /* An existing log is validated and its partially written tail is cut off before appending */
+        std::error_code error;
+        if(std::filesystem::exists(filePath, error)){
+            SessionReader reader;
+            if(!reader.open(filePath)){
+                return false;
+            }
+            size_t valid_size = reader.getValidSize();
+            if(valid_size != std::filesystem::file_size(filePath, error)){
+                std::filesystem::resize_file(filePath, valid_size, error);
+                if(error){
+                    std::cerr << "Failed to repair session log: " << filePath << "\n";
+                    return false;
+                }
+            }
+            /* Edits may be appended, a version 1 log becomes a version 2 one(readers of version 1 stop at it) */
+            if(reader.getVersion() < SESSION_VERSION){
+                file = std::fopen(filePath.c_str(), "r+b");
+                if(file){
+                    std::fseek(file, sizeof(SESSION_MAGIC), SEEK_SET);
+                    std::fwrite(&SESSION_VERSION, sizeof(uint32_t), 1, file);
+                    std::fclose(file);
+                }
+            }
+            file = std::fopen(filePath.c_str(), "ab");
+        }
+        else{
+            file = std::fopen(filePath.c_str(), "wb");
+            if(file){
+                uint32_t header[3] = {SESSION_VERSION, (uint32_t)HEADER_SIZE, 0};
+                std::fwrite(SESSION_MAGIC, 1, sizeof(SESSION_MAGIC), file);
+                std::fwrite(header, sizeof(uint32_t), 3, file);
+                std::fflush(file);
+            }
+        }
+        if(!file){
+            std::cerr << "Failed to open session log: " << filePath << "\n";
+            return false;
+        }
+        return true;
+    }
+    void SessionWriter::close(){
+        if(file){
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+    template<typename Strips>
+    void SessionWriter::sync(const Strips& strips, size_t mutableTail){
+        if(!file){
+            return;
+        }
+        bool wrote = false;
+
+        /* Strips before the last known one are finished, the last one may still have unwritten vertices */
+        for(size_t strip_num = written.empty() ? 0 : written.size() - 1; strip_num < strips.size(); ++strip_num){
+            if(strip_num == written.size()){
+                written.push_back(0);
+            }
+            size_t vertices = strips[strip_num].size() / VERTEX_STRIDE;
+            if(strip_num + 1 == strips.size()){
+                vertices -= std::min(vertices, mutableTail);
+            }
+            if(vertices <= written[strip_num]){
+                continue;
+            }
+
+            uint32_t flags = written[strip_num] > 0 && last_strip == strip_num ? SESSION_CONTINUES : 0;
+            writeRecord(SESSION_STROKE, flags, strips[strip_num].data() + written[strip_num] * VERTEX_STRIDE, vertices - written[strip_num]);
+            written[strip_num] = vertices;
+            last_strip = strip_num;
+            wrote = true;
+        }
+        if(wrote){
+            std::fflush(file);
+        }
+    }
+    template<typename Strips>
+    void SessionWriter::setLogged(const Strips& strips){
+        written.clear();
+        for(size_t strip_num = 0; strip_num < strips.size(); ++strip_num){
+            written.push_back(strips[strip_num].size() / VERTEX_STRIDE);
+        }
+        last_strip = SIZE_MAX;
+    }
+
+    template<typename Strips>
+    void SessionWriter::apply(const Strips& strips, const StrokeChanges& changes){
+        if(!file || written.empty() || changes.empty()){
+            return;
+        }
+        std::vector<size_t> next;
+        next.reserve(written.size() + changes.inserted.size());
+        size_t next_last = SIZE_MAX;
+        bool wrote = false;
+
+        /* Strokes of the log in front of the walked strip: the edited stroke's index when the reader gets to the record */
+        size_t logged = 0;
+        auto remove = [&](size_t before){
+            if(written[before] > 0){
+                writeRecord(SESSION_REMOVE, 0, nullptr, 0, (uint32_t)logged);
+                wrote = true;
+            }
+        };
+        auto write = [&](size_t after, uint32_t type){
+            size_t vertices = strips[after].size() / VERTEX_STRIDE;
+            if(vertices > 0){
+                writeRecord(type, 0, strips[after].data(), vertices, (uint32_t)logged++);
+                wrote = true;
+            }
+            next.push_back(vertices);
+        };
+        size_t walked = changes.walk(written.size(), remove, [&](size_t after){
+            write(after, SESSION_INSERT);
+        }, [&](size_t before, size_t after, bool changed){
+            if(changed){
+                if(written[before] > 0 && strips[after].size() > 0){
+                    write(after, SESSION_REPLACE);
+                }
+                else{
+                    remove(before);
+                    write(after, SESSION_INSERT);
+                }
+                return;
+            }
+            if(before == last_strip){
+                next_last = next.size();
+            }
+            logged += written[before] > 0 ? 1 : 0;
+            next.push_back(written[before]);
+        });
+        for(size_t before = walked; before < written.size(); ++before){
+            remove(before);
+        }
+        written.swap(next);
+        last_strip = next_last;
+        if(wrote){
+            std::fflush(file);
+        }
+    }
+
+    template void SessionWriter::sync(const std::vector<std::vector<double>>& strips, size_t mutableTail);
+    template void SessionWriter::sync(const StrokeArena& strips, size_t mutableTail);
+    template void SessionWriter::setLogged(const std::vector<std::vector<double>>& strips);
+    template void SessionWriter::setLogged(const StrokeArena& strips);
+    template void SessionWriter::apply(const std::vector<std::vector<double>>& strips, const StrokeChanges& changes);
+    template void SessionWriter::apply(const StrokeArena& strips, const StrokeChanges& changes);
+
+    void SessionWriter::clear(){
+        written.clear();
+        last_strip = SIZE_MAX;
+        if(file){
+            writeRecord(SESSION_CLEAR, 0, nullptr, 0);
+            std::fflush(file);
+        }
+    }
+    void SessionWriter::writeRecord(uint32_t type, uint32_t flags, const double* vertices, size_t count, uint32_t stroke){
+        RecordHeader header = {type, (uint32_t)count, {1.0f, 1.0f, 1.0f}, flags};
+        if(count > 0){
+            header.color[0] = (float)vertices[3];
+            header.color[1] = (float)vertices[4];
+            header.color[2] = (float)vertices[5];
+        }
+
+        /* Positions go out as x[], y[], z[] */
+        staging.resize(count * 3);
+        for(size_t v = 0; v < count; ++v){
+            staging[v] = (float)vertices[v * VERTEX_STRIDE];
+            staging[count + v] = (float)vertices[v * VERTEX_STRIDE + 1];
+            staging[2 * count + v] = (float)vertices[v * VERTEX_STRIDE + 2];
+        }
+        std::fwrite(&header, sizeof(header), 1, file);
+        if(isEdit(type)){
+            std::fwrite(&stroke, sizeof(stroke), 1, file);
+        }
+        std::fwrite(staging.data(), sizeof(float), staging.size(), file);
+    }
+
+    bool SessionReader::open(const std::string& filePath){
+        records.clear();
+        drawings = 0;
+        valid_size = 0;
+        version = 0;
+
+        file = Utils::MappedFile(filePath);
+        if(!file.isOpen()){
+            std::cerr << "Failed to open session log: " << filePath << "\n";
+            return false;
+        }
+        const char* data = file.getData();
+        size_t size = file.getSize();
+
+        uint32_t header[3];
+        if(size < HEADER_SIZE || std::memcmp(data, SESSION_MAGIC, sizeof(SESSION_MAGIC)) != 0){
+            std::cerr << "Not a session log: " << filePath << "\n";
+            return false;
+        }
+        std::memcpy(header, data + sizeof(SESSION_MAGIC), sizeof(header));
+        if(header[0] == 0 || header[0] > SESSION_VERSION || header[1] < HEADER_SIZE || header[1] % 4 != 0 || header[1] > size){
+            std::cerr << "Unsupported session log version: " << filePath << "\n";
+            return false;
+        }
+        version = header[0];
+
+        /* The strokes of the current drawing as the records they were written in, edits apply to them */
+        std::vector<std::vector<Record>> strokes;
+        auto endDrawing = [&](){
+            for(const std::vector<Record>& stroke : strokes){
+                for(size_t piece = 0; piece < stroke.size(); ++piece){
+                    records.push_back(stroke[piece]);
+                    records.back().continues = piece > 0;
+                }
+            }
+            strokes.clear();
+        };
+
+        drawings = 1;
+        size_t offset = header[1];
+        while(offset + RECORD_HEADER_SIZE <= size){
+            /* The mapping is page aligned and every record a multiple of 4 bytes, the header is read in place */
+            const RecordHeader* record = reinterpret_cast<const RecordHeader*>(data + offset);
+            bool edit = version >= 2 && isEdit(record->type);
+            size_t payload = (size_t)record->count * 3 * sizeof(float) + (edit ? sizeof(uint32_t) : 0);
+            if(payload > size - offset - RECORD_HEADER_SIZE){
+                break;
+            }
+            const char* body = data + offset + RECORD_HEADER_SIZE;
+            uint32_t stroke = 0;
+            if(edit){
+                std::memcpy(&stroke, body, sizeof(stroke));
+                body += sizeof(stroke);
+            }
+            const float* positions = reinterpret_cast<const float*>(body);
+            Record piece = {positions, positions + record->count, positions + 2 * (size_t)record->count, record->count,
+                            {record->color[0], record->color[1], record->color[2]}, drawings - 1, false};
+
+            if(record->type == SESSION_STROKE){
+                if((record->flags & SESSION_CONTINUES) != 0 && !strokes.empty()){
+                    strokes.back().push_back(piece);
+                }
+                else{
+                    strokes.push_back({piece});
+                }
+            }
+            else if(record->type == SESSION_CLEAR){
+                endDrawing();
+                ++drawings;
+            }
+            else if(edit && (record->type == SESSION_INSERT ? stroke <= strokes.size() : stroke < strokes.size())){
+                if(record->type == SESSION_INSERT){
+                    strokes.insert(strokes.begin() + stroke, {piece});
+                }
+                else if(record->type == SESSION_REPLACE){
+                    strokes[stroke] = {piece};
+                }
+                else{
+                    strokes.erase(strokes.begin() + stroke);
+                }
+            }
+            else{
+                break;
+            }
+            offset += RECORD_HEADER_SIZE + payload;
+        }
+        endDrawing();
+        valid_size = offset;
+        return true;
+    }
+    void SessionReader::appendTo(StrokeBuffer& strokes, size_t drawing) const{
+        size_t strokes_count = 0, vertices = 0;
+        for(const Record& record : records){
+            if(record.drawing == drawing){
+                strokes_count += record.continues ? 0 : 1;
+                vertices += record.count;
+            }
+        }
+        strokes.reserve(strokes.strokeCount() + strokes_count + 1, strokes.vertexCount() + vertices);
+
+        bool first = true;
+        for(const Record& record : records){
+            if(record.drawing != drawing || record.count == 0){
+                continue;
+            }
+            if(!record.continues || first){
+                strokes.beginStroke(record.color);
+            }
+            first = false;
+            strokes.x.insert(strokes.x.end(), record.x, record.x + record.count);
+            strokes.y.insert(strokes.y.end(), record.y, record.y + record.count);
+            strokes.z.insert(strokes.z.end(), record.z, record.z + record.count);
+            strokes.offsets.back() += record.count;
+        }
+    }
+    void SessionReader::appendToStrips(std::vector<std::vector<double>>& strips, size_t drawing) const{
+        bool first = true;
+        for(const Record& record : records){
+            if(record.drawing != drawing || record.count == 0){
+                continue;
+            }
+            if(!record.continues || first){
+                strips.emplace_back();
+            }
+            first = false;
+            std::vector<double>& strip = strips.back();
+            strip.reserve(strip.size() + record.count * VERTEX_STRIDE);
+            for(uint32_t v = 0; v < record.count; ++v){
+                strip.insert(strip.end(), {(double)record.x[v], (double)record.y[v], (double)record.z[v],
+                                           (double)record.color.r, (double)record.color.g, (double)record.color.b});
+            }
+        }
+    }
+    void SessionReader::appendToStrips(StrokeArena& strips, size_t drawing) const{
+        bool first = true;
+        for(const Record& record : records){
+            if(record.drawing != drawing || record.count == 0){
+                continue;
+            }
+            if(!record.continues || first){
+                strips.addStroke();
+            }
+            first = false;
+            for(uint32_t v = 0; v < record.count; ++v){
+                double vertex[VERTEX_STRIDE] = {(double)record.x[v], (double)record.y[v], (double)record.z[v],
+                                                (double)record.color.r, (double)record.color.g, (double)record.color.b};
+                strips.append(strips.size() - 1, vertex, VERTEX_STRIDE);
+            }
+        }
+    }
+}
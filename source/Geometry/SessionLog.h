@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "StrokeArena.h"
+#include "StrokeBuffer.h"
+#include "../Utils/MappedFile.h"
+
+/*
+    Binary session logs("SSL1"): a 16 byte header(magic, version, header size, reserved) followed by records.
+    A record is a 24 byte header(type, vertex count, RGB color as floats, flags) and, for strokes, the positions
+    as float32 arrays x[count], y[count], z[count]. Everything is little endian and 4 byte aligned, so a mapped
+    log is read in place. A stroke may be written in several records while it is drawn, the later ones have
+    the SESSION_CONTINUES flag; a clear record starts a new drawing. Since version 2 a drawing can also be edited
+    in the middle(erasing): insert, replace and remove records carry the index of the stroke in the drawing as a
+    uint32 after their header, the first two followed by the positions of the new stroke. A partially written last
+    record(a crash while appending) is ignored by the reader and cut off when the log is appended to again.
+*/
+namespace Geometry{
+    const char SESSION_MAGIC[4] = {'S', 'S', 'L', '1'};
+    const uint32_t SESSION_VERSION = 2;
+
+    enum SessionRecordType : uint32_t{
+        SESSION_STROKE = 1,
+        SESSION_CLEAR = 2,
+        SESSION_INSERT = 3,
+        SESSION_REPLACE = 4,
+        SESSION_REMOVE = 5
+    };
+    const uint32_t SESSION_CONTINUES = 1;
+
+    /* Appends the drawing to a log as it is drawn */
+    class SessionWriter{
+    public:
+        SessionWriter() = default;
+        ~SessionWriter();
+
+        SessionWriter(const SessionWriter&) = delete;
+        SessionWriter& operator=(const SessionWriter&) = delete;
+
+        /* Creates the log or opens an existing one for appending */
+        bool open(const std::string& filePath);
+        void close();
+        bool isOpen() const { return file != nullptr; }
+
+        /*
+            Writes the vertices added to the strips since the previous call and flushes them, so a crash loses at
+            most one frame. Strips only grow at the end; the last mutableTail vertices of the last strip may still
+            change(a simplified stroke), they are written once the strip is finished.
+        */
+        template<typename Strips>
+        void sync(const Strips& strips, size_t mutableTail = 0);
+
+        /* The strips are in the log already(loaded from it), only what is added to them later is written */
+        template<typename Strips>
+        void setLogged(const Strips& strips);
+
+        /* Starts a new drawing */
+        void clear();
+
+        /*
+            Logs strips changed in the middle(see StrokeChanges) as edits of the strokes they touch, instead of
+            writing the drawing again. Strips are the strips after the change, the ones not synced yet are written
+            by the next sync()
+        */
+        template<typename Strips>
+        void apply(const Strips& strips, const StrokeChanges& changes);
+
+    private:
+        FILE* file = nullptr;
+
+        /* Vertices written per strip, and the strip of the last written record */
+        std::vector<size_t> written;
+        size_t last_strip = SIZE_MAX;
+
+        std::vector<float> staging;
+
+        /* stroke is the index of the edited stroke for insert, replace and remove records */
+        void writeRecord(uint32_t type, uint32_t flags, const double* vertices, size_t count, uint32_t stroke = 0);
+    };
+
+    /* Zero-copy reader of a mapped log */
+    class SessionReader{
+    public:
+        struct Record{
+            /* Positions inside the mapped file */
+            const float* x;
+            const float* y;
+            const float* z;
+            uint32_t count;
+            StrokeColor color;
+            /* The drawing the record belongs to, drawings are separated by clear records */
+            size_t drawing;
+            /* Continues the stroke of the previous record */
+            bool continues;
+        };
+
+        bool open(const std::string& filePath);
+
+        /* The records of the strokes of every drawing in drawing order, with the edits of the log applied */
+        const std::vector<Record>& getRecords() const { return records; }
+        size_t getDrawingCount() const { return drawings; }
+        uint32_t getVersion() const { return version; }
+
+        /* The strokes of a drawing, records of a stroke are merged back into one */
+        void appendTo(StrokeBuffer& strokes, size_t drawing) const;
+        void appendToStrips(std::vector<std::vector<double>>& strips, size_t drawing) const;
+        void appendToStrips(StrokeArena& strips, size_t drawing) const;
+
+        /* Size of the valid part of the log, anything after it is a partially written record */
+        size_t getValidSize() const { return valid_size; }
+
+    private:
+        Utils::MappedFile file;
+        std::vector<Record> records;
+        size_t drawings = 0;
+        size_t valid_size = 0;
+        uint32_t version = 0;
+    };
+}
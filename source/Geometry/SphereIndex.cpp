@@ -0,0 +1,515 @@
+#include "SphereIndex.h"
+#include "SphereUnfold.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+namespace Geometry{
+    static const int N = SphereIndex::BINS_PER_FACE;
+    static const int TILE = SphereIndex::BINS_PER_TILE;
+    static const int T = N / TILE;
+
+    /* Queries compare cosines, the acos is only taken for the reported angle */
+
+    /* Direction of a vertex seen from the sphere center */
+    static inline glm::dvec3 vertexDirection(const double* vertex){
+        return glm::dvec3(vertex[0], vertex[1] - camera_y_shift, vertex[2]);
+    }
+
+    static inline glm::dvec3 unitDirection(const double* vertex){
+        glm::dvec3 direction = vertexDirection(vertex);
+        double length = glm::length(direction);
+        return length > 0.0 ? direction / length : glm::dvec3(0.0, 0.0, -1.0);
+    }
+
+    /* Cos of the angle between a unit direction and the chord between the directions of two vertices */
+    static double segmentCos(const double* a, const double* b, const glm::dvec3& direction){
+        glm::dvec3 ua = unitDirection(a), ub = unitDirection(b);
+        glm::dvec3 chord = ub - ua;
+        double length2 = glm::dot(chord, chord);
+        double t = length2 > 0.0 ? std::min(1.0, std::max(0.0, glm::dot(direction - ua, chord) / length2)) : 0.0;
+        glm::dvec3 closest = ua + t * chord;
+        return glm::dot(closest, direction) / glm::length(closest);
+    }
+
+    /* Point of a cube face: u, v in [-1, 1] */
+    static glm::dvec3 faceDirection(int face, double u, double v){
+        switch(face){
+        case 0:
+            return glm::dvec3(1.0, u, v);
+        case 1:
+            return glm::dvec3(-1.0, u, v);
+        case 2:
+            return glm::dvec3(u, 1.0, v);
+        case 3:
+            return glm::dvec3(u, -1.0, v);
+        case 4:
+            return glm::dvec3(u, v, 1.0);
+        default:
+            return glm::dvec3(u, v, -1.0);
+        }
+    }
+
+    /* A box is outside of the frustum if its corner furthest along the normal of a plane is behind that plane */
+    static bool boxVisible(const glm::vec4 planes[6], const glm::vec3& min, const glm::vec3& max){
+        for(int plane = 0; plane < 6; ++plane){
+            const glm::vec4& p = planes[plane];
+            glm::vec3 corner(p.x > 0.0f ? max.x : min.x, p.y > 0.0f ? max.y : min.y, p.z > 0.0f ? max.z : min.z);
+            if(p.x * corner.x + p.y * corner.y + p.z * corner.z + p.w < 0.0f){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* The angle to the center is at most reach + angle: cos(reach + angle) by the sum formula, everything is hit
+       once the sum reaches PI */
+    static inline bool capHit(const glm::dvec3& center, double cos_reach, double sin_reach, const glm::dvec3& direction,
+                              double cos_angle, double sin_angle){
+        return cos_angle <= -cos_reach || glm::dot(center, direction) >= cos_reach * cos_angle - sin_reach * sin_angle;
+    }
+
+    SphereIndex::SphereIndex() : bins(6 * N * N), tiles(6 * T * T), bin_centers(6 * N * N), tile_centers(6 * T * T){
+        for(int face = 0; face < 6; ++face){
+            for(int i = 0; i < N; ++i){
+                for(int j = 0; j < N; ++j){
+                    double u = (i + 0.5) / N * 2.0 - 1.0, v = (j + 0.5) / N * 2.0 - 1.0;
+                    bin_centers[(face * N + i) * N + j] = glm::normalize(faceDirection(face, u, v));
+                }
+            }
+            for(int i = 0; i < T; ++i){
+                for(int j = 0; j < T; ++j){
+                    double u = (i + 0.5) / T * 2.0 - 1.0, v = (j + 0.5) / T * 2.0 - 1.0;
+                    tile_centers[(face * T + i) * T + j] = glm::normalize(faceDirection(face, u, v));
+                }
+            }
+        }
+    }
+
+    void SphereIndex::Bounds::add(const glm::dvec3& center, const double* a, const double* b, const glm::dvec3& ua, const glm::dvec3& ub){
+        glm::vec3 pa((float)a[0], (float)a[1], (float)a[2]), pb((float)b[0], (float)b[1], (float)b[2]);
+        min = glm::min(min, glm::min(pa, pb));
+        max = glm::max(max, glm::max(pa, pb));
+
+        /* The chord between two directions stays inside the cap holding both of them */
+        double cos_angle = std::min(glm::dot(center, ua), glm::dot(center, ub));
+        if(cos_angle < cos_reach){
+            cos_reach = std::max(-1.0, cos_angle);
+            sin_reach = std::sqrt(1.0 - cos_reach * cos_reach);
+        }
+        ++segments;
+    }
+
+    size_t SphereIndex::tileOf(size_t bin){
+        size_t face = bin / (N * N), i = bin / N % N, j = bin % N;
+        return (face * T + i / TILE) * T + j / TILE;
+    }
+
+    size_t SphereIndex::binOf(const glm::dvec3& direction){
+        glm::dvec3 a = glm::abs(direction);
+        int face;
+        double major, u, v;
+        if(a.x >= a.y && a.x >= a.z){
+            face = direction.x > 0.0 ? 0 : 1;
+            major = a.x;
+            u = direction.y;
+            v = direction.z;
+        }
+        else if(a.y >= a.z){
+            face = direction.y > 0.0 ? 2 : 3;
+            major = a.y;
+            u = direction.x;
+            v = direction.z;
+        }
+        else{
+            face = direction.z > 0.0 ? 4 : 5;
+            major = a.z;
+            u = direction.x;
+            v = direction.y;
+        }
+        if(!(major > 0.0)){
+            return 0;
+        }
+        int i = std::min(N - 1, std::max(0, (int)((u / major + 1.0) * 0.5 * N)));
+        int j = std::min(N - 1, std::max(0, (int)((v / major + 1.0) * 0.5 * N)));
+        return (face * N + i) * N + j;
+    }
+
+    void SphereIndex::reset(){
+        for(Bin& bin : bins){
+            bin = Bin();
+        }
+        for(Bounds& tile : tiles){
+            tile = Bounds();
+        }
+        synced.clear();
+        indexed.clear();
+        strip_bins.clear();
+        segment_count = 0;
+    }
+
+    template<typename Strips>
+    void SphereIndex::sync(const Strips& strips, size_t mutableTail){
+        if(strips.size() < synced.size()){
+            reset();
+        }
+
+        /* Strips before the last known one are finished, only the last one may have grown */
+        for(size_t strip_num = synced.empty() ? 0 : synced.size() - 1; strip_num < strips.size(); ++strip_num){
+            if(strip_num == synced.size()){
+                synced.push_back(0);
+                indexed.push_back(0);
+                strip_bins.emplace_back();
+            }
+            size_t vertices = strips[strip_num].size() / VERTEX_STRIDE;
+            if(vertices < synced[strip_num]){
+                reset();
+                sync(strips, mutableTail);
+                return;
+            }
+            synced[strip_num] = vertices;
+            indexStrip(strips, strip_num, strip_num + 1 == strips.size() ? vertices - std::min(vertices, mutableTail) : vertices);
+        }
+    }
+
+    template<typename Strips>
+    void SphereIndex::indexStrip(const Strips& strips, size_t strip, size_t finalVertices){
+        size_t segment = indexed[strip];
+        const double* vertices = strips[strip].data();
+        for(; segment + 1 < finalVertices; ++segment){
+            indexSegment(vertices, strip, segment);
+        }
+        indexed[strip] = segment;
+    }
+
+    void SphereIndex::indexSegment(const double* vertices, size_t strip_num, size_t segment){
+        const double* a = vertices + segment * VERTEX_STRIDE;
+        const double* b = a + VERTEX_STRIDE;
+
+        glm::dvec3 ua = unitDirection(a), ub = unitDirection(b);
+        size_t bin_num = binOf(ua + ub);
+        Bin& bin = bins[bin_num];
+
+        /* Consecutive segments of a strip in the same bin extend its last run */
+        if(!bin.runs.empty() && bin.runs.back().strip == strip_num && bin.runs.back().first + bin.runs.back().count - 1 == segment){
+            ++bin.runs.back().count;
+        }
+        else{
+            bin.runs.push_back({(uint32_t)strip_num, (uint32_t)segment, 2});
+            std::vector<uint32_t>& owned = strip_bins[strip_num];
+            if(owned.empty() || owned.back() != bin_num){
+                owned.push_back((uint32_t)bin_num);
+            }
+        }
+
+        bin.bounds.add(bin_centers[bin_num], a, b, ua, ub);
+        size_t tile_num = tileOf(bin_num);
+        tiles[tile_num].add(tile_centers[tile_num], a, b, ua, ub);
+        ++segment_count;
+    }
+
+    void SphereIndex::unindexStrip(size_t strip){
+        /* Bounds and reach of the bins stay as they were, they are only conservative afterwards */
+        for(uint32_t bin_num : strip_bins[strip]){
+            std::vector<StripRange>& runs = bins[bin_num].runs;
+            for(const StripRange& run : runs){
+                if(run.strip == strip){
+                    bins[bin_num].bounds.segments -= run.count - 1;
+                    tiles[tileOf(bin_num)].segments -= run.count - 1;
+                    segment_count -= run.count - 1;
+                }
+            }
+            runs.erase(std::remove_if(runs.begin(), runs.end(), [&](const StripRange& run){ return run.strip == strip; }), runs.end());
+        }
+        strip_bins[strip].clear();
+        indexed[strip] = 0;
+    }
+
+    void SphereIndex::removeStrips(const std::vector<size_t>& strips){
+        if(strips.empty() || strips[0] >= synced.size()){
+            return;
+        }
+        /* Only the bins of the strips that move are touched, a strip keeps its old number until it is visited */
+        size_t removed = 0, kept = strips[0];
+        for(size_t strip = strips[0]; strip < synced.size(); ++strip){
+            if(removed < strips.size() && strips[removed] == strip){
+                unindexStrip(strip);
+                ++removed;
+                continue;
+            }
+            moveStrip(strip, kept++);
+        }
+        synced.resize(kept);
+        indexed.resize(kept);
+        strip_bins.resize(kept);
+    }
+
+    void SphereIndex::insertStrips(const std::vector<size_t>& strips){
+        if(strips.empty()){
+            return;
+        }
+        /* From the back, so a strip only moves to a number the strips after it left */
+        size_t left = strips.size(), strip = synced.size() + strips.size();
+        synced.resize(strip);
+        indexed.resize(strip);
+        strip_bins.resize(strip);
+        while(left > 0){
+            --strip;
+            if(strips[left - 1] == strip){
+                synced[strip] = 0;
+                indexed[strip] = 0;
+                strip_bins[strip].clear();
+                --left;
+                continue;
+            }
+            moveStrip(strip - left, strip);
+        }
+    }
+
+    void SphereIndex::moveStrip(size_t from, size_t to){
+        if(from == to){
+            return;
+        }
+        for(uint32_t bin_num : strip_bins[from]){
+            for(StripRange& run : bins[bin_num].runs){
+                if(run.strip == from){
+                    run.strip = (uint32_t)to;
+                }
+            }
+        }
+        synced[to] = synced[from];
+        indexed[to] = indexed[from];
+        strip_bins[to] = std::move(strip_bins[from]);
+    }
+
+    void SphereIndex::collectVisible(const glm::mat4& clip, std::vector<StripRange>& ranges) const{
+        /* Frustum planes of the clip matrix(Gribb-Hartmann) */
+        glm::vec4 rows[4];
+        for(int row = 0; row < 4; ++row){
+            rows[row] = glm::vec4(clip[0][row], clip[1][row], clip[2][row], clip[3][row]);
+        }
+        const glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2]};
+
+        forEachBin([&](const Bounds& bounds, const glm::dvec3&){ return boxVisible(planes, bounds.min, bounds.max); }, [&](const Bin& bin){
+            ranges.insert(ranges.end(), bin.runs.begin(), bin.runs.end());
+        });
+
+        /* The floating end of the stroke being drawn is not indexed yet */
+        if(!synced.empty() && indexed.back() + 1 < synced.back()){
+            ranges.push_back({(uint32_t)(synced.size() - 1), (uint32_t)indexed.back(), (uint32_t)(synced.back() - indexed.back())});
+        }
+    }
+
+    template<typename Test, typename Visit>
+    void SphereIndex::forEachBin(Test test, Visit visit) const{
+        for(size_t face = 0; face < 6; ++face){
+            for(size_t ti = 0; ti < T; ++ti){
+                for(size_t tj = 0; tj < T; ++tj){
+                    const Bounds& tile = tiles[(face * T + ti) * T + tj];
+                    if(tile.segments == 0 || !test(tile, tile_centers[(face * T + ti) * T + tj])){
+                        continue;
+                    }
+                    for(size_t i = ti * TILE; i < (ti + 1) * TILE; ++i){
+                        for(size_t j = tj * TILE; j < (tj + 1) * TILE; ++j){
+                            size_t bin_num = (face * N + i) * N + j;
+                            const Bin& bin = bins[bin_num];
+                            if(bin.bounds.segments != 0 && test(bin.bounds, bin_centers[bin_num])){
+                                visit(bin);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Visit>
+    void SphereIndex::visitBins(const glm::dvec3& direction, double angle, Visit visit) const{
+        double cos_angle = std::cos(angle), sin_angle = std::sin(angle);
+        forEachBin([&](const Bounds& bounds, const glm::dvec3& center){
+            return capHit(center, bounds.cos_reach, bounds.sin_reach, direction, cos_angle, sin_angle);
+        }, visit);
+    }
+
+    template<typename Strips>
+    bool SphereIndex::pick(const Strips& strips, const glm::dvec3& direction, double maxAngle, StrokeHit& hit) const{
+        glm::dvec3 d = glm::normalize(direction);
+        bool found = false;
+        double best = std::cos(maxAngle);
+        visitBins(d, maxAngle, [&](const Bin& bin){
+            for(const StripRange& run : bin.runs){
+                const double* vertices = strips[run.strip].data();
+                for(size_t segment = run.first; segment + 1 < run.first + run.count; ++segment){
+                    double cos_angle = segmentCos(vertices + segment * VERTEX_STRIDE, vertices + (segment + 1) * VERTEX_STRIDE, d);
+                    if(cos_angle >= best){
+                        hit.strip = run.strip;
+                        hit.segment = segment;
+                        best = cos_angle;
+                        found = true;
+                    }
+                }
+            }
+        });
+        hit.angle = std::acos(std::min(1.0, best));
+        return found;
+    }
+
+    size_t SphereIndex::erase(StrokeArena& strips, const glm::dvec3& direction, double radius, size_t mutableTail,
+                              StrokeChanges* changes){
+        if(changes){
+            changes->clear();
+        }
+        glm::dvec3 d = glm::normalize(direction);
+        std::vector<std::pair<uint32_t, uint32_t>> erased;
+        double cos_radius = std::cos(radius);
+        visitBins(d, radius, [&](const Bin& bin){
+            for(const StripRange& run : bin.runs){
+                const double* vertices = strips[run.strip].data();
+                for(uint32_t segment = run.first; segment + 1 < run.first + run.count; ++segment){
+                    if(segmentCos(vertices + segment * VERTEX_STRIDE, vertices + (segment + 1) * VERTEX_STRIDE, d) >= cos_radius){
+                        erased.push_back({run.strip, segment});
+                    }
+                }
+            }
+        });
+        if(erased.empty()){
+            return 0;
+        }
+        std::sort(erased.begin(), erased.end());
+
+        /* Only the hit strips are cut, every piece keeps at least one segment */
+        std::vector<size_t> changed, removed;
+        std::vector<std::pair<size_t, size_t>> pieces;
+        std::vector<uint32_t> piece_ids;
+        std::vector<double> old, cut;
+        for(size_t hit = 0; hit < erased.size();){
+            size_t strip = erased[hit].first;
+            old.assign(strips[strip].begin(), strips[strip].end());
+            unindexStrip(strip);
+
+            /* The other pieces are kept as ranges of the cut copy until the strips can be inserted */
+            size_t vertices = old.size() / VERTEX_STRIDE, piece_start = 0;
+            bool first_piece = true;
+            auto emit = [&](size_t from, size_t to){
+                if(to <= from){
+                    return;
+                }
+                if(first_piece){
+                    strips.assign(strip, old.data() + from * VERTEX_STRIDE, (to + 1 - from) * VERTEX_STRIDE);
+                    changed.push_back(strip);
+                    first_piece = false;
+                }
+                else{
+                    pieces.push_back({cut.size(), (to + 1 - from) * VERTEX_STRIDE});
+                    piece_ids.push_back(strips.strokeId(strip));
+                    cut.insert(cut.end(), old.begin() + from * VERTEX_STRIDE, old.begin() + (to + 1) * VERTEX_STRIDE);
+                }
+            };
+            for(; hit < erased.size() && erased[hit].first == strip; ++hit){
+                size_t segment = erased[hit].second;
+                emit(piece_start, segment);
+                piece_start = segment + 1;
+            }
+            emit(piece_start, vertices - 1);
+            if(first_piece){
+                removed.push_back(strip);
+            }
+        }
+
+        size_t position = !strips.empty() && strips.back().empty() ? strips.size() - 1 : strips.size();
+        size_t added = pieces.size();
+        strips.insertStrokes(position, added);
+        for(size_t piece = 0; piece < added; ++piece){
+            strips.append(position + piece, cut.data() + pieces[piece].first, pieces[piece].second);
+            strips.setStrokeId(position + piece, piece_ids[piece]);
+        }
+        if(position <= synced.size()){
+            synced.insert(synced.begin() + position, added, 0);
+            indexed.insert(indexed.begin() + position, added, 0);
+            strip_bins.insert(strip_bins.begin() + position, added, std::vector<uint32_t>());
+            for(size_t strip = position; strip < position + added; ++strip){
+                changed.push_back(strip);
+            }
+        }
+
+        for(size_t strip : changed){
+            size_t vertices = strips[strip].size() / VERTEX_STRIDE;
+            synced[strip] = vertices;
+            indexStrip(strips, strip, strip + 1 == strips.size() ? vertices - std::min(vertices, mutableTail) : vertices);
+        }
+
+        /* The emptied strips all lie before the inserted pieces, their removal does not move them apart */
+        strips.removeStrokes(removed);
+        removeStrips(removed);
+
+        if(changes){
+            changes->removed = removed;
+            size_t removed_before = 0;
+            for(size_t strip : changed){
+                if(strip >= position){
+                    break;
+                }
+                while(removed_before < removed.size() && removed[removed_before] < strip){
+                    ++removed_before;
+                }
+                changes->changed.push_back(strip - removed_before);
+            }
+            for(size_t piece = 0; piece < added; ++piece){
+                changes->inserted.push_back(position - removed.size() + piece);
+                changes->changed.push_back(position - removed.size() + piece);
+            }
+        }
+        return erased.size();
+    }
+
+    void SphereIndex::eraseStroke(StrokeArena& strips, uint32_t strokeId, StrokeChanges* changes){
+        std::vector<size_t> removed;
+        strips.findStroke(strokeId, removed);
+        strips.removeStrokes(removed);
+        removeStrips(removed);
+        if(changes){
+            changes->clear();
+            changes->removed = std::move(removed);
+        }
+    }
+
+    template<typename Strips>
+    void SphereIndex::apply(const Strips& strips, const StrokeChanges& changes, size_t mutableTail){
+        std::vector<size_t> removed, inserted, changed;
+        size_t walked = changes.walk(synced.size(),
+            [&](size_t before){
+                removed.push_back(before);
+            },
+            [&](size_t after){
+                inserted.push_back(after);
+                changed.push_back(after);
+            },
+            [&](size_t before, size_t after, bool isChanged){
+                if(isChanged){
+                    unindexStrip(before);
+                    changed.push_back(after);
+                }
+            });
+        /* The last strip, if it changed, is indexed again by the next sync */
+        for(size_t strip = walked; strip < synced.size(); ++strip){
+            removed.push_back(strip);
+        }
+        removeStrips(removed);
+        insertStrips(inserted);
+
+        for(size_t strip : changed){
+            size_t vertices = strips[strip].size() / VERTEX_STRIDE;
+            synced[strip] = vertices;
+            indexStrip(strips, strip, strip + 1 == strips.size() ? vertices - std::min(vertices, mutableTail) : vertices);
+        }
+    }
+
+    template void SphereIndex::sync(const std::vector<std::vector<double>>& strips, size_t mutableTail);
+    template void SphereIndex::sync(const StrokeArena& strips, size_t mutableTail);
+    template bool SphereIndex::pick(const std::vector<std::vector<double>>& strips, const glm::dvec3& direction, double maxAngle, StrokeHit& hit) const;
+    template bool SphereIndex::pick(const StrokeArena& strips, const glm::dvec3& direction, double maxAngle, StrokeHit& hit) const;
+    template void SphereIndex::apply(const std::vector<std::vector<double>>& strips, const StrokeChanges& changes, size_t mutableTail);
+    template void SphereIndex::apply(const StrokeArena& strips, const StrokeChanges& changes, size_t mutableTail);
+}
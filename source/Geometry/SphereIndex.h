@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "StrokeArena.h"
+
+namespace Geometry{
+    /* Vertices [first, first + count) of a strip */
+    struct StripRange{
+        uint32_t strip, first, count;
+    };
+
+    /* Segment found by SphereIndex::pick(): vertices segment and segment + 1 of the strip */
+    struct StrokeHit{
+        size_t strip = 0, segment = 0;
+        /* Angle between the query direction and the segment, in radians */
+        double angle = 0.0;
+    };
+
+    /*
+        Spatial index of stroke segments on the drawing sphere. Directions from the sphere center are binned on
+        the six faces of a cube(BINS_PER_FACE^2 bins per face, about 2.8 degrees each), grouped into tiles of
+        BINS_PER_TILE^2 bins. A bin keeps runs of consecutive segments of the strips passing through it; bins and
+        tiles keep a world space bounding box for frustum culling and the angular reach of their segments for
+        picking and erasing. Queries test the tiles and then the bins of the tiles they hit, so their cost
+        follows the part of the sphere they cover, not the size of the drawing.
+    */
+    class SphereIndex{
+    public:
+        static const int BINS_PER_FACE = 32;
+        static const int BINS_PER_TILE = 8;
+
+        SphereIndex();
+
+        /*
+            Indexes the segments added since the previous call. Like StrokeStore::sync(), strips are expected to
+            only grow at the end, the last mutableTail vertices of the last strip are indexed once they are final.
+            A strip that got shorter(a cleared drawing) rebuilds the index. Strips is std::vector<std::vector<double>>
+            or StrokeArena.
+        */
+        template<typename Strips>
+        void sync(const Strips& strips, size_t mutableTail = 0);
+        void reset();
+
+        /* Vertex ranges of the bins inside the frustum(clip = projection * view), plus the not yet indexed end of the last strip */
+        void collectVisible(const glm::mat4& clip, std::vector<StripRange>& ranges) const;
+
+        /* The segment closest to the direction(from the sphere center) within maxAngle radians, false if there is none */
+        template<typename Strips>
+        bool pick(const Strips& strips, const glm::dvec3& direction, double maxAngle, StrokeHit& hit) const;
+
+        /*
+            Removes the indexed segments within radius radians of the direction and splits the strips where they
+            were removed: the first remaining piece keeps the place of the strip, the other pieces become new strips
+            in front of a trailing empty strip(the one collecting the next stroke), and strips with nothing left are
+            removed(StrokeArena::removeStrokes()). The pieces keep the stroke id of their strip. Returns the number
+            of removed segments, changes(if given) gets the strips that changed for the other consumers of the strips.
+        */
+        size_t erase(StrokeArena& strips, const glm::dvec3& direction, double radius, size_t mutableTail = 0,
+                     StrokeChanges* changes = nullptr);
+
+        /* Removes the strips of the stroke(StrokeArena::strokeId(), every piece erasing left of it) from the strips
+           and the index, the strips after them move forward */
+        void eraseStroke(StrokeArena& strips, uint32_t strokeId, StrokeChanges* changes = nullptr);
+
+        /* Follows strips changed by someone else(an undo): the removed and changed strips are unindexed, the
+           changed ones indexed again, the others keep their segments and are only renumbered */
+        template<typename Strips>
+        void apply(const Strips& strips, const StrokeChanges& changes, size_t mutableTail = 0);
+
+        size_t getSegmentCount() const { return segment_count; }
+
+    private:
+        /* Bounds of the segments of a bin or a tile, they only grow(erased segments leave them conservative) */
+        struct Bounds{
+            glm::vec3 min = glm::vec3(1e30f), max = glm::vec3(-1e30f);
+            /* Cos and sin of the angle from the center direction containing every segment */
+            double cos_reach = 1.0, sin_reach = 0.0;
+            size_t segments = 0;
+
+            void add(const glm::dvec3& center, const double* a, const double* b, const glm::dvec3& ua, const glm::dvec3& ub);
+        };
+        struct Bin{
+            /* Vertex ranges, every range of n vertices holds n - 1 segments of this bin */
+            std::vector<StripRange> runs;
+            Bounds bounds;
+        };
+        std::vector<Bin> bins;
+        std::vector<Bounds> tiles;
+
+        /* Center directions of the bins and of the tiles */
+        std::vector<glm::dvec3> bin_centers, tile_centers;
+
+        /* Vertices seen and segments indexed per strip, and the bins holding segments of the strip */
+        std::vector<size_t> synced, indexed;
+        std::vector<std::vector<uint32_t>> strip_bins;
+        size_t segment_count = 0;
+
+        static size_t binOf(const glm::dvec3& direction);
+        static size_t tileOf(size_t bin);
+        template<typename Strips>
+        void indexStrip(const Strips& strips, size_t strip, size_t finalVertices);
+        void indexSegment(const double* vertices, size_t strip_num, size_t segment);
+        void unindexStrip(size_t strip);
+        /* Forgets the strips(ascending) and renumbers the runs of the strips after them */
+        void removeStrips(const std::vector<size_t>& strips);
+        /* Empty strips at the positions(ascending, numbered after the insertion), the strips after them are renumbered */
+        void insertStrips(const std::vector<size_t>& strips);
+        /* Gives the strip another number, nothing may hold that one */
+        void moveStrip(size_t from, size_t to);
+
+        /* Calls visit(bin) for the non-empty bins passing test(bounds, center), only tested in the tiles passing it */
+        template<typename Test, typename Visit>
+        void forEachBin(Test test, Visit visit) const;
+
+        /* Calls visit(bin) for every bin that may hold segments within angle of the direction */
+        template<typename Visit>
+        void visitBins(const glm::dvec3& direction, double angle, Visit visit) const;
+    };
+}
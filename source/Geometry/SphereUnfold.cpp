@@ -0,0 +1,112 @@
+#include "SphereUnfold.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace Geometry{
+    void vertexToCylinder(double* vertex){
+        double x = vertex[0], y = vertex[1] - camera_y_shift, z = vertex[2];
+        double xzPlaneDistance = glm::distance(glm::dvec3(0.0, 0.0, 0.0), glm::dvec3(x, 0.0, z));
+        double y_angle = glm::degrees(glm::asin(y / S_RADIUS));
+
+        vertex[0] = x / xzPlaneDistance * S_RADIUS;
+        vertex[1] = PI * S_RADIUS / 2 * y_angle / 90 + camera_y_shift;
+        vertex[2] = z / xzPlaneDistance * S_RADIUS;
+    }
+
+    void projectVertex(double* vertex){
+        double x = vertex[0], z = vertex[2], z_asin = glm::asin(-z / S_RADIUS);
+        if(!std::signbit(x)){
+            vertex[0] = PI / 2 - z_asin;
+        }
+        else if(x != 0.0f){
+            vertex[0] = -PI / 2 + z_asin;
+        }
+        vertex[2] = -S_RADIUS;
+    }
+
+    /* The seam is x = 0 on the back(z > 0) side of the cylinder */
+    bool crossesSeam(const double* prev, const double* curr){
+        return curr[2] > 0.00001f && int(std::signbit(curr[0])) + int(std::signbit(prev[0])) == 1;
+    }
+
+    void seamVertices(const double* prev, const double* curr, double closing[6], double opening[6]){
+        double z_inter = -curr[0] * (prev[2] - curr[2]) / (prev[0] - curr[0]) + curr[2];
+        double y_inter = -curr[0] * (prev[1] - curr[1]) / (prev[0] - curr[0]) + curr[1];
+        double seam_x = std::signbit(prev[0]) ? -0.000001f : 0.000001f;
+
+        const double closing_vertex[6] = {seam_x, y_inter, z_inter, prev[3], prev[4], prev[5]};
+        const double opening_vertex[6] = {-seam_x, y_inter, z_inter, prev[3], prev[4], prev[5]};
+        std::copy(closing_vertex, closing_vertex + 6, closing);
+        std::copy(opening_vertex, opening_vertex + 6, opening);
+    }
+
+    void toCylinder(std::vector<std::vector<double>>& strips, size_t first_strip){
+        for (size_t strip_num = first_strip; strip_num < strips.size(); ++strip_num){
+            std::vector<double>* strip = strips.data() + strip_num;
+            for(size_t v_num = 0; v_num < strip->size(); v_num += VERTEX_STRIDE){
+                vertexToCylinder(strip->data() + v_num);
+            }
+        }
+    }
+
+    void splitSeam(std::vector<std::vector<double>>& strips, size_t first_strip){
+        std::vector<std::vector<double>> result;
+        result.reserve(strips.size() + 8);
+        for(size_t strip_num = 0; strip_num < strips.size() && strip_num < first_strip; ++strip_num){
+            result.push_back(std::move(strips[strip_num]));
+        }
+
+        for(size_t strip_num = first_strip; strip_num < strips.size(); ++strip_num){
+            std::vector<double>& strip = strips[strip_num];
+
+            size_t v_num = VERTEX_STRIDE;
+            while(v_num < strip.size() && !crossesSeam(strip.data() + v_num - VERTEX_STRIDE, strip.data() + v_num)){
+                v_num += VERTEX_STRIDE;
+            }
+            if(v_num >= strip.size()){
+                /* Most strips never reach the seam and are moved over as they are */
+                result.push_back(std::move(strip));
+                continue;
+            }
+
+            /* Streaming pass: every crossing closes the current piece with the interpolated seam vertex and opens
+               the next one with its mirrored copy, so nothing is ever inserted in the middle of a vector */
+            std::vector<double> piece(strip.begin(), strip.begin() + v_num);
+            for(; v_num < strip.size(); v_num += VERTEX_STRIDE){
+                const double* prev = strip.data() + v_num - VERTEX_STRIDE;
+                const double* curr = strip.data() + v_num;
+                if(crossesSeam(prev, curr)){
+                    double closing[VERTEX_STRIDE], opening[VERTEX_STRIDE];
+                    seamVertices(prev, curr, closing, opening);
+
+                    piece.insert(piece.end(), closing, closing + VERTEX_STRIDE);
+                    result.push_back(std::move(piece));
+
+                    piece = std::vector<double>(opening, opening + VERTEX_STRIDE);
+                    piece.reserve(strip.size() - v_num + VERTEX_STRIDE);
+                }
+                piece.insert(piece.end(), curr, curr + VERTEX_STRIDE);
+            }
+            result.push_back(std::move(piece));
+        }
+        strips.swap(result);
+    }
+
+    void projectPoints(std::vector<std::vector<double>>& strips, size_t first_strip){
+        /* Unfold the surface of a cylinder */
+        for (size_t strip_num = first_strip; strip_num < strips.size(); ++strip_num){
+            std::vector<double>* strip = strips.data() + strip_num;
+            for(size_t v_num = 0; v_num < strip->size(); v_num += VERTEX_STRIDE){
+                projectVertex(strip->data() + v_num);
+            }
+        }
+    }
+
+    void unfold(std::vector<std::vector<double>>& strips, size_t first_strip){
+        toCylinder(strips, first_strip);
+        splitSeam(strips, first_strip);
+        projectPoints(strips, first_strip);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*
+    Sphere -> cylinder -> plane unfolding of the drawn strips. Every strip is a flat vector of interleaved
+    XYZRGB doubles, exactly as it is stored by the interactive drawer. Nothing in here touches OpenGL,
+    so the same code runs inside the window loop and in headless batch jobs.
+*/
+namespace Geometry{
+    const double PI = 3.14159265358;
+
+    /* Radius of the sphere to draw on and vertical shift of its center(the camera position) */
+    const double S_RADIUS = 0.7f;
+    const double camera_y_shift = 1.0f;
+
+    /* Number of doubles per vertex in a strip: X, Y, Z, R, G, B */
+    const size_t VERTEX_STRIDE = 6;
+
+    /* Moves vertices from the "sphere" to the "cylinder" view(strips starting from first_strip) */
+    void toCylinder(std::vector<std::vector<double>>& strips, size_t first_strip = 0);
+
+    /* Splits the strips (already in the "cylinder" view) that cross the x = 0 seam on the back side */
+    void splitSeam(std::vector<std::vector<double>>& strips, size_t first_strip = 0);
+
+    /* Unfolds the surface of the cylinder onto the z = -S_RADIUS plane */
+    void projectPoints(std::vector<std::vector<double>>& strips, size_t first_strip = 0);
+
+    /* The whole pipeline: cylinder transform, seam split, and projection */
+    void unfold(std::vector<std::vector<double>>& strips, size_t first_strip = 0);
+
+    /* Single vertex steps of the same pipeline, on the XYZ of an XYZRGB vertex(for code unfolding vertex by vertex) */
+    void vertexToCylinder(double* vertex);
+    void projectVertex(double* vertex);
+
+    /* True if the segment prev -> curr(in the "cylinder" view) crosses the seam */
+    bool crossesSeam(const double* prev, const double* curr);
+
+    /* The crossing point of such a segment: closing ends the piece before the seam, opening starts the next one */
+    void seamVertices(const double* prev, const double* curr, double closing[6], double opening[6]);
+}
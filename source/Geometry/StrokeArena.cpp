@@ -0,0 +1,645 @@
+#include "StrokeArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace Geometry{
+    StrokeView StrokeArena::operator[](size_t strip) const{
+        const Slot& slot = slots[order[strip]];
+        return StrokeView(slot.data, slot.size);
+    }
+
+    uint32_t StrokeArena::newSlot(){
+        uint32_t slot_num;
+        if(!free_slots.empty()){
+            slot_num = free_slots.back();
+            free_slots.pop_back();
+        }
+        else{
+            slot_num = (uint32_t)slots.size();
+            slots.emplace_back();
+        }
+        slots[slot_num].stroke_id = next_stroke_id++;
+        return slot_num;
+    }
+
+    uint32_t StrokeArena::newRun(){
+        if(!free_runs.empty()){
+            uint32_t run_num = free_runs.back();
+            free_runs.pop_back();
+            return run_num;
+        }
+        runs.emplace_back();
+        return (uint32_t)runs.size() - 1;
+    }
+
+    void StrokeArena::joinRun(size_t strip){
+        uint32_t run_num;
+        if(strip > 0){
+            run_num = slots[order[strip - 1]].run;
+        }
+        else if(!run_order.empty()){
+            run_num = run_order.front();
+        }
+        else{
+            run_num = newRun();
+            run_order.push_back(run_num);
+        }
+        slots[order[strip]].run = run_num;
+        ++runs[run_num].count;
+        runs[run_num].dirty = true;
+    }
+
+    StrokeHandle StrokeArena::addStroke(){
+        uint32_t slot_num = newSlot();
+        slots[slot_num].position = (uint32_t)order.size();
+        order.push_back(slot_num);
+        /* A full run is left as it is, it keeps its page for the next snapshot */
+        if(!run_order.empty() && runs[run_order.back()].count >= PAGE_STROKES){
+            uint32_t run_num = newRun();
+            run_order.push_back(run_num);
+            slots[slot_num].run = run_num;
+            runs[run_num].count = 1;
+            runs[run_num].dirty = true;
+        }
+        else{
+            joinRun(order.size() - 1);
+        }
+        return {slot_num, slots[slot_num].generation};
+    }
+
+    StrokeHandle StrokeArena::insertStroke(size_t position){
+        insertStrokes(position, 1);
+        return handle(position);
+    }
+
+    void StrokeArena::insertStrokes(size_t position, size_t count){
+        if(count == 0){
+            return;
+        }
+        order.insert(order.begin() + position, count, 0);
+        for(size_t strip = position; strip < position + count; ++strip){
+            order[strip] = newSlot();
+        }
+        for(size_t strip = position; strip < order.size(); ++strip){
+            slots[order[strip]].position = (uint32_t)strip;
+        }
+        for(size_t strip = position; strip < position + count; ++strip){
+            joinRun(strip);
+        }
+    }
+
+    void StrokeArena::insertStrokes(const std::vector<size_t>& positions){
+        if(positions.empty()){
+            return;
+        }
+        /* From the back, so every stroke moves once */
+        size_t left = positions.size(), strip = order.size() + positions.size();
+        order.resize(strip);
+        while(left > 0){
+            --strip;
+            if(positions[left - 1] == strip){
+                order[strip] = newSlot();
+                --left;
+            }
+            else{
+                order[strip] = order[strip - left];
+            }
+            slots[order[strip]].position = (uint32_t)strip;
+        }
+        for(size_t strip : positions){
+            joinRun(strip);
+        }
+    }
+
+    void StrokeArena::removeStroke(size_t strip){
+        removeStrokes({strip});
+    }
+
+    void StrokeArena::removeStrokes(const std::vector<size_t>& strips){
+        if(strips.empty()){
+            return;
+        }
+        size_t removed = 0, kept = strips[0];
+        for(size_t strip = strips[0]; strip < order.size(); ++strip){
+            uint32_t slot_num = order[strip];
+            Slot& slot = slots[slot_num];
+            if(removed < strips.size() && strips[removed] == strip){
+                --runs[slot.run].count;
+                runs[slot.run].dirty = true;
+                release(slot);
+                ++slot.generation;
+                free_slots.push_back(slot_num);
+                ++removed;
+                continue;
+            }
+            slot.position = (uint32_t)kept;
+            order[kept++] = slot_num;
+        }
+        order.resize(kept);
+    }
+
+    void StrokeArena::assign(size_t strip, const double* values, size_t count){
+        truncate(strip, 0);
+        append(strip, values, count);
+    }
+
+    void StrokeArena::truncate(size_t strip, size_t size){
+        Slot& slot = slots[order[strip]];
+        if(size < slot.size){
+            stored -= slot.size - size;
+            slot.size = size;
+            runs[slot.run].dirty = true;
+        }
+    }
+
+    double* StrokeArena::mutableData(size_t strip){
+        Slot& slot = slots[order[strip]];
+        makeWritable(slot);
+        runs[slot.run].dirty = true;
+        return slot.data;
+    }
+
+    void StrokeArena::clear(){
+        for(uint32_t slot_num : order){
+            Slot& slot = slots[slot_num];
+            release(slot);
+            ++slot.generation;
+            free_slots.push_back(slot_num);
+        }
+        order.clear();
+        for(uint32_t run_num : run_order){
+            runs[run_num] = Run();
+            free_runs.push_back(run_num);
+        }
+        run_order.clear();
+    }
+
+    StrokeArena::Snapshot StrokeArena::snapshot(){
+        /* The strokes of the dirty runs go to new pages, the dirty runs next to each other together */
+        std::vector<uint32_t> next_order;
+        next_order.reserve(run_order.size());
+        size_t position = 0, pending = 0;
+        auto flush = [&](){
+            while(pending > 0){
+                size_t count = pending < PAGE_STROKES ? pending : PAGE_STROKES;
+                uint32_t run_num = newRun();
+                Page* page = freeze(position - pending, count, run_num);
+                runs[run_num].page = page;
+                runs[run_num].count = (uint32_t)count;
+                runs[run_num].dirty = false;
+                next_order.push_back(run_num);
+                pending -= count;
+            }
+        };
+        for(uint32_t run_num : run_order){
+            Run& run = runs[run_num];
+            size_t count = run.count;
+            if(!run.dirty && run.page){
+                flush();
+                next_order.push_back(run_num);
+            }
+            else{
+                pending += count;
+                run = Run();
+                free_runs.push_back(run_num);
+            }
+            position += count;
+        }
+        flush();
+        run_order.swap(next_order);
+
+        Snapshot snapshot;
+        snapshot.arena = this;
+        snapshot.pages.reserve(run_order.size());
+        snapshot.ends.reserve(run_order.size());
+        for(uint32_t run_num : run_order){
+            Page* page = runs[run_num].page;
+            ++page->refs;
+            snapshot.count += page->strokes.size();
+            snapshot.pages.push_back(page);
+            snapshot.ends.push_back(snapshot.count);
+        }
+        return snapshot;
+    }
+
+    StrokeArena::Page* StrokeArena::freeze(size_t first, size_t count, uint32_t run){
+        Page* page = new Page();
+        page->run = run;
+        page->strokes.reserve(count);
+        for(size_t strip = first; strip < first + count; ++strip){
+            Slot& slot = slots[order[strip]];
+            slot.run = run;
+            if(slot.size == 0){
+                page->strokes.push_back({nullptr, 0, NO_SHARE, slot.stroke_id});
+                continue;
+            }
+            if(slot.share == NO_SHARE){
+                uint32_t share_num;
+                if(!free_shares.empty()){
+                    share_num = free_shares.back();
+                    free_shares.pop_back();
+                }
+                else{
+                    share_num = (uint32_t)shares.size();
+                    shares.emplace_back();
+                }
+                /* The drawing holds it too */
+                shares[share_num].data = slot.data;
+                shares[share_num].size_class = slot.size_class;
+                shares[share_num].refs = 1;
+                slot.share = share_num;
+            }
+            Share& share = shares[slot.share];
+            ++share.refs;
+            share.frozen = std::max(share.frozen, slot.size);
+            slot.frozen = share.frozen;
+            page->strokes.push_back({slot.data, slot.size, slot.share, slot.stroke_id});
+        }
+        return page;
+    }
+
+    void StrokeArena::unrefPage(Page* page){
+        if(--page->refs > 0){
+            return;
+        }
+        for(const FrozenStroke& stroke : page->strokes){
+            if(stroke.share != NO_SHARE){
+                unref(stroke.share);
+            }
+        }
+        /* The run has to be frozen again by the next snapshot */
+        if(page->run < runs.size() && runs[page->run].page == page){
+            runs[page->run].page = nullptr;
+            runs[page->run].dirty = true;
+        }
+        delete page;
+    }
+
+    bool StrokeArena::holds(const Slot& slot, const FrozenStroke& stroke){
+        /* The doubles of a share the snapshot saw do not change any more */
+        return slot.share == stroke.share && slot.size == stroke.size && slot.stroke_id == stroke.stroke_id;
+    }
+
+    void StrokeArena::restoreSlot(Slot& slot, const FrozenStroke& stroke){
+        slot.stroke_id = stroke.stroke_id;
+        if(stroke.share != NO_SHARE){
+            Share& share = shares[stroke.share];
+            ++share.refs;
+            slot.data = share.data;
+            slot.size_class = share.size_class;
+            slot.share = stroke.share;
+            /* Snapshots taken after this one may have seen more of the stroke */
+            slot.frozen = share.frozen;
+        }
+        slot.size = stroke.size;
+        stored += stroke.size;
+    }
+
+    void StrokeArena::diff(const Snapshot& snapshot, size_t first, size_t end, size_t snapshotFirst, size_t snapshotEnd,
+                           std::vector<size_t>& removed, std::vector<size_t>& inserted) const{
+        if(first == end && snapshotFirst == snapshotEnd){
+            return;
+        }
+        /* Where each stroke is on the other side: by the share, or the id for the strokes without one */
+        auto key = [](uint32_t share, uint32_t id){
+            return share != NO_SHARE ? (uint64_t)share : (uint64_t)1 << 32 | id;
+        };
+        std::unordered_map<uint64_t, size_t> in_order, in_snapshot;
+        for(size_t strip = first; strip < end; ++strip){
+            const Slot& slot = slots[order[strip]];
+            in_order[key(slot.share, slot.stroke_id)] = strip;
+        }
+        for(size_t strip = snapshotFirst; strip < snapshotEnd; ++strip){
+            const FrozenStroke& stroke = snapshot.stroke(strip);
+            in_snapshot[key(stroke.share, stroke.stroke_id)] = strip;
+        }
+
+        /* Both keep their common strokes in the same order, a stroke found further on the other side is kept
+           for there and the one it is compared with goes. Anything else(strokes that swapped places) is replaced */
+        size_t before = first, after = snapshotFirst;
+        while(before < end || after < snapshotEnd){
+            if(before < end && after < snapshotEnd && holds(slots[order[before]], snapshot.stroke(after))){
+                ++before;
+                ++after;
+                continue;
+            }
+            if(before < end){
+                const Slot& slot = slots[order[before]];
+                auto found = in_snapshot.find(key(slot.share, slot.stroke_id));
+                if(found == in_snapshot.end() || found->second < after || !holds(slot, snapshot.stroke(found->second))){
+                    removed.push_back(before++);
+                    continue;
+                }
+            }
+            if(after < snapshotEnd){
+                const FrozenStroke& stroke = snapshot.stroke(after);
+                auto found = in_order.find(key(stroke.share, stroke.stroke_id));
+                if(found == in_order.end() || found->second < before || !holds(slots[order[found->second]], stroke)){
+                    inserted.push_back(after++);
+                    continue;
+                }
+            }
+            removed.push_back(before++);
+        }
+    }
+
+    void StrokeArena::restore(const Snapshot& snapshot, StrokeChanges* changes){
+        /* Clean runs still made of a page of the snapshot are the same strokes, the ones in the same order on both
+           sides are kept without looking at them. A page knows its run, the run its first stroke */
+        std::vector<size_t> run_first(runs.size(), SIZE_MAX);
+        size_t first = 0;
+        for(uint32_t run_num : run_order){
+            run_first[run_num] = first;
+            first += runs[run_num].count;
+        }
+        struct Kept{
+            uint32_t run;
+            size_t page_num, first, snapshot_first;
+        };
+        std::vector<Kept> kept;
+        for(size_t page_num = 0; page_num < snapshot.pages.size(); ++page_num){
+            const Page* page = snapshot.pages[page_num];
+            if(page->run >= runs.size() || runs[page->run].page != page || runs[page->run].dirty || run_first[page->run] == SIZE_MAX){
+                continue;
+            }
+            if(kept.empty() || run_first[page->run] > kept.back().first){
+                kept.push_back({page->run, page_num, run_first[page->run], page_num > 0 ? snapshot.ends[page_num - 1] : 0});
+            }
+        }
+
+        /* Only the strokes between the kept pages are compared */
+        std::vector<size_t> removed, inserted;
+        size_t before = 0, after = 0;
+        for(const Kept& run : kept){
+            diff(snapshot, before, run.first, after, run.snapshot_first, removed, inserted);
+            before = run.first + runs[run.run].count;
+            after = snapshot.ends[run.page_num];
+        }
+        diff(snapshot, before, order.size(), after, snapshot.count, removed, inserted);
+
+        removeStrokes(removed);
+        insertStrokes(inserted);
+        for(size_t strip : inserted){
+            restoreSlot(slots[order[strip]], snapshot.stroke(strip));
+        }
+
+        /* The runs are those of the pages of the snapshot now, the kept ones stay as they were */
+        size_t next = 0;
+        for(uint32_t run_num : run_order){
+            if(next < kept.size() && kept[next].run == run_num){
+                ++next;
+                continue;
+            }
+            runs[run_num] = Run();
+            free_runs.push_back(run_num);
+        }
+        std::vector<uint32_t> next_order;
+        next_order.reserve(snapshot.pages.size());
+        size_t strip = 0;
+        next = 0;
+        for(size_t page_num = 0; page_num < snapshot.pages.size(); ++page_num){
+            Page* page = snapshot.pages[page_num];
+            uint32_t run_num;
+            if(next < kept.size() && kept[next].page_num == page_num){
+                run_num = kept[next++].run;
+            }
+            else{
+                run_num = newRun();
+                page->run = run_num;
+                for(size_t k = strip; k < strip + page->strokes.size(); ++k){
+                    slots[order[k]].run = run_num;
+                }
+            }
+            runs[run_num].page = page;
+            runs[run_num].count = (uint32_t)page->strokes.size();
+            runs[run_num].dirty = false;
+            next_order.push_back(run_num);
+            strip += page->strokes.size();
+        }
+        run_order.swap(next_order);
+
+        if(changes){
+            changes->removed = std::move(removed);
+            changes->changed = inserted;
+            changes->inserted = std::move(inserted);
+        }
+    }
+
+    StrokeHandle StrokeArena::handle(size_t strip) const{
+        return {order[strip], slots[order[strip]].generation};
+    }
+
+    bool StrokeArena::find(StrokeHandle handle, size_t& strip) const{
+        if(handle.slot >= slots.size()){
+            return false;
+        }
+        const Slot& slot = slots[handle.slot];
+        if(slot.generation != handle.generation || slot.position >= order.size() || order[slot.position] != handle.slot){
+            return false;
+        }
+        strip = slot.position;
+        return true;
+    }
+
+    void StrokeArena::findStroke(uint32_t id, std::vector<size_t>& strips) const{
+        strips.clear();
+        for(size_t strip = 0; strip < order.size(); ++strip){
+            if(slots[order[strip]].stroke_id == id){
+                strips.push_back(strip);
+            }
+        }
+    }
+
+    uint8_t StrokeArena::classOf(size_t size){
+        uint8_t size_class = 0;
+        while(extentSize(size_class) < size){
+            ++size_class;
+        }
+        return size_class;
+    }
+
+    double* StrokeArena::allocate(uint8_t sizeClass){
+        if(sizeClass < free_extents.size() && !free_extents[sizeClass].empty()){
+            double* extent = free_extents[sizeClass].back();
+            free_extents[sizeClass].pop_back();
+            return extent;
+        }
+        size_t size = extentSize(sizeClass);
+        if(size > CHUNK_SIZE){
+            chunks.emplace_back(new double[size]);
+            reserved += size;
+            return chunks.back().get();
+        }
+        if(size > chunk_left){
+            /* The rest of the chunk is not lost, it is cut into the largest extents that fit */
+            while(chunk_left >= MIN_EXTENT){
+                uint8_t rest = 0;
+                while(extentSize(rest + 1) <= chunk_left){
+                    ++rest;
+                }
+                if(free_extents.size() <= rest){
+                    free_extents.resize(rest + 1);
+                }
+                free_extents[rest].push_back(chunk_end);
+                chunk_end += extentSize(rest);
+                chunk_left -= extentSize(rest);
+            }
+            chunks.emplace_back(new double[CHUNK_SIZE]);
+            reserved += CHUNK_SIZE;
+            chunk_end = chunks.back().get();
+            chunk_left = CHUNK_SIZE;
+        }
+        double* extent = chunk_end;
+        chunk_end += size;
+        chunk_left -= size;
+        return extent;
+    }
+
+    void StrokeArena::freeExtent(double* extent, uint8_t sizeClass){
+        if(free_extents.size() <= sizeClass){
+            free_extents.resize(sizeClass + 1);
+        }
+        free_extents[sizeClass].push_back(extent);
+    }
+
+    void StrokeArena::unref(uint32_t share_num){
+        Share& share = shares[share_num];
+        if(--share.refs == 0){
+            freeExtent(share.data, share.size_class);
+            share = Share();
+            free_shares.push_back(share_num);
+        }
+    }
+
+    void StrokeArena::drop(Slot& slot){
+        if(slot.share != NO_SHARE){
+            unref(slot.share);
+            slot.share = NO_SHARE;
+            slot.frozen = 0;
+        }
+        else if(slot.size_class != NO_EXTENT){
+            freeExtent(slot.data, slot.size_class);
+        }
+    }
+
+    void StrokeArena::release(Slot& slot){
+        drop(slot);
+        stored -= slot.size;
+        slot.data = nullptr;
+        slot.size = 0;
+        slot.size_class = NO_EXTENT;
+    }
+
+    bool StrokeArena::reclaim(Slot& slot){
+        if(slot.share == NO_SHARE || shares[slot.share].refs != 1){
+            return false;
+        }
+        shares[slot.share] = Share();
+        free_shares.push_back(slot.share);
+        slot.share = NO_SHARE;
+        slot.frozen = 0;
+        return true;
+    }
+
+    void StrokeArena::reserve(Slot& slot, size_t size){
+        bool fits = slot.size_class != NO_EXTENT && size <= extentSize(slot.size_class);
+        if(fits && (slot.size >= slot.frozen || reclaim(slot))){
+            return;
+        }
+        moveTo(slot, fits ? slot.size_class : classOf(size));
+    }
+
+    void StrokeArena::makeWritable(Slot& slot){
+        if(slot.frozen > 0 && !reclaim(slot)){
+            moveTo(slot, slot.size_class);
+        }
+    }
+
+    void StrokeArena::moveTo(Slot& slot, uint8_t sizeClass){
+        double* extent = allocate(sizeClass);
+        if(slot.size > 0){
+            std::memcpy(extent, slot.data, slot.size * sizeof(double));
+        }
+        size_t kept = slot.size;
+        release(slot);
+        slot.data = extent;
+        slot.size = kept;
+        slot.size_class = sizeClass;
+        stored += kept;
+    }
+
+    StrokeArena::Snapshot::Snapshot(Snapshot&& other) noexcept
+        : arena(other.arena), pages(std::move(other.pages)), ends(std::move(other.ends)), count(other.count){
+        other.arena = nullptr;
+        other.pages.clear();
+        other.ends.clear();
+        other.count = 0;
+    }
+
+    StrokeArena::Snapshot& StrokeArena::Snapshot::operator=(Snapshot&& other) noexcept{
+        if(this != &other){
+            release();
+            arena = other.arena;
+            pages = std::move(other.pages);
+            ends = std::move(other.ends);
+            count = other.count;
+            other.arena = nullptr;
+            other.pages.clear();
+            other.ends.clear();
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    StrokeArena::Snapshot::~Snapshot(){
+        release();
+    }
+
+    void StrokeArena::Snapshot::release(){
+        if(arena){
+            for(Page* page : pages){
+                arena->unrefPage(page);
+            }
+        }
+        arena = nullptr;
+        pages.clear();
+        ends.clear();
+        count = 0;
+    }
+
+    const StrokeArena::FrozenStroke& StrokeArena::Snapshot::stroke(size_t strip) const{
+        size_t page_num = std::upper_bound(ends.begin(), ends.end(), strip) - ends.begin();
+        return pages[page_num]->strokes[strip - (page_num > 0 ? ends[page_num - 1] : 0)];
+    }
+
+    bool StrokeArena::Snapshot::sharesAll(const Snapshot& other) const{
+        if(count != other.count){
+            return false;
+        }
+        /* Pages both share are skipped, the others are compared stroke by stroke */
+        size_t page_num = 0, other_page = 0, stroke_num = 0, other_stroke = 0;
+        while(page_num < pages.size()){
+            if(stroke_num == 0 && other_stroke == 0 && pages[page_num] == other.pages[other_page]){
+                ++page_num;
+                ++other_page;
+                continue;
+            }
+            const FrozenStroke& a = pages[page_num]->strokes[stroke_num];
+            const FrozenStroke& b = other.pages[other_page]->strokes[other_stroke];
+            if(a.data != b.data || a.size != b.size){
+                return false;
+            }
+            if(++stroke_num == pages[page_num]->strokes.size()){
+                ++page_num;
+                stroke_num = 0;
+            }
+            if(++other_stroke == other.pages[other_page]->strokes.size()){
+                ++other_page;
+                other_stroke = 0;
+            }
+        }
+        return true;
+    }
+}
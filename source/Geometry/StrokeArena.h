@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Geometry{
+    /* Name of a stroke that does not change when strokes are inserted in front of it, see StrokeArena::find() */
+    struct StrokeHandle{
+        uint32_t slot = UINT32_MAX, generation = 0;
+
+        bool operator==(const StrokeHandle& other) const { return slot == other.slot && generation == other.generation; }
+        bool operator!=(const StrokeHandle& other) const { return !(*this == other); }
+    };
+
+    /*
+        Strips changed in the middle of a drawing(erasing), so what is built from them updates those strips only
+        instead of starting over. Applied in this order: the removed strips(numbered before the change), empty
+        strips inserted(numbered after it), then the changed strips take their new vertices(numbered after the
+        change, the inserted ones included). Every list is ascending.
+    */
+    struct StrokeChanges{
+        std::vector<size_t> removed, inserted, changed;
+
+        bool empty() const { return removed.empty() && inserted.empty() && changed.empty(); }
+        void clear(){
+            removed.clear();
+            inserted.clear();
+            changed.clear();
+        }
+
+        /*
+            Walks the first synced strips of a consumer(of which the last may be unfinished) through the change:
+            remove(before) for a removed strip, insert(after) for an inserted one and keep(before, after, changed)
+            for the others. Strips inserted after the synced ones are left to the next sync of the consumer, and
+            so is the last synced strip if it changed. Returns the number of synced strips walked, the ones after
+            them are to be dropped.
+        */
+        template<typename Remove, typename Insert, typename Keep>
+        size_t walk(size_t synced, Remove remove, Insert insert, Keep keep) const{
+            size_t before = 0, after = 0, r = 0, i = 0, c = 0;
+            while(before < synced){
+                if(r < removed.size() && removed[r] == before){
+                    remove(before++);
+                    ++r;
+                    continue;
+                }
+                if(i < inserted.size() && inserted[i] == after){
+                    c += c < changed.size() && changed[c] == after ? 1 : 0;
+                    insert(after++);
+                    ++i;
+                    continue;
+                }
+                bool is_changed = c < changed.size() && changed[c] == after;
+                if(is_changed && before + 1 == synced){
+                    break;
+                }
+                c += is_changed ? 1 : 0;
+                keep(before++, after++, is_changed);
+            }
+            return before;
+        }
+    };
+
+    /* The XYZRGB doubles of one stroke. Like the strips it replaces, size() counts doubles, not vertices */
+    class StrokeView{
+    public:
+        StrokeView(const double* values, size_t count) : values(values), count(count){}
+
+        const double* data() const { return values; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const double* begin() const { return values; }
+        const double* end() const { return values + count; }
+        double operator[](size_t i) const { return values[i]; }
+
+    private:
+        const double* values;
+        size_t count;
+    };
+
+    /*
+        Storage of a drawing as an ordered list of strokes, read like the std::vector<std::vector<double>> strips
+        (size(), operator[] with data() and size()), so the incremental consumers take either of them.
+
+        The doubles of a stroke lie in one extent carved from CHUNK_SIZE chunks. Extents come in power of two size
+        classes; a stroke outgrowing its extent moves to one of the next class and gives the old one back to a free
+        list of its class, so a long session reuses the extents of erased and cleared strokes instead of going to
+        the heap, and the memory held stays at the peak size of the drawing.
+
+        A Snapshot is a read only version of the drawing that shares the extents with it: taking one copies a
+        reference per stroke and no vertex. The doubles a snapshot sees are frozen, writing over them copies the
+        stroke to an extent of its own first, while appending after them does not, so versions only cost the
+        strokes changed between them. An extent goes back to the free lists when neither the drawing nor any
+        snapshot holds it any more.
+
+        The list of strokes is shared the same way: a snapshot is a list of pages of PAGE_STROKES strokes, and the
+        drawing knows which of its strokes still are those of a page of the last snapshot. Taking a snapshot only
+        freezes the strokes of the changed pages, and restoring one only compares the pages the drawing does not
+        share with it.
+    */
+    class StrokeArena{
+    public:
+        /* Doubles per chunk(512 KiB), larger extents get a chunk of their own */
+        static const size_t CHUNK_SIZE = 1 << 16;
+        /* Doubles of the smallest extent, 8 vertices */
+        static const size_t MIN_EXTENT = 48;
+        /* Strokes per page of a snapshot */
+        static const size_t PAGE_STROKES = 64;
+
+    private:
+        /* A stroke as snapshots see it */
+        struct FrozenStroke{
+            const double* data;
+            size_t size;
+            /* Index in StrokeArena::shares, NO_SHARE for an empty stroke */
+            uint32_t share;
+            uint32_t stroke_id;
+        };
+        /* Consecutive strokes of a snapshot, shared by the snapshots taken while none of them changed */
+        struct Page{
+            std::vector<FrozenStroke> strokes;
+            uint32_t refs = 0;
+            /* Run of the drawing still made of these strokes, see Run */
+            uint32_t run = UINT32_MAX;
+        };
+
+    public:
+
+        /*
+            Version of the strips, read like them. It can be read on any thread while the arena is changed, but it
+            must be taken, restored and destroyed on the thread of the arena, and not outlive it
+        */
+        class Snapshot{
+        public:
+            Snapshot() = default;
+            Snapshot(Snapshot&& other) noexcept;
+            Snapshot& operator=(Snapshot&& other) noexcept;
+            ~Snapshot();
+
+            Snapshot(const Snapshot&) = delete;
+            Snapshot& operator=(const Snapshot&) = delete;
+
+            size_t size() const { return count; }
+            bool empty() const { return count == 0; }
+            StrokeView operator[](size_t strip) const{
+                const FrozenStroke& frozen = stroke(strip);
+                return StrokeView(frozen.data, frozen.size);
+            }
+            StrokeView back() const { return (*this)[count - 1]; }
+
+            /* Same strokes with the same vertices, without comparing any of them */
+            bool sharesAll(const Snapshot& other) const;
+
+        private:
+            friend class StrokeArena;
+
+            StrokeArena* arena = nullptr;
+            std::vector<Page*> pages;
+            /* Strokes up to the end of each page */
+            std::vector<size_t> ends;
+            size_t count = 0;
+
+            const FrozenStroke& stroke(size_t strip) const;
+            void release();
+        };
+
+        StrokeArena() = default;
+        StrokeArena(StrokeArena&&) = default;
+        StrokeArena& operator=(StrokeArena&&) = default;
+
+        StrokeArena(const StrokeArena&) = delete;
+        StrokeArena& operator=(const StrokeArena&) = delete;
+
+        size_t size() const { return order.size(); }
+        bool empty() const { return order.empty(); }
+        StrokeView operator[](size_t strip) const;
+        StrokeView back() const { return (*this)[order.size() - 1]; }
+
+        /* New empty stroke after the last one / in front of the stroke at position */
+        StrokeHandle addStroke();
+        StrokeHandle insertStroke(size_t position);
+        /* count new empty strokes in front of the stroke at position, the strokes after them are renumbered once */
+        void insertStrokes(size_t position, size_t count);
+        /* New empty strokes at the positions(ascending, numbered after the insertion) in one pass */
+        void insertStrokes(const std::vector<size_t>& positions);
+
+        /* Removes the stroke and gives its extent back, the strokes after it move forward. Their handles stay valid */
+        void removeStroke(size_t strip);
+        /* The same for several strokes(ascending positions before the removal) in one pass */
+        void removeStrokes(const std::vector<size_t>& strips);
+
+        /* Inline while the extent has room and no snapshot sees that part of it, the common case of a stroke being drawn */
+        void append(size_t strip, const double* values, size_t count){
+            Slot& slot = slots[order[strip]];
+            if(slot.size_class == NO_EXTENT || slot.size + count > extentSize(slot.size_class) || slot.size < slot.frozen){
+                reserve(slot, slot.size + count);
+            }
+            std::copy(values, values + count, slot.data + slot.size);
+            slot.size += count;
+            stored += count;
+            runs[slot.run].dirty = true;
+        }
+        /* Replaces the contents of the stroke */
+        void assign(size_t strip, const double* values, size_t count);
+        /* Drops the doubles from size on, the extent stays with the stroke(removeStroke() gives it back) */
+        void truncate(size_t strip, size_t size);
+        /* Writable doubles of the stroke, valid until it grows */
+        double* mutableData(size_t strip);
+
+        /* Removes every stroke, their extents stay for the next ones */
+        void clear();
+
+        /* The current strokes, see Snapshot */
+        Snapshot snapshot();
+        /*
+            Makes the strokes those of the snapshot, sharing its extents. Only the strokes that differ from it are
+            replaced(the strokes are compared by their share and size, no vertex is), the others keep their place
+            in the order and their handles, and changes(if given) gets the replaced ones
+        */
+        void restore(const Snapshot& snapshot, StrokeChanges* changes = nullptr);
+
+        StrokeHandle handle(size_t strip) const;
+        /* Current position of the stroke, false if it was removed */
+        bool find(StrokeHandle handle, size_t& strip) const;
+
+        /*
+            Stroke the strip was drawn as: new strips get a new id, pieces split off a strip by erasing take over
+            its id, and snapshots keep it. Arenas holding the same drawing(the raw and the simplified strokes) give
+            a stroke the same id(StrokeBuilder sets it), so a stroke picked in one is found in the other.
+        */
+        uint32_t strokeId(size_t strip) const { return slots[order[strip]].stroke_id; }
+        void setStrokeId(size_t strip, uint32_t id){
+            Slot& slot = slots[order[strip]];
+            slot.stroke_id = id;
+            runs[slot.run].dirty = true;
+        }
+        /* Positions of the strips of the stroke, ascending */
+        void findStroke(uint32_t id, std::vector<size_t>& strips) const;
+
+        /* Bytes of the chunks, and of the doubles stored in them */
+        size_t getReservedBytes() const { return reserved * sizeof(double); }
+        size_t getStoredBytes() const { return stored * sizeof(double); }
+
+    private:
+        static const uint8_t NO_EXTENT = 0xff;
+        static const uint32_t NO_SHARE = UINT32_MAX;
+
+        /* An extent held by snapshots, refs counts them and the stroke of the drawing still using it */
+        struct Share{
+            double* data = nullptr;
+            uint32_t refs = 0;
+            uint8_t size_class = NO_EXTENT;
+            /* The longest version of the stroke any snapshot saw */
+            size_t frozen = 0;
+        };
+        std::vector<Share> shares;
+        std::vector<uint32_t> free_shares;
+
+        struct Slot{
+            double* data = nullptr;
+            size_t size = 0;
+            uint32_t generation = 0;
+            /* Position in order */
+            uint32_t position = 0;
+            uint8_t size_class = NO_EXTENT;
+            /* Share of the extent, and the doubles of it snapshots see(copy of Share::frozen, so append() does not look it up) */
+            uint32_t share = NO_SHARE;
+            size_t frozen = 0;
+            uint32_t stroke_id = 0;
+            uint32_t run = 0;
+        };
+        std::vector<Slot> slots;
+        std::vector<uint32_t> free_slots;
+        uint32_t next_stroke_id = 0;
+        /* Slots of the strokes in drawing order */
+        std::vector<uint32_t> order;
+
+        /*
+            The strokes in order cut in consecutive runs, each one made of the strokes of a page of the last
+            snapshot until any of them changes(or strokes are inserted into or removed from it). Clean runs take
+            their page into the next snapshot as it is. A run only points at its page while snapshots hold it
+        */
+        struct Run{
+            Page* page = nullptr;
+            uint32_t count = 0;
+            bool dirty = true;
+        };
+        std::vector<Run> runs;
+        std::vector<uint32_t> free_runs, run_order;
+
+        std::vector<std::unique_ptr<double[]>> chunks;
+        /* Doubles not carved yet at the end of the last CHUNK_SIZE chunk */
+        double* chunk_end = nullptr;
+        size_t chunk_left = 0;
+        /* Released extents per size class */
+        std::vector<std::vector<double*>> free_extents;
+        size_t reserved = 0, stored = 0;
+
+        static size_t extentSize(uint8_t sizeClass){ return MIN_EXTENT << sizeClass; }
+        static uint8_t classOf(size_t size);
+        uint32_t newSlot();
+        uint32_t newRun();
+        /* Puts the new stroke at strip into the run of the stroke before it(the first run for the first stroke) */
+        void joinRun(size_t strip);
+        /* A page of count strokes from first on, for the run */
+        Page* freeze(size_t first, size_t count, uint32_t run);
+        void unrefPage(Page* page);
+        /* Whether the stroke of the slot is the one of the snapshot, and makes it that one */
+        static bool holds(const Slot& slot, const FrozenStroke& stroke);
+        void restoreSlot(Slot& slot, const FrozenStroke& stroke);
+        /* Strokes to remove from the range of the drawing and to insert from the range of the snapshot to make
+           the first one the second one */
+        void diff(const Snapshot& snapshot, size_t first, size_t end, size_t snapshotFirst, size_t snapshotEnd,
+                  std::vector<size_t>& removed, std::vector<size_t>& inserted) const;
+        double* allocate(uint8_t sizeClass);
+        void freeExtent(double* extent, uint8_t sizeClass);
+        /* Lets go of a share, its extent is free once nothing holds it */
+        void unref(uint32_t share);
+        /* Gives the extent of the slot back, to the free lists unless snapshots still hold it */
+        void drop(Slot& slot);
+        void release(Slot& slot);
+        /* Makes the shared extent the slot's own again if no snapshot holds it any more */
+        bool reclaim(Slot& slot);
+        /* Copies the doubles of the slot to a new extent of the size class */
+        void moveTo(Slot& slot, uint8_t sizeClass);
+        /* Makes room for size doubles in the stroke's extent and makes the doubles from slot.size on writable */
+        void reserve(Slot& slot, size_t size);
+        /* Copies the stroke to an extent of its own if snapshots see any of it */
+        void makeWritable(Slot& slot);
+    };
+}
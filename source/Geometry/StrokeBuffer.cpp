@@ -0,0 +1,89 @@
+#include "StrokeBuffer.h"
+#include "StrokeArena.h"
+#include "SphereUnfold.h"
+
+namespace Geometry{
+    void StrokeBuffer::clear(){
+        x.clear();
+        y.clear();
+        z.clear();
+        offsets.assign(1, 0);
+        colors.clear();
+    }
+
+    void StrokeBuffer::reserve(size_t strokes, size_t vertices){
+        x.reserve(vertices);
+        y.reserve(vertices);
+        z.reserve(vertices);
+        offsets.reserve(strokes + 1);
+        colors.reserve(strokes);
+    }
+
+    void StrokeBuffer::beginStroke(const StrokeColor& color){
+        colors.push_back(color);
+        offsets.push_back((uint32_t)x.size());
+    }
+
+    void StrokeBuffer::append(float vx, float vy, float vz){
+        x.push_back(vx);
+        y.push_back(vy);
+        z.push_back(vz);
+        ++offsets.back();
+    }
+
+    template<typename Strips>
+    StrokeBuffer StrokeBuffer::fromStrips(const Strips& strips, size_t first_strip){
+        size_t vertices = 0;
+        for(size_t strip_num = first_strip; strip_num < strips.size(); ++strip_num){
+            vertices += strips[strip_num].size() / VERTEX_STRIDE;
+        }
+
+        StrokeBuffer buffer;
+        buffer.reserve(strips.size() - first_strip, vertices);
+        buffer.x.resize(vertices);
+        buffer.y.resize(vertices);
+        buffer.z.resize(vertices);
+
+        size_t vertex = 0;
+        for(size_t strip_num = first_strip; strip_num < strips.size(); ++strip_num){
+            const auto& strip = strips[strip_num];
+            if(strip.empty()){
+                continue;
+            }
+            /* The whole strip is drawn with the color of its first vertex */
+            buffer.colors.push_back({(float)strip[3], (float)strip[4], (float)strip[5]});
+            for(size_t v_num = 0; v_num < strip.size(); v_num += VERTEX_STRIDE, ++vertex){
+                buffer.x[vertex] = (float)strip[v_num];
+                buffer.y[vertex] = (float)strip[v_num + 1];
+                buffer.z[vertex] = (float)strip[v_num + 2];
+            }
+            buffer.offsets.push_back((uint32_t)vertex);
+        }
+        return buffer;
+    }
+
+    template StrokeBuffer StrokeBuffer::fromStrips(const std::vector<std::vector<double>>& strips, size_t first_strip);
+    template StrokeBuffer StrokeBuffer::fromStrips(const StrokeArena& strips, size_t first_strip);
+    template StrokeBuffer StrokeBuffer::fromStrips(const StrokeArena::Snapshot& strips, size_t first_strip);
+
+    void StrokeBuffer::appendToStrips(std::vector<std::vector<double>>& strips) const{
+        strips.reserve(strips.size() + strokeCount());
+        for(size_t stroke = 0; stroke < strokeCount(); ++stroke){
+            const StrokeColor& color = colors[stroke];
+            std::vector<double> strip;
+            strip.reserve(strokeSize(stroke) * VERTEX_STRIDE);
+            for(size_t vertex = offsets[stroke]; vertex < offsets[stroke + 1]; ++vertex){
+                strip.insert(strip.end(), {x[vertex], y[vertex], z[vertex], color.r, color.g, color.b});
+            }
+            strips.push_back(std::move(strip));
+        }
+    }
+
+    void packPositions(const double* vertices, size_t vertexCount, float* positions){
+        for(size_t v_num = 0; v_num < vertexCount; ++v_num, vertices += VERTEX_STRIDE, positions += 3){
+            positions[0] = (float)vertices[0];
+            positions[1] = (float)vertices[1];
+            positions[2] = (float)vertices[2];
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Geometry{
+    struct StrokeColor{
+        float r = 1.0f, g = 1.0f, b = 1.0f;
+    };
+
+    /*
+        Structure-of-arrays storage of a drawing: positions are kept in separate float arrays so the unfold
+        kernels can process them with full-width SIMD loads, and the color is stored once per stroke.
+        Stroke i owns the vertices [offsets[i], offsets[i + 1]).
+    */
+    class StrokeBuffer{
+    public:
+        std::vector<float> x, y, z;
+        std::vector<uint32_t> offsets{0};
+        std::vector<StrokeColor> colors;
+
+        size_t strokeCount() const { return colors.size(); }
+        size_t vertexCount() const { return x.size(); }
+        size_t strokeBegin(size_t stroke) const { return offsets[stroke]; }
+        size_t strokeSize(size_t stroke) const { return offsets[stroke + 1] - offsets[stroke]; }
+
+        void clear();
+        void reserve(size_t strokes, size_t vertices);
+
+        /* Starts a new (empty) stroke, the following appends go into it */
+        void beginStroke(const StrokeColor& color);
+        void append(float vx, float vy, float vz);
+
+        /* Conversion from/to the interleaved XYZRGB double strips(std::vector<std::vector<double>>, StrokeArena or a snapshot of it), empty strips are skipped */
+        template<typename Strips>
+        static StrokeBuffer fromStrips(const Strips& strips, size_t first_strip = 0);
+        void appendToStrips(std::vector<std::vector<double>>& strips) const;
+    };
+
+    /* Packs the positions of interleaved XYZRGB double vertices into XYZ floats, the layout the GPU stroke store uploads */
+    void packPositions(const double* vertices, size_t vertexCount, float* positions);
+}
@@ -0,0 +1,104 @@
+#include "StrokeBuilder.h"
+#include "SphereUnfold.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Geometry{
+    /* Great circle interpolation of unit vectors, falls back to a normalized lerp for (almost) equal or opposite ones */
+    static glm::dvec3 slerp(const glm::dvec3& from, const glm::dvec3& to, double t){
+        double cos_angle = std::clamp(glm::dot(from, to), -1.0, 1.0);
+        double angle = std::acos(cos_angle), sin_angle = std::sin(angle);
+        if(sin_angle < 1e-6){
+            glm::dvec3 mixed = from + (to - from) * t;
+            double length = glm::length(mixed);
+            return length > 1e-12 ? mixed / length : to;
+        }
+        return (std::sin((1.0 - t) * angle) * from + std::sin(t * angle) * to) / sin_angle;
+    }
+
+    StrokeBuilder::StrokeBuilder(double angularStep) : step(angularStep > 0.0 ? angularStep : 0.002){
+    }
+    void StrokeBuilder::setColor(double r, double g, double b){
+        color[0] = r;
+        color[1] = g;
+        color[2] = b;
+    }
+    void StrokeBuilder::begin(StrokeArena& strips, const StrokeSample& sample){
+        if(strips.empty() || !strips.back().empty()){
+            strips.addStroke();
+        }
+        if(raw && (raw->empty() || !raw->back().empty())){
+            raw->addStroke();
+        }
+        if(raw){
+            raw->setStrokeId(raw->size() - 1, strips.strokeId(strips.size() - 1));
+        }
+        if(simplifier){
+            simplifier->begin();
+        }
+        anchor = sample;
+        anchor.direction = glm::normalize(sample.direction);
+        last_time = sample.time;
+        drawing = true;
+        emit(strips, anchor.center, anchor.direction);
+    }
+    void StrokeBuilder::add(StrokeArena& strips, const StrokeSample& sample){
+        if(!drawing){
+            begin(strips, sample);
+            return;
+        }
+        /* Samples arrive in order, anything older than the last one is stale */
+        if(sample.time < last_time){
+            return;
+        }
+        last_time = sample.time;
+
+        glm::dvec3 direction = glm::normalize(sample.direction);
+        glm::dvec3 target = sample.center + direction * (double)S_RADIUS;
+        double step_length = step * S_RADIUS;
+        while(true){
+            double distance = glm::length(target - (anchor.center + anchor.direction * (double)S_RADIUS));
+            if(!(distance >= step_length)){
+                break;
+            }
+            double t = step_length / distance;
+            anchor.direction = slerp(anchor.direction, direction, t);
+            anchor.center = anchor.center + (sample.center - anchor.center) * t;
+            emit(strips, anchor.center, anchor.direction);
+        }
+    }
+    void StrokeBuilder::end(StrokeArena& strips, const StrokeSample& sample){
+        if(!drawing){
+            return;
+        }
+        add(strips, sample);
+
+        /* The remainder shorter than a step would be lost otherwise */
+        glm::dvec3 direction = glm::normalize(sample.direction);
+        double distance = glm::length(sample.center + direction * (double)S_RADIUS - (anchor.center + anchor.direction * (double)S_RADIUS));
+        if(distance > 1e-6 * S_RADIUS){
+            emit(strips, sample.center, direction);
+        }
+        strips.addStroke();
+        if(raw){
+            raw->addStroke();
+        }
+        drawing = false;
+    }
+    void StrokeBuilder::emit(StrokeArena& strips, const glm::dvec3& center, const glm::dvec3& direction){
+        glm::dvec3 position = center + direction * (double)S_RADIUS;
+        double vertex[VERTEX_STRIDE] = {position.x, position.y, position.z, color[0], color[1], color[2]};
+        if(raw){
+            raw->append(raw->size() - 1, vertex, VERTEX_STRIDE);
+        }
+        size_t strip = strips.size() - 1;
+        if(!simplifier || simplifier->append(vertex)){
+            strips.append(strip, vertex, VERTEX_STRIDE);
+        }
+        else{
+            /* The floating last vertex moves */
+            std::copy(vertex, vertex + VERTEX_STRIDE, strips.mutableData(strip) + strips[strip].size() - VERTEX_STRIDE);
+        }
+    }
+}
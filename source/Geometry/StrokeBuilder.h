@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "StrokeArena.h"
+#include "StrokeSimplifier.h"
+
+#include <vector>
+
+namespace Geometry{
+    /* One orientation sample of the drawing camera: a point is drawn at center + direction * radius */
+    struct StrokeSample{
+        glm::dvec3 center;
+        glm::dvec3 direction;
+        double time = 0.0;
+    };
+
+    /*
+        Turns raw orientation samples into stroke vertices placed at a fixed distance from each other. Between two
+        samples the direction is interpolated along the great circle(and the camera center linearly), so the result
+        does not depend on how often the samples come: slow frames do not produce long chords and fast ones do
+        not produce runs of near duplicate vertices. The vertices go into the last strip of the given strips.
+    */
+    class StrokeBuilder{
+    public:
+        /* angularStep is the spacing of the vertices in radians of the drawing sphere */
+        explicit StrokeBuilder(double angularStep = 0.002);
+
+        void setColor(double r, double g, double b);
+
+        /* Simplifies strokes while they are drawn(nullptr to keep every vertex), see StrokeSimplifier */
+        void setSimplifier(StrokeSimplifier* simplifier){ this->simplifier = simplifier; }
+
+        /* Optional lossless copy of every vertex in strips of its own, e.g. for export when simplifying */
+        void setRawOutput(StrokeArena* raw){ this->raw = raw; }
+
+        /* Starts a stroke in a new strip(the last one is reused if it is still empty) */
+        void begin(StrokeArena& strips, const StrokeSample& sample);
+        void add(StrokeArena& strips, const StrokeSample& sample);
+        /* Places the last vertex exactly at the sample and opens a new empty strip */
+        void end(StrokeArena& strips, const StrokeSample& sample);
+
+        /* Forgets the current stroke, for when the strips were cleared */
+        void cancel(){ drawing = false; }
+
+        bool isDrawing() const { return drawing; }
+
+    private:
+        double step;
+        double color[3] = {1.0, 1.0, 1.0};
+        bool drawing = false;
+        StrokeSimplifier* simplifier = nullptr;
+        StrokeArena* raw = nullptr;
+
+        /* The last emitted vertex, the next one is interpolated from it */
+        StrokeSample anchor;
+        double last_time = 0.0;
+
+        void emit(StrokeArena& strips, const glm::dvec3& center, const glm::dvec3& direction);
+    };
+}
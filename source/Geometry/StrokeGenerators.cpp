@@ -0,0 +1,103 @@
+#include "StrokeGenerators.h"
+#include "SphereUnfold.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace Geometry{
+    /* The drawer limits the camera pitch to 89 degrees */
+    static const double MAX_LATITUDE = 89.0 * PI / 180.0;
+
+    static void pushVertex(std::vector<double>& strip, double latitude, double longitude, const double color[3]){
+        strip.insert(strip.end(), {S_RADIUS * std::cos(latitude) * std::cos(longitude),
+                                   S_RADIUS * std::sin(latitude) + camera_y_shift,
+                                   S_RADIUS * std::cos(latitude) * std::sin(longitude),
+                                   color[0], color[1], color[2]});
+    }
+
+    static void randomColor(std::mt19937& random, double color[3]){
+        std::uniform_real_distribution<double> channel(0.2, 1.0);
+        for(int i = 0; i < 3; ++i){
+            color[i] = channel(random);
+        }
+    }
+
+    void generateRandomWalks(std::vector<std::vector<double>>& strips, size_t vertexCount, uint32_t seed){
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::normal_distribution<double> turn(0.0, 0.15);
+        const size_t stroke_length = 2000;
+        const double step = 0.004;
+
+        for(size_t generated = 0; generated < vertexCount;){
+            size_t length = std::min(stroke_length, vertexCount - generated);
+            double color[3];
+            randomColor(random, color);
+            double latitude = (unit(random) * 2.0 - 1.0) * MAX_LATITUDE * 0.8;
+            double longitude = unit(random) * 2.0 * PI;
+            double heading = unit(random) * 2.0 * PI;
+
+            std::vector<double> strip;
+            strip.reserve(length * VERTEX_STRIDE);
+            for(size_t v_num = 0; v_num < length; ++v_num){
+                pushVertex(strip, latitude, longitude, color);
+                heading += turn(random);
+                latitude = std::clamp(latitude + step * std::sin(heading), -MAX_LATITUDE, MAX_LATITUDE);
+                longitude += step * std::cos(heading) / std::max(std::cos(latitude), 0.05);
+            }
+            strips.push_back(std::move(strip));
+            generated += length;
+        }
+    }
+
+    void generateSpirals(std::vector<std::vector<double>>& strips, size_t vertexCount, uint32_t seed, int turns){
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        turns = std::max(turns, 1);
+        const size_t spiral_length = (size_t)turns * 256;
+
+        for(size_t generated = 0; generated < vertexCount;){
+            size_t length = std::min(spiral_length, vertexCount - generated);
+            double color[3];
+            randomColor(random, color);
+            double phase = unit(random) * 2.0 * PI;
+
+            std::vector<double> strip;
+            strip.reserve(length * VERTEX_STRIDE);
+            for(size_t v_num = 0; v_num < length; ++v_num){
+                double t = length > 1 ? (double)v_num / (length - 1) : 0.0;
+                pushVertex(strip, (t * 2.0 - 1.0) * MAX_LATITUDE * 0.9, phase + t * turns * 2.0 * PI, color);
+            }
+            strips.push_back(std::move(strip));
+            generated += length;
+        }
+    }
+
+    void generateScribbles(std::vector<std::vector<double>>& strips, size_t vertexCount, uint32_t seed){
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_int_distribution<size_t> stroke_length(8, 64);
+
+        for(size_t generated = 0, stroke = 0; generated < vertexCount; ++stroke){
+            size_t length = std::min(stroke_length(random), vertexCount - generated);
+            double color[3];
+            randomColor(random, color);
+
+            /* Every fourth scribble is put right on the seam(longitude PI / 2, where x changes its sign and z > 0) */
+            double latitude = (unit(random) * 2.0 - 1.0) * MAX_LATITUDE * 0.8;
+            double longitude = stroke % 4 == 0 ? PI / 2.0 : unit(random) * 2.0 * PI;
+            double size = 0.01 + unit(random) * 0.05, angle = unit(random) * 2.0 * PI;
+
+            std::vector<double> strip;
+            strip.reserve(length * VERTEX_STRIDE);
+            for(size_t v_num = 0; v_num < length; ++v_num){
+                double along = ((double)v_num / length - 0.5) * size, across = (v_num % 2 ? 0.5 : -0.5) * size;
+                pushVertex(strip, latitude + along * std::sin(angle) + across * std::cos(angle),
+                           longitude + along * std::cos(angle) - across * std::sin(angle), color);
+            }
+            strips.push_back(std::move(strip));
+            generated += length;
+        }
+    }
+}
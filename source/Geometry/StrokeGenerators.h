@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    Synthetic drawings on the drawing sphere(same radius and center as the interactive drawer), for benchmarks
+    and batch testing. Every generator appends XYZRGB strips with about vertexCount vertices in total and is
+    deterministic for a given seed.
+*/
+namespace Geometry{
+    /* Long strokes that wander in random directions, like slow freehand drawing */
+    void generateRandomWalks(std::vector<std::vector<double>>& strips, size_t vertexCount, uint32_t seed = 1);
+
+    /* Spirals from the bottom to the top of the sphere, every turn crosses the seam once */
+    void generateSpirals(std::vector<std::vector<double>>& strips, size_t vertexCount, uint32_t seed = 1, int turns = 64);
+
+    /* Many short, dense zig-zag strokes scattered over the sphere(a part of them on the seam) */
+    void generateScribbles(std::vector<std::vector<double>>& strips, size_t vertexCount, uint32_t seed = 1);
+}
@@ -0,0 +1,85 @@
+#include "StrokeIO.h"
+#include "SphereUnfold.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace Geometry{
+    bool readStrokes(const std::string& filePath, std::vector<std::vector<double>>& strips){
+        std::ifstream file(filePath, std::ios::in | std::ios::binary);
+        if(!file.is_open()){
+            std::cerr << "Failed to open stroke file: " << filePath << "\n";
+            return false;
+        }
+
+        std::vector<double> strip;
+        std::string line;
+        size_t line_num = 0;
+        while(std::getline(file, line)){
+            ++line_num;
+            size_t first = line.find_first_not_of(" \t\r");
+            if(first == std::string::npos){
+                /* An empty line closes the current strip */
+                if(!strip.empty()){
+                    strips.push_back(std::move(strip));
+                    strip.clear();
+                }
+                continue;
+            }
+            if(line[first] == '#'){
+                continue;
+            }
+
+            double vertex[VERTEX_STRIDE] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+            const char* cursor = line.c_str() + first;
+            size_t read = 0;
+            for(; read < VERTEX_STRIDE; ++read){
+                char* end = nullptr;
+                double value = std::strtod(cursor, &end);
+                if(end == cursor){
+                    break;
+                }
+                vertex[read] = value;
+                cursor = end;
+            }
+            if(read != 3 && read != VERTEX_STRIDE){
+                std::cerr << filePath << ":" << line_num << ": expected \"x y z\" or \"x y z r g b\"\n";
+                return false;
+            }
+            strip.insert(strip.end(), vertex, vertex + VERTEX_STRIDE);
+        }
+        if(!strip.empty()){
+            strips.push_back(std::move(strip));
+        }
+        return true;
+    }
+
+    bool writeStrokes(const std::string& filePath, const std::vector<std::vector<double>>& strips, size_t first_strip){
+        FILE* file = std::fopen(filePath.c_str(), "wb");
+        if(!file){
+            std::cerr << "Failed to create stroke file: " << filePath << "\n";
+            return false;
+        }
+
+        for(size_t strip_num = first_strip; strip_num < strips.size(); ++strip_num){
+            const std::vector<double>& strip = strips[strip_num];
+            if(strip.empty()){
+                continue;
+            }
+            for(size_t v_num = 0; v_num < strip.size(); v_num += VERTEX_STRIDE){
+                std::fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g\n", strip[v_num], strip[v_num + 1], strip[v_num + 2],
+                             strip[v_num + 3], strip[v_num + 4], strip[v_num + 5]);
+            }
+            std::fputc('\n', file);
+        }
+
+        bool ok = std::ferror(file) == 0;
+        ok = std::fclose(file) == 0 && ok;
+        if(!ok){
+            std::cerr << "Failed to write stroke file: " << filePath << "\n";
+        }
+        return ok;
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+    Plain text stroke files: one vertex per line as "x y z r g b"(the color is optional and defaults to white),
+    strips are separated by empty lines, and lines starting with '#' are comments.
+*/
+namespace Geometry{
+    bool readStrokes(const std::string& filePath, std::vector<std::vector<double>>& strips);
+    bool writeStrokes(const std::string& filePath, const std::vector<std::vector<double>>& strips, size_t first_strip = 0);
+}
@@ -0,0 +1,60 @@
+#include "StrokeSimplifier.h"
+#include "SphereUnfold.h"
+
+#include <algorithm>
+
+namespace Geometry{
+    StrokeSimplifier::StrokeSimplifier(double tolerance, size_t maxWindow) : tolerance(tolerance), max_window(std::max<size_t>(maxWindow, 2)){
+    }
+    void StrokeSimplifier::begin(){
+        started = false;
+        window.clear();
+    }
+    bool StrokeSimplifier::append(const double vertex[6]){
+        if(tolerance <= 0.0){
+            return true;
+        }
+
+        /* Strokes are drawn on the sphere around the default camera position, as the unfold assumes */
+        glm::dvec3 direction = glm::dvec3(vertex[0], vertex[1] - camera_y_shift, vertex[2]);
+        double length = glm::length(direction);
+        direction = length > 1e-12 ? direction / length : glm::dvec3(0.0, 0.0, -1.0);
+
+        if(!started){
+            started = true;
+            anchor = direction;
+            window.clear();
+            return true;
+        }
+
+        if(!window.empty() && window.size() < max_window && fitsArc(direction)){
+            /* Still on the arc from the anchor: the floating vertex just moves */
+            window.push_back(direction);
+            return false;
+        }
+
+        /* The floating vertex gets fixed and becomes the new anchor, the point starts the next arc */
+        if(!window.empty()){
+            anchor = window.back();
+            window.clear();
+        }
+        window.push_back(direction);
+        return true;
+    }
+    bool StrokeSimplifier::fitsArc(const glm::dvec3& end) const{
+        /*
+            Strips are drawn as straight segments, so the raw points are measured against the chord between the
+            anchor and the end, not against the great circle arc(the arc bulges away from a long chord). On the unit
+            sphere this distance is the angular error in radians for small values.
+        */
+        glm::dvec3 chord = end - anchor;
+        double chord_sq = glm::dot(chord, chord);
+        for(const glm::dvec3& point : window){
+            double t = chord_sq > 1e-24 ? std::clamp(glm::dot(point - anchor, chord) / chord_sq, 0.0, 1.0) : 0.0;
+            if(glm::length(point - (anchor + chord * t)) > tolerance){
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace Geometry{
+    /*
+        Incremental simplification of a stroke on the drawing sphere(an opening window variant of spherical
+        Ramer-Douglas-Peucker). Points are appended one by one; the last vertex of the strip stays "floating"
+        and is moved forward while every raw point since the previous kept vertex stays within the angular
+        tolerance of the segment between them. So the strip is simplified while it is drawn and only its last
+        vertex ever changes.
+    */
+    class StrokeSimplifier{
+    public:
+        /* tolerance is the allowed deviation as an angle(radians) seen from the sphere center, 0 keeps every point */
+        explicit StrokeSimplifier(double tolerance = 0.0005, size_t maxWindow = 256);
+
+        void setTolerance(double tolerance){ this->tolerance = tolerance; }
+        double getTolerance() const { return tolerance; }
+
+        /* Starts a new stroke, the next appended vertex is always kept */
+        void begin();
+
+        /* Takes the next XYZRGB vertex of the stroke: true if it is appended to the strip, false if it replaces the
+           strip's floating last vertex */
+        bool append(const double vertex[6]);
+
+    private:
+        double tolerance;
+        size_t max_window;
+
+        /* Directions from the sphere center: the last kept vertex and the raw points after it */
+        glm::dvec3 anchor;
+        std::vector<glm::dvec3> window;
+        bool started = false;
+
+        bool fitsArc(const glm::dvec3& end) const;
+    };
+}
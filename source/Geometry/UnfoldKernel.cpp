@@ -0,0 +1,296 @@
+#include "UnfoldKernel.h"
+#include "UnfoldKernelImpl.h"
+#include "../Utils/Profiler.h"
+#include "../Utils/WorkStealingPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Geometry{
+    static bool isaSupported(KernelIsa isa){
+        switch(isa){
+        case KernelIsa::Scalar:
+            return true;
+#if defined(SPHERE_UNFOLD_X86_KERNELS)
+        case KernelIsa::SSE41:
+            return __builtin_cpu_supports("sse4.1");
+        case KernelIsa::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    static std::atomic<KernelIsa>& currentIsa(){
+        static std::atomic<KernelIsa> isa{detectKernelIsa()};
+        return isa;
+    }
+
+    const char* kernelIsaName(KernelIsa isa){
+        switch(isa){
+        case KernelIsa::SSE41:
+            return "sse4.1";
+        case KernelIsa::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+        }
+    }
+
+    KernelIsa detectKernelIsa(){
+        if(isaSupported(KernelIsa::AVX2)){
+            return KernelIsa::AVX2;
+        }
+        if(isaSupported(KernelIsa::SSE41)){
+            return KernelIsa::SSE41;
+        }
+        return KernelIsa::Scalar;
+    }
+
+    KernelIsa activeKernelIsa(){
+        return currentIsa().load(std::memory_order_relaxed);
+    }
+
+    void setKernelIsa(KernelIsa isa){
+        currentIsa().store(isaSupported(isa) ? isa : detectKernelIsa(), std::memory_order_relaxed);
+    }
+
+    void cylinderTransformScalar(float* x, float* y, float* z, size_t count){
+        using namespace KernelConst;
+        for(size_t i = 0; i < count; ++i){
+            float k = radius / std::sqrt(x[i] * x[i] + z[i] * z[i]);
+            x[i] *= k;
+            z[i] *= k;
+            y[i] = radius * asinApprox((y[i] - y_shift) * inv_radius) + y_shift;
+        }
+    }
+
+    void projectToPlaneScalar(float* x, float* z, size_t count){
+        using namespace KernelConst;
+        for(size_t i = 0; i < count; ++i){
+            float z_asin = planeAngle(x[i], z[i]);
+            if(!std::signbit(x[i])){
+                x[i] = half_pi - z_asin;
+            }
+            else if(x[i] != 0.0f){
+                x[i] = z_asin - half_pi;
+            }
+            z[i] = -radius;
+        }
+    }
+
+    void cylinderTransform(float* x, float* y, float* z, size_t count){
+        switch(activeKernelIsa()){
+#if defined(SPHERE_UNFOLD_X86_KERNELS)
+        case KernelIsa::AVX2:
+            cylinderTransformAVX2(x, y, z, count);
+            break;
+        case KernelIsa::SSE41:
+            cylinderTransformSSE41(x, y, z, count);
+            break;
+#endif
+        default:
+            cylinderTransformScalar(x, y, z, count);
+        }
+    }
+
+    void projectToPlane(float* x, float* z, size_t count){
+        switch(activeKernelIsa()){
+#if defined(SPHERE_UNFOLD_X86_KERNELS)
+        case KernelIsa::AVX2:
+            projectToPlaneAVX2(x, z, count);
+            break;
+        case KernelIsa::SSE41:
+            projectToPlaneSSE41(x, z, count);
+            break;
+#endif
+        default:
+            projectToPlaneScalar(x, z, count);
+        }
+    }
+
+    void toCylinder(StrokeBuffer& strokes){
+        cylinderTransform(strokes.x.data(), strokes.y.data(), strokes.z.data(), strokes.vertexCount());
+    }
+
+    void projectPoints(StrokeBuffer& strokes){
+        projectToPlane(strokes.x.data(), strokes.z.data(), strokes.vertexCount());
+    }
+
+    /* Appends the vertices [from, to) of the stroke starting at begin to result, splitting it on the seam */
+    static void splitStrokeRange(const StrokeBuffer& strokes, size_t begin, size_t from, size_t to, const StrokeColor& color,
+                                 StrokeBuffer& result){
+        const float* x = strokes.x.data();
+        const float* y = strokes.y.data();
+        const float* z = strokes.z.data();
+
+        for(size_t curr = from; curr < to; ++curr){
+            size_t prev = curr - 1;
+            if(curr != begin && z[curr] > 0.00001f && std::signbit(x[curr]) != std::signbit(x[prev])){
+                /* Close the piece on the seam and open the next one on the mirrored side of it */
+                float z_inter = -x[curr] * (z[prev] - z[curr]) / (x[prev] - x[curr]) + z[curr];
+                float y_inter = -x[curr] * (y[prev] - y[curr]) / (x[prev] - x[curr]) + y[curr];
+                float seam_x = std::signbit(x[prev]) ? -0.000001f : 0.000001f;
+
+                result.append(seam_x, y_inter, z_inter);
+                result.beginStroke(color);
+                result.append(-seam_x, y_inter, z_inter);
+            }
+            result.append(x[curr], y[curr], z[curr]);
+        }
+    }
+
+    void splitSeam(const StrokeBuffer& strokes, StrokeBuffer& result){
+        result.clear();
+        result.reserve(strokes.strokeCount(), strokes.vertexCount() + strokes.vertexCount() / 64);
+        for(size_t stroke = 0; stroke < strokes.strokeCount(); ++stroke){
+            size_t begin = strokes.strokeBegin(stroke), end = strokes.strokeBegin(stroke + 1);
+            result.beginStroke(strokes.colors[stroke]);
+            splitStrokeRange(strokes, begin, begin, end, strokes.colors[stroke], result);
+        }
+    }
+
+    void unfold(StrokeBuffer& strokes){
+        {
+            PROFILE_SCOPE("toCylinder");
+            toCylinder(strokes);
+        }
+
+        StrokeBuffer split;
+        {
+            PROFILE_SCOPE("splitSeam");
+            splitSeam(strokes, split);
+        }
+        {
+            PROFILE_SCOPE("projectPoints");
+            projectPoints(split);
+        }
+        strokes = std::move(split);
+    }
+
+    /* Vertices per task: a few hundred KB of positions, enough tasks to keep 32 threads busy on a million vertices */
+    static const size_t UNFOLD_TASK_VERTICES = 1 << 15;
+
+    void unfold(StrokeBuffer& strokes, Utils::WorkStealingPool& pool){
+        const size_t count = strokes.vertexCount();
+        const size_t tasks = (count + UNFOLD_TASK_VERTICES - 1) / UNFOLD_TASK_VERTICES;
+        if(tasks <= 1 || pool.getThreadCount() <= 1){
+            unfold(strokes);
+            return;
+        }
+
+        /* The kernels handle the tail of a range with the same vector code, so the cut points do not change results */
+        {
+            PROFILE_SCOPE("toCylinder");
+            pool.parallelFor(tasks, [&](size_t task){
+                size_t from = task * UNFOLD_TASK_VERTICES;
+                cylinderTransform(strokes.x.data() + from, strokes.y.data() + from, strokes.z.data() + from,
+                                  std::min(UNFOLD_TASK_VERTICES, count - from));
+            });
+        }
+
+        /* Every task splits and projects its own vertex range into a separate buffer. A range starting inside a
+           stroke opens a piece continuing it, the merge appends that piece to the stroke instead of starting one */
+        std::vector<StrokeBuffer> pieces(tasks);
+        std::vector<uint8_t> continues(tasks, 0);
+        {
+            PROFILE_SCOPE("splitSeam");
+            const std::vector<uint32_t>& offsets = strokes.offsets;
+            const size_t stroke_count = strokes.strokeCount();
+            pool.parallelFor(tasks, [&](size_t task){
+                size_t from = task * UNFOLD_TASK_VERTICES, to = std::min(from + UNFOLD_TASK_VERTICES, count);
+                StrokeBuffer& piece = pieces[task];
+                piece.reserve(4, (to - from) + (to - from) / 64);
+
+                /* Strokes beginning in [from, to) belong to this task, the last one also takes empty trailing strokes */
+                size_t first = std::lower_bound(offsets.begin(), offsets.begin() + stroke_count, (uint32_t)from) - offsets.begin();
+                size_t last = task + 1 == tasks ? stroke_count :
+                              std::lower_bound(offsets.begin(), offsets.begin() + stroke_count, (uint32_t)to) - offsets.begin();
+                if(first > 0 && offsets[first] > from){
+                    size_t stroke = first - 1;
+                    continues[task] = 1;
+                    piece.beginStroke(strokes.colors[stroke]);
+                    splitStrokeRange(strokes, offsets[stroke], from, std::min<size_t>(offsets[stroke + 1], to), strokes.colors[stroke], piece);
+                }
+                for(size_t stroke = first; stroke < last; ++stroke){
+                    piece.beginStroke(strokes.colors[stroke]);
+                    splitStrokeRange(strokes, offsets[stroke], offsets[stroke], std::min<size_t>(offsets[stroke + 1], to),
+                                     strokes.colors[stroke], piece);
+                }
+                projectPoints(piece);
+            });
+        }
+
+        std::vector<size_t> vertex_base(tasks), stroke_base(tasks);
+        size_t total_vertices = 0, total_strokes = 0;
+        for(size_t task = 0; task < tasks; ++task){
+            vertex_base[task] = total_vertices;
+            stroke_base[task] = total_strokes;
+            total_vertices += pieces[task].vertexCount();
+            total_strokes += pieces[task].strokeCount() - continues[task];
+        }
+
+        StrokeBuffer result;
+        result.x.resize(total_vertices);
+        result.y.resize(total_vertices);
+        result.z.resize(total_vertices);
+        result.offsets.resize(total_strokes + 1);
+        result.colors.resize(total_strokes);
+        {
+            PROFILE_SCOPE("merge");
+            pool.parallelFor(tasks, [&](size_t task){
+                const StrokeBuffer& piece = pieces[task];
+                std::copy(piece.x.begin(), piece.x.end(), result.x.begin() + vertex_base[task]);
+                std::copy(piece.y.begin(), piece.y.end(), result.y.begin() + vertex_base[task]);
+                std::copy(piece.z.begin(), piece.z.end(), result.z.begin() + vertex_base[task]);
+                for(size_t stroke = continues[task]; stroke < piece.strokeCount(); ++stroke){
+                    size_t target = stroke_base[task] + stroke - continues[task];
+                    result.offsets[target] = (uint32_t)(vertex_base[task] + piece.offsets[stroke]);
+                    result.colors[target] = piece.colors[stroke];
+                }
+            });
+        }
+        result.offsets[total_strokes] = (uint32_t)total_vertices;
+        strokes = std::move(result);
+    }
+
+    UnfoldPrecision checkUnfoldPrecision(const std::vector<std::vector<double>>& strips, KernelIsa isa){
+        KernelIsa previous = activeKernelIsa();
+        setKernelIsa(isa);
+
+        UnfoldPrecision precision;
+        std::vector<std::vector<double>> reference;
+        for(const std::vector<double>& strip : strips){
+            if(!strip.empty()){
+                reference.push_back(strip);
+            }
+        }
+        StrokeBuffer strokes = StrokeBuffer::fromStrips(reference);
+        precision.vertices = strokes.vertexCount();
+
+        auto maxError = [&](){
+            double error = 0.0;
+            size_t vertex = 0;
+            for(const std::vector<double>& strip : reference){
+                for(size_t v_num = 0; v_num < strip.size(); v_num += VERTEX_STRIDE, ++vertex){
+                    error = std::max({error, std::fabs(strip[v_num] - strokes.x[vertex]), std::fabs(strip[v_num + 1] - strokes.y[vertex]),
+                                      std::fabs(strip[v_num + 2] - strokes.z[vertex])});
+                }
+            }
+            return error;
+        };
+
+        /* Both passes are compared separately, the seam split is exact and would only shift vertex indices */
+        Geometry::toCylinder(reference);
+        toCylinder(strokes);
+        precision.cylinder_error = maxError();
+
+        Geometry::projectPoints(reference);
+        projectPoints(strokes);
+        precision.plane_error = maxError();
+
+        setKernelIsa(previous);
+        return precision;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "StrokeBuffer.h"
+
+namespace Utils{
+    class WorkStealingPool;
+}
+
+/*
+    Vectorized single precision unfold kernels working on StrokeBuffer arrays. The instruction set is picked
+    at runtime(AVX2+FMA, SSE4.1 or the portable scalar code), every variant uses the same asin approximation.
+*/
+namespace Geometry{
+    enum class KernelIsa{
+        Scalar,
+        SSE41,
+        AVX2
+    };
+
+    const char* kernelIsaName(KernelIsa isa);
+
+    /* The best instruction set supported by this CPU(and this build) */
+    KernelIsa detectKernelIsa();
+    KernelIsa activeKernelIsa();
+
+    /* Forces an instruction set(for precision checks and benchmarks), unsupported ones fall back to the detected one */
+    void setKernelIsa(KernelIsa isa);
+
+    /* "Sphere" -> "cylinder" view of count vertices */
+    void cylinderTransform(float* x, float* y, float* z, size_t count);
+
+    /* "Cylinder" view -> unfolded z = -S_RADIUS plane */
+    void projectToPlane(float* x, float* z, size_t count);
+
+    void toCylinder(StrokeBuffer& strokes);
+    void projectPoints(StrokeBuffer& strokes);
+
+    /* Single pass O(n) seam split: strokes crossing the seam are streamed into several strokes of result */
+    void splitSeam(const StrokeBuffer& strokes, StrokeBuffer& result);
+
+    /* Cylinder transform, seam split, and projection of the whole buffer */
+    void unfold(StrokeBuffer& strokes);
+
+    /* The same pipeline in vertex range tasks on the pool(long strokes are cut between tasks too), the pieces of
+       the seam split are merged in order so the result is bit for bit the one of unfold(strokes) */
+    void unfold(StrokeBuffer& strokes, Utils::WorkStealingPool& pool);
+
+    /* Maximal absolute errors of the float kernels compared to the double precision strip path */
+    struct UnfoldPrecision{
+        double cylinder_error = 0.0;
+        double plane_error = 0.0;
+        size_t vertices = 0;
+    };
+
+    UnfoldPrecision checkUnfoldPrecision(const std::vector<std::vector<double>>& strips, KernelIsa isa);
+}
@@ -0,0 +1,102 @@
+#include "UnfoldKernelImpl.h"
+
+#include <immintrin.h>
+
+/* Compiled with -mavx2 -mfma, only called after the runtime CPU check in UnfoldKernel.cpp */
+namespace Geometry{
+    static inline __m256 asinAVX2(__m256 v){
+        using namespace KernelConst;
+        const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+        __m256 sign = _mm256_and_ps(v, sign_mask);
+        __m256 a = _mm256_min_ps(_mm256_andnot_ps(sign_mask, v), _mm256_set1_ps(1.0f));
+        __m256 big = _mm256_cmp_ps(a, _mm256_set1_ps(0.5f), _CMP_GT_OQ);
+
+        __m256 z_big = _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_sub_ps(_mm256_set1_ps(1.0f), a));
+        __m256 z = _mm256_blendv_ps(_mm256_mul_ps(a, a), z_big, big);
+        __m256 s = _mm256_blendv_ps(a, _mm256_sqrt_ps(z_big), big);
+
+        __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(p4), z, _mm256_set1_ps(p3));
+        p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(p2));
+        p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(p1));
+        p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(p0));
+
+        __m256 r = _mm256_fmadd_ps(_mm256_mul_ps(s, z), p, s);
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(half_pi), _mm256_add_ps(r, r)), big);
+        return _mm256_or_ps(r, sign);
+    }
+
+    static inline void cylinderBlockAVX2(float* x, float* y, float* z){
+        using namespace KernelConst;
+        __m256 vx = _mm256_loadu_ps(x), vy = _mm256_loadu_ps(y), vz = _mm256_loadu_ps(z);
+
+        __m256 k = _mm256_div_ps(_mm256_set1_ps(radius), _mm256_sqrt_ps(_mm256_fmadd_ps(vx, vx, _mm256_mul_ps(vz, vz))));
+        _mm256_storeu_ps(x, _mm256_mul_ps(vx, k));
+        _mm256_storeu_ps(z, _mm256_mul_ps(vz, k));
+
+        __m256 angle = asinAVX2(_mm256_mul_ps(_mm256_sub_ps(vy, _mm256_set1_ps(y_shift)), _mm256_set1_ps(inv_radius)));
+        _mm256_storeu_ps(y, _mm256_fmadd_ps(_mm256_set1_ps(radius), angle, _mm256_set1_ps(y_shift)));
+    }
+
+    static inline void projectBlockAVX2(float* x, float* z){
+        using namespace KernelConst;
+        __m256 vx = _mm256_loadu_ps(x), vz = _mm256_loadu_ps(z);
+
+        /* Same as planeAngle(): near the poles of the z axis the angle comes from |x| */
+        const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+        __m256 t = _mm256_xor_ps(_mm256_mul_ps(vz, _mm256_set1_ps(inv_radius)), sign_mask);
+        __m256 u = _mm256_mul_ps(_mm256_andnot_ps(sign_mask, vx), _mm256_set1_ps(inv_radius));
+        __m256 direct = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, t), _mm256_set1_ps(complement_limit), _CMP_LE_OQ);
+        __m256 angle = asinAVX2(_mm256_blendv_ps(u, t, direct));
+        __m256 complement = _mm256_or_ps(_mm256_sub_ps(_mm256_set1_ps(half_pi), angle), _mm256_and_ps(t, sign_mask));
+        __m256 z_asin = _mm256_blendv_ps(complement, angle, direct);
+        __m256 positive = _mm256_sub_ps(_mm256_set1_ps(half_pi), z_asin);
+        __m256 negative = _mm256_sub_ps(z_asin, _mm256_set1_ps(half_pi));
+
+        /* Sign bit set: the left half, except for -0.0f which keeps its value(same as the double path) */
+        __m256 sign_set = _mm256_castsi256_ps(_mm256_srai_epi32(_mm256_castps_si256(vx), 31));
+        negative = _mm256_blendv_ps(negative, vx, _mm256_cmp_ps(vx, _mm256_setzero_ps(), _CMP_EQ_OQ));
+        _mm256_storeu_ps(x, _mm256_blendv_ps(positive, negative, sign_set));
+        _mm256_storeu_ps(z, _mm256_set1_ps(-radius));
+    }
+
+    void cylinderTransformAVX2(float* x, float* y, float* z, size_t count){
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8){
+            cylinderBlockAVX2(x + i, y + i, z + i);
+        }
+        if(i < count){
+            /* The tail goes through the same vector code so results never depend on where a range starts */
+            float tx[8] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}, ty[8] = {}, tz[8] = {};
+            for(size_t j = i; j < count; ++j){
+                tx[j - i] = x[j];
+                ty[j - i] = y[j];
+                tz[j - i] = z[j];
+            }
+            cylinderBlockAVX2(tx, ty, tz);
+            for(size_t j = i; j < count; ++j){
+                x[j] = tx[j - i];
+                y[j] = ty[j - i];
+                z[j] = tz[j - i];
+            }
+        }
+    }
+
+    void projectToPlaneAVX2(float* x, float* z, size_t count){
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8){
+            projectBlockAVX2(x + i, z + i);
+        }
+        if(i < count){
+            float tx[8] = {}, tz[8] = {};
+            for(size_t j = i; j < count; ++j){
+                tx[j - i] = x[j];
+                tz[j - i] = z[j];
+            }
+            projectBlockAVX2(tx, tz);
+            for(size_t j = i; j < count; ++j){
+                x[j] = tx[j - i];
+                z[j] = tz[j - i];
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "SphereUnfold.h"
+
+/* Internal header shared by the kernel translation units(each one is compiled for its own instruction set) */
+namespace Geometry{
+    namespace KernelConst{
+        const float radius = (float)S_RADIUS;
+        const float inv_radius = (float)(1.0 / S_RADIUS);
+        const float y_shift = (float)camera_y_shift;
+        const float half_pi = 1.57079632679f;
+        const float complement_limit = 0.70710678f;
+
+        /* Cephes asinf minimax polynomial, about 1 ulp on [-1, 1] */
+        const float p0 = 1.6666752422E-1f;
+        const float p1 = 7.4953002686E-2f;
+        const float p2 = 4.5470025998E-2f;
+        const float p3 = 2.4181311049E-2f;
+        const float p4 = 4.2163199048E-2f;
+    }
+
+    /* Scalar version of the asin approximation used by all of the vector kernels(static, so no copy built
+       for another instruction set can be picked by the linker) */
+    static inline float asinApprox(float v){
+        using namespace KernelConst;
+        float a = std::fabs(v);
+        a = a > 1.0f ? 1.0f : a;
+        bool big = a > 0.5f;
+        float z = big ? 0.5f * (1.0f - a) : a * a;
+        float s = big ? std::sqrt(z) : a;
+        float p = (((p4 * z + p3) * z + p2) * z + p1) * z + p0;
+        float r = s + s * z * p;
+        r = big ? half_pi - 2.0f * r : r;
+        return std::copysign(r, v);
+    }
+
+    /*
+        asin(-z / S_RADIUS) of a point on the cylinder. Close to |z| = S_RADIUS the asin is badly conditioned
+        for float inputs, so there the angle is taken from the complementary |x| coordinate instead.
+    */
+    static inline float planeAngle(float x, float z){
+        using namespace KernelConst;
+        float t = -z * inv_radius;
+        if(std::fabs(t) <= complement_limit){
+            return asinApprox(t);
+        }
+        return std::copysign(half_pi - asinApprox(std::fabs(x) * inv_radius), t);
+    }
+
+    void cylinderTransformScalar(float* x, float* y, float* z, size_t count);
+    void projectToPlaneScalar(float* x, float* z, size_t count);
+
+#if defined(SPHERE_UNFOLD_X86_KERNELS)
+    void cylinderTransformSSE41(float* x, float* y, float* z, size_t count);
+    void projectToPlaneSSE41(float* x, float* z, size_t count);
+
+    void cylinderTransformAVX2(float* x, float* y, float* z, size_t count);
+    void projectToPlaneAVX2(float* x, float* z, size_t count);
+#endif
+}
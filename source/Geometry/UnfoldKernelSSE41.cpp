@@ -0,0 +1,102 @@
+#include "UnfoldKernelImpl.h"
+
+#include <smmintrin.h>
+
+/* Compiled with -msse4.1, only called after the runtime CPU check in UnfoldKernel.cpp */
+namespace Geometry{
+    static inline __m128 asinSSE41(__m128 v){
+        using namespace KernelConst;
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+        __m128 sign = _mm_and_ps(v, sign_mask);
+        __m128 a = _mm_min_ps(_mm_andnot_ps(sign_mask, v), _mm_set1_ps(1.0f));
+        __m128 big = _mm_cmpgt_ps(a, _mm_set1_ps(0.5f));
+
+        __m128 z_big = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(_mm_set1_ps(1.0f), a));
+        __m128 z = _mm_blendv_ps(_mm_mul_ps(a, a), z_big, big);
+        __m128 s = _mm_blendv_ps(a, _mm_sqrt_ps(z_big), big);
+
+        __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p4), z), _mm_set1_ps(p3));
+        p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(p2));
+        p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(p1));
+        p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(p0));
+
+        __m128 r = _mm_add_ps(s, _mm_mul_ps(_mm_mul_ps(s, z), p));
+        r = _mm_blendv_ps(r, _mm_sub_ps(_mm_set1_ps(half_pi), _mm_add_ps(r, r)), big);
+        return _mm_or_ps(r, sign);
+    }
+
+    static inline void cylinderBlockSSE41(float* x, float* y, float* z){
+        using namespace KernelConst;
+        __m128 vx = _mm_loadu_ps(x), vy = _mm_loadu_ps(y), vz = _mm_loadu_ps(z);
+
+        __m128 k = _mm_div_ps(_mm_set1_ps(radius), _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vz, vz))));
+        _mm_storeu_ps(x, _mm_mul_ps(vx, k));
+        _mm_storeu_ps(z, _mm_mul_ps(vz, k));
+
+        __m128 angle = asinSSE41(_mm_mul_ps(_mm_sub_ps(vy, _mm_set1_ps(y_shift)), _mm_set1_ps(inv_radius)));
+        _mm_storeu_ps(y, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(radius), angle), _mm_set1_ps(y_shift)));
+    }
+
+    static inline void projectBlockSSE41(float* x, float* z){
+        using namespace KernelConst;
+        __m128 vx = _mm_loadu_ps(x), vz = _mm_loadu_ps(z);
+
+        /* Same as planeAngle(): near the poles of the z axis the angle comes from |x| */
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+        __m128 t = _mm_xor_ps(_mm_mul_ps(vz, _mm_set1_ps(inv_radius)), sign_mask);
+        __m128 u = _mm_mul_ps(_mm_andnot_ps(sign_mask, vx), _mm_set1_ps(inv_radius));
+        __m128 direct = _mm_cmple_ps(_mm_andnot_ps(sign_mask, t), _mm_set1_ps(complement_limit));
+        __m128 angle = asinSSE41(_mm_blendv_ps(u, t, direct));
+        __m128 complement = _mm_or_ps(_mm_sub_ps(_mm_set1_ps(half_pi), angle), _mm_and_ps(t, sign_mask));
+        __m128 z_asin = _mm_blendv_ps(complement, angle, direct);
+        __m128 positive = _mm_sub_ps(_mm_set1_ps(half_pi), z_asin);
+        __m128 negative = _mm_sub_ps(z_asin, _mm_set1_ps(half_pi));
+
+        /* Sign bit set: the left half, except for -0.0f which keeps its value(same as the double path) */
+        __m128 sign_set = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(vx), 31));
+        negative = _mm_blendv_ps(negative, vx, _mm_cmpeq_ps(vx, _mm_setzero_ps()));
+        _mm_storeu_ps(x, _mm_blendv_ps(positive, negative, sign_set));
+        _mm_storeu_ps(z, _mm_set1_ps(-radius));
+    }
+
+    void cylinderTransformSSE41(float* x, float* y, float* z, size_t count){
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4){
+            cylinderBlockSSE41(x + i, y + i, z + i);
+        }
+        if(i < count){
+            /* The tail goes through the same vector code so results never depend on where a range starts */
+            float tx[4] = {1.0f, 1.0f, 1.0f, 1.0f}, ty[4] = {}, tz[4] = {};
+            for(size_t j = i; j < count; ++j){
+                tx[j - i] = x[j];
+                ty[j - i] = y[j];
+                tz[j - i] = z[j];
+            }
+            cylinderBlockSSE41(tx, ty, tz);
+            for(size_t j = i; j < count; ++j){
+                x[j] = tx[j - i];
+                y[j] = ty[j - i];
+                z[j] = tz[j - i];
+            }
+        }
+    }
+
+    void projectToPlaneSSE41(float* x, float* z, size_t count){
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4){
+            projectBlockSSE41(x + i, z + i);
+        }
+        if(i < count){
+            float tx[4] = {}, tz[4] = {};
+            for(size_t j = i; j < count; ++j){
+                tx[j - i] = x[j];
+                tz[j - i] = z[j];
+            }
+            projectBlockSSE41(tx, tz);
+            for(size_t j = i; j < count; ++j){
+                x[j] = tx[j - i];
+                z[j] = tz[j - i];
+            }
+        }
+    }
+}
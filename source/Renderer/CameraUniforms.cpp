@@ -0,0 +1,20 @@
+#include "CameraUniforms.h"
+
+namespace Renderer{
+	CameraUniforms::CameraUniforms(){
+		glGenBuffers(1, &ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+	}
+	CameraUniforms::~CameraUniforms(){
+		glDeleteBuffers(1, &ubo);
+	}
+	void CameraUniforms::update(const glm::mat4& view, const glm::mat4& projection){
+		Block block = {view, projection};
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace Renderer{
+	/*
+		std140 uniform block with the per-frame camera matrices. It is bound to one binding point that every
+		program's "Camera" block uses, so the matrices are uploaded once per frame however many programs and
+		draw calls use them:
+
+			layout(std140, binding = 0) uniform Camera{
+				mat4 view_t;
+				mat4 projection_t;
+			};
+	*/
+	class CameraUniforms{
+	public:
+		static constexpr GLuint BINDING = 0;
+		static constexpr const char* BLOCK_NAME = "Camera";
+
+		CameraUniforms();
+		~CameraUniforms();
+
+		CameraUniforms(const CameraUniforms&) = delete;
+		CameraUniforms& operator=(const CameraUniforms&) = delete;
+
+		/* One buffer update, the block stays bound to BINDING */
+		void update(const glm::mat4& view, const glm::mat4& projection);
+
+	private:
+		/* Matches the std140 layout of the block: two column major mat4 without padding */
+		struct Block{
+			glm::mat4 view;
+			glm::mat4 projection;
+		};
+
+		GLuint ubo = 0;
+	};
+}
@@ -0,0 +1,24 @@
+#include "FrameScheduler.h"
+
+#include <GLFW/glfw3.h>
+
+namespace Renderer{
+	FrameScheduler::FrameScheduler(double busyInterval) : busy_interval(busyInterval > 0.0 ? busyInterval : 1.0 / 120.0){
+	}
+	unsigned FrameScheduler::takeDirty(){
+		unsigned flags = dirty;
+		dirty = 0;
+		return flags;
+	}
+	void FrameScheduler::waitEvents(bool busy){
+		if(dirty != 0){
+			glfwPollEvents();
+		}
+		else if(busy){
+			glfwWaitEventsTimeout(busy_interval);
+		}
+		else{
+			glfwWaitEvents();
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+namespace Renderer{
+	/*
+		Decides when a frame has to be drawn at all. Input callbacks and the frame loop mark what changed, the loop
+		draws only if something is dirty and otherwise blocks in glfwWaitEvents() until the next event arrives, so an
+		idle window costs no CPU or GPU time. Work that finishes on its own(PNG readbacks, a save waiting for a free
+		slot) keeps the loop waking up with a short timeout instead.
+	*/
+	class FrameScheduler{
+	public:
+		enum Dirty : unsigned{
+			Camera = 1u << 0,
+			Strokes = 1u << 1,
+			Projection = 1u << 2,
+			Export = 1u << 3,
+			Window = 1u << 4,
+			All = ~0u
+		};
+
+		/* busyInterval is how often pending work is polled for, in seconds */
+		explicit FrameScheduler(double busyInterval = 1.0 / 120.0);
+
+		void markDirty(unsigned flags){ dirty |= flags; }
+		bool isDirty() const { return dirty != 0; }
+
+		/* What changed since the last call, the flags are cleared */
+		unsigned takeDirty();
+
+		/*
+			Processes pending window events, blocking until there is one if nothing is dirty and busy is false.
+			Replaces glfwPollEvents() at the end of the frame loop.
+		*/
+		void waitEvents(bool busy);
+
+	private:
+		/* The first frame is always drawn */
+		unsigned dirty = All;
+		double busy_interval;
+	};
+}
@@ -0,0 +1,53 @@
+#include "GpuTimer.h"
+#include "../Utils/Profiler.h"
+
+namespace Renderer{
+	GpuTimer::GpuTimer(size_t queryCount) : queries(queryCount > 0 ? queryCount : 1){
+		for(Query& query : queries){
+			glGenQueries(1, &query.id);
+		}
+	}
+	GpuTimer::~GpuTimer(){
+		for(Query& query : queries){
+			glDeleteQueries(1, &query.id);
+		}
+	}
+	void GpuTimer::begin(const char* name){
+		Utils::Profiler& profiler = Utils::Profiler::global();
+		Query& query = queries[next];
+		/* The whole ring is still waiting for the GPU: this stage is just not timed */
+		if(!profiler.isEnabled() || running || query.pending){
+			return;
+		}
+		query.name = name;
+		query.cpu_start = Utils::Profiler::now();
+		query.frame = profiler.getFrame();
+		glBeginQuery(GL_TIME_ELAPSED, query.id);
+		running = true;
+	}
+	void GpuTimer::end(){
+		if(!running){
+			return;
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		queries[next].pending = true;
+		next = (next + 1) % queries.size();
+		running = false;
+	}
+	void GpuTimer::collect(){
+		/* Queries finish in order, so stop at the first one that is not available yet */
+		while(queries[oldest].pending){
+			Query& query = queries[oldest];
+			GLint available = 0;
+			glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+			if(!available){
+				break;
+			}
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed);
+			Utils::Profiler::global().recordGpu(query.name, query.cpu_start, elapsed, query.frame);
+			query.pending = false;
+			oldest = (oldest + 1) % queries.size();
+		}
+	}
+}
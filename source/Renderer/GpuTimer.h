@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Renderer{
+	/*
+		GL_TIME_ELAPSED queries for frame stages. Results are picked up by collect() a few frames later, when the
+		GPU has finished them, and go into the global Utils::Profiler on the GPU track(the start of a sample is the
+		CPU time its commands were issued). Time elapsed queries can not nest, so stages must not overlap.
+	*/
+	class GpuTimer{
+	public:
+		explicit GpuTimer(size_t queryCount = 64);
+		~GpuTimer();
+
+		GpuTimer(const GpuTimer&) = delete;
+		GpuTimer& operator=(const GpuTimer&) = delete;
+
+		void begin(const char* name);
+		void end();
+
+		/* Non-blocking, call once per frame */
+		void collect();
+
+	private:
+		struct Query{
+			GLuint id = 0;
+			const char* name = nullptr;
+			uint64_t cpu_start = 0;
+			uint32_t frame = 0;
+			bool pending = false;
+		};
+
+		std::vector<Query> queries;
+		size_t next = 0, oldest = 0;
+		bool running = false;
+	};
+
+	/* Times the GL commands issued in the enclosing block */
+	class GpuScope{
+	public:
+		GpuScope(GpuTimer& timer, const char* name) : timer(timer){ timer.begin(name); }
+		~GpuScope(){ timer.end(); }
+
+		GpuScope(const GpuScope&) = delete;
+		GpuScope& operator=(const GpuScope&) = delete;
+
+	private:
+		GpuTimer& timer;
+	};
+}
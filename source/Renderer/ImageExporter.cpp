@@ -0,0 +1,123 @@
+#include "ImageExporter.h"
+#include "../Utils/ThreadPool.h"
+#include "../Export/ImageWriter.h"
+#include "../Utils/Profiler.h"
+
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace Renderer{
+	ImageExporter::ImageExporter(Utils::ThreadPool& encoders, size_t slotCount) : encoders(encoders), slots(slotCount > 0 ? slotCount : 1){
+		for(Slot& slot : slots){
+			glGenBuffers(1, &slot.PBO);
+		}
+	}
+	ImageExporter::~ImageExporter(){
+		flush();
+		for(Slot& slot : slots){
+			glDeleteBuffers(1, &slot.PBO);
+		}
+	}
+	bool ImageExporter::canCapture() const{
+		for(const Slot& slot : slots){
+			if(slot.state == SlotState::Free){
+				return true;
+			}
+		}
+		return false;
+	}
+	bool ImageExporter::capture(int width, int height, const std::string& filepath){
+		Slot* slot = nullptr;
+		for(Slot& candidate : slots){
+			if(candidate.state == SlotState::Free){
+				slot = &candidate;
+				break;
+			}
+		}
+		if(!slot){
+			return false;
+		}
+
+		size_t size = (size_t)width * height * 3;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->PBO);
+		if(size > slot->capacity){
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+			slot->capacity = size;
+		}
+
+		/* With a pack buffer bound glReadPixels returns right away, the copy runs on the GPU */
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot->state = SlotState::Reading;
+		slot->width = width;
+		slot->height = height;
+		slot->filepath = filepath;
+		return true;
+	}
+	void ImageExporter::poll(){
+		for(Slot& slot : slots){
+			process(slot, 0);
+		}
+	}
+	void ImageExporter::flush(){
+		for(Slot& slot : slots){
+			while(slot.state != SlotState::Free){
+				process(slot, GL_TIMEOUT_IGNORED);
+				if(slot.state == SlotState::Ready){
+					/* The encoder queue is full, give the workers some time */
+					std::this_thread::yield();
+				}
+			}
+		}
+		encoders.waitIdle();
+	}
+	size_t ImageExporter::getPendingCount() const{
+		size_t pending = 0;
+		for(const Slot& slot : slots){
+			pending += slot.state != SlotState::Free;
+		}
+		return pending;
+	}
+	void ImageExporter::process(Slot& slot, GLuint64 timeout){
+		if(slot.state == SlotState::Reading){
+			GLenum status = glClientWaitSync(slot.fence, timeout == 0 ? 0 : GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+			if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED){
+				return;
+			}
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+
+			size_t size = (size_t)slot.width * slot.height * 3;
+			slot.pixels.resize(size);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+			const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+			if(mapped){
+				std::memcpy(slot.pixels.data(), mapped, size);
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			slot.state = SlotState::Ready;
+		}
+
+		if(slot.state == SlotState::Ready){
+			/* The pixel vector moves to the encoder only if the queue accepts the task, otherwise try next frame */
+			auto pixels = std::make_shared<std::vector<unsigned char>>();
+			pixels->swap(slot.pixels);
+			int width = slot.width, height = slot.height;
+			std::string filepath = slot.filepath;
+			bool queued = encoders.trySubmit([pixels, width, height, filepath](){
+				PROFILE_SCOPE("encodePng");
+				Export::writePng(filepath, width, height, 3, pixels->data(), width * 3, true);
+			});
+			if(!queued){
+				slot.pixels.swap(*pixels);
+				return;
+			}
+			slot.state = SlotState::Free;
+		}
+	}
+}
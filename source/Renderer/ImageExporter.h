@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+namespace Utils{
+	class ThreadPool;
+}
+
+namespace Renderer{
+	/*
+		Asynchronous screenshot export. capture() only queues a glReadPixels into a pixel buffer object and
+		a fence, poll() picks up finished readbacks and hands the pixels to the encoder pool, which compresses
+		and writes the PNG. The render thread never waits for the GPU, zlib or the disk.
+	*/
+	class ImageExporter{
+	public:
+		ImageExporter(Utils::ThreadPool& encoders, size_t slotCount = 2);
+		~ImageExporter();
+
+		ImageExporter(const ImageExporter&) = delete;
+		ImageExporter& operator=(const ImageExporter&) = delete;
+
+		/* False while every readback slot is busy, captures should be postponed until a slot gets free */
+		bool canCapture() const;
+
+		/* Starts reading the current read framebuffer into a free slot, returns false if there is none */
+		bool capture(int width, int height, const std::string& filepath);
+
+		/* Non-blocking, call once per frame */
+		void poll();
+
+		/* Blocks until every capture is written(for shutdown) */
+		void flush();
+
+		size_t getPendingCount() const;
+
+	private:
+		enum class SlotState{
+			Free,
+			Reading,
+			Ready
+		};
+
+		struct Slot{
+			GLuint PBO = 0;
+			GLsync fence = nullptr;
+			SlotState state = SlotState::Free;
+			int width = 0, height = 0;
+			size_t capacity = 0;
+			std::string filepath;
+			std::vector<unsigned char> pixels;
+		};
+
+		Utils::ThreadPool& encoders;
+		std::vector<Slot> slots;
+
+		void process(Slot& slot, GLuint64 timeout);
+	};
+}
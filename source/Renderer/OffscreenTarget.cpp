@@ -0,0 +1,68 @@
+#include "OffscreenTarget.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Renderer{
+	OffscreenTarget::OffscreenTarget(int width, int height){
+		glGenFramebuffers(1, &FBO);
+		glGenRenderbuffers(1, &color_RBO);
+		glGenRenderbuffers(1, &depth_RBO);
+		resize(width, height);
+	}
+	OffscreenTarget::~OffscreenTarget(){
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &color_RBO);
+		glDeleteRenderbuffers(1, &depth_RBO);
+	}
+	void OffscreenTarget::resize(int width, int height){
+		if(width == this->width && height == this->height){
+			return;
+		}
+		this->width = width;
+		this->height = height;
+
+		glBindRenderbuffer(GL_RENDERBUFFER, color_RBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth_RBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		GLint previous;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_RBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_RBO);
+		complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+		if(!complete){
+			std::cerr << "Offscreen target " << width << "x" << height << " is incomplete\n";
+		}
+	}
+	void OffscreenTarget::bind(){
+		glGetIntegerv(GL_VIEWPORT, saved_viewport);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glViewport(0, 0, width, height);
+	}
+	void OffscreenTarget::unbind(){
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(saved_viewport[0], saved_viewport[1], saved_viewport[2], saved_viewport[3]);
+	}
+	void OffscreenTarget::readPixels(int x, int y, int width, int height, unsigned char* pixels) const{
+		GLint previous;
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+	}
+	int OffscreenTarget::maxSize(){
+		GLint renderbuffer_size = 0, viewport_size[2] = {0, 0};
+		glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &renderbuffer_size);
+		glGetIntegerv(GL_MAX_VIEWPORT_DIMS, viewport_size);
+		return std::min({renderbuffer_size, viewport_size[0], viewport_size[1]});
+	}
+}
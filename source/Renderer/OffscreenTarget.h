@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace Renderer{
+	/*
+		Framebuffer object with RGBA8 color and 24-bit depth renderbuffers. Exports render here instead of the
+		window's back buffer, so their resolution does not depend on the display.
+	*/
+	class OffscreenTarget{
+	public:
+		OffscreenTarget(int width, int height);
+		~OffscreenTarget();
+
+		OffscreenTarget(const OffscreenTarget&) = delete;
+		OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+		/* Reallocates the attachments if the size changed */
+		void resize(int width, int height);
+
+		/* Makes the target the draw and read framebuffer and sets the viewport to its size */
+		void bind();
+
+		/* Restores the default framebuffer and the viewport that was set before bind() */
+		void unbind();
+
+		/* Synchronous readback of the RGB pixels, rows from bottom to top without padding */
+		void readPixels(int x, int y, int width, int height, unsigned char* pixels) const;
+
+		bool isComplete() const { return complete; }
+		int getWidth() const { return width; }
+		int getHeight() const { return height; }
+
+		/* Largest side a single target may have on this GL implementation */
+		static int maxSize();
+
+	private:
+		GLuint FBO = 0, color_RBO = 0, depth_RBO = 0;
+		int width = 0, height = 0;
+		bool complete = false;
+		GLint saved_viewport[4] = {0, 0, 0, 0};
+	};
+}
@@ -1,30 +1,67 @@
 #include "ShaderProgram.h"
+#include "CameraUniforms.h"
+
+#include <algorithm>
+#include <vector>
 
 namespace Renderer{
-	ShaderProgram::ShaderProgram(std::string& vertexCode, std::string& fragmentCode){
-		const char* vShader = vertexCode.c_str();
-		const char* fShader = fragmentCode.c_str();
+	ShaderProgram::ShaderProgram(std::string_view vertexCode, std::string_view fragmentCode, std::string_view geometryCode){
+		const char* vShader = vertexCode.data();
+		const char* fShader = fragmentCode.data();
+		GLint vLength = (GLint)vertexCode.size(), fLength = (GLint)fragmentCode.size();
 
 		GLuint vertexShader, fragmentShader;
 
 		vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, 1, &vShader, NULL);
+		glShaderSource(vertexShader, 1, &vShader, &vLength);
 		glCompileShader(vertexShader);
 		checkCompileErrors(vertexShader, "VERTEX");
 
 		fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &fShader, NULL);
+		glShaderSource(fragmentShader, 1, &fShader, &fLength);
 		glCompileShader(fragmentShader);
 		checkCompileErrors(fragmentShader, "FRAGMENT");
 
+		GLuint geometryShader = 0;
+		if(!geometryCode.empty()){
+			const char* gShader = geometryCode.data();
+			GLint gLength = (GLint)geometryCode.size();
+			geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
+			glShaderSource(geometryShader, 1, &gShader, &gLength);
+			glCompileShader(geometryShader);
+			checkCompileErrors(geometryShader, "GEOMETRY");
+		}
+
 		ID = glCreateProgram();
 		glAttachShader(ID, vertexShader);
 		glAttachShader(ID, fragmentShader);
+		if(geometryShader){
+			glAttachShader(ID, geometryShader);
+		}
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		if(isCompiled){
+			reflectUniforms();
+		}
 
 		glDeleteShader(vertexShader);
 		glDeleteShader(fragmentShader);
+		if(geometryShader){
+			glDeleteShader(geometryShader);
+		}
+	}
+	ShaderProgram::ShaderProgram(GLenum binaryFormat, const void* binary, GLsizei length){
+		ID = glCreateProgram();
+		glProgramBinary(ID, binaryFormat, binary, length);
+
+		/* A rejected binary is not an error, the caller compiles the sources instead */
+		GLint success = GL_FALSE;
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		isCompiled = success == GL_TRUE;
+		if(isCompiled){
+			reflectUniforms();
+		}
 	}
 	ShaderProgram::~ShaderProgram(){
 		glDeleteProgram(ID);
@@ -32,6 +69,7 @@ namespace Renderer{
 	ShaderProgram::ShaderProgram(ShaderProgram&& shaderProgram){
 		ID = shaderProgram.ID;
 		isCompiled = shaderProgram.isCompiled;
+		uniform_locations = std::move(shaderProgram.uniform_locations);
 		shaderProgram.ID = 0;
 		shaderProgram.isCompiled = false;
 	}
@@ -39,6 +77,7 @@ namespace Renderer{
 		glDeleteProgram(ID);
 		ID = shaderProgram.ID;
 		isCompiled = shaderProgram.isCompiled;
+		uniform_locations = std::move(shaderProgram.uniform_locations);
 		shaderProgram.ID = 0;
 		shaderProgram.isCompiled = false;
 
@@ -50,33 +89,103 @@ namespace Renderer{
 	bool ShaderProgram::checkCompilationSuccess(){
 		return isCompiled;
 	}
+	bool ShaderProgram::getBinary(GLenum& binaryFormat, std::vector<char>& binary) const{
+		GLint length = 0;
+		if(!isCompiled){
+			return false;
+		}
+		glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+		if(length <= 0){
+			return false;
+		}
+		binary.resize((size_t)length);
+		GLsizei written = 0;
+		glGetProgramBinary(ID, length, &written, &binaryFormat, binary.data());
+		binary.resize((size_t)written);
+		return written > 0;
+	}
 	void ShaderProgram::setBool(const std::string& name, bool value) const{ 
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(getUniformLocation(name), (int)value);
 	}
 	void ShaderProgram::setInt(const std::string& name, int value) const{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(getUniformLocation(name), value);
 	}
 	void ShaderProgram::setFloat(const std::string& name, float value) const{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(getUniformLocation(name), value);
 	}
 	void ShaderProgram::setVec3f(const std::string& name, float v1, float v2, float v3){
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), v1, v2, v3);
+		glUniform3f(getUniformLocation(name), v1, v2, v3);
 	}
 	void ShaderProgram::setVec4f(const std::string& name, float v1, float v2, float v3, float v4){
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), v1, v2, v3, v4);
+		glUniform4f(getUniformLocation(name), v1, v2, v3, v4);
 	}
 	void ShaderProgram::setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     void ShaderProgram::setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     void ShaderProgram::setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
+	GLint ShaderProgram::getUniformLocation(const std::string& name) const{
+		auto found = uniform_locations.find(name);
+		return found != uniform_locations.end() ? found->second : -1;
+	}
+	void ShaderProgram::setInt(GLint location, int value) const{
+		glUniform1i(location, value);
+	}
+	void ShaderProgram::setFloat(GLint location, float value) const{
+		glUniform1f(location, value);
+	}
+	void ShaderProgram::setVec2f(GLint location, float v1, float v2) const{
+		glUniform2f(location, v1, v2);
+	}
+	void ShaderProgram::setVec3f(GLint location, float v1, float v2, float v3) const{
+		glUniform3f(location, v1, v2, v3);
+	}
+	void ShaderProgram::setVec4f(GLint location, float v1, float v2, float v3, float v4) const{
+		glUniform4f(location, v1, v2, v3, v4);
+	}
+	void ShaderProgram::setMat4(GLint location, const glm::mat4 &mat) const{
+		glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+	}
+	void ShaderProgram::reflectUniforms(){
+		uniform_locations.clear();
+
+		GLint count = 0, max_length = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+		std::vector<char> name(std::max(max_length, 1));
+		for(GLint i = 0; i < count; i++){
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+			/* Members of uniform blocks have no location */
+			std::string uniform_name(name.data(), length);
+			GLint location = glGetUniformLocation(ID, uniform_name.c_str());
+			if(location < 0){
+				continue;
+			}
+			uniform_locations[uniform_name] = location;
+
+			/* Arrays are reported as "name[0]", they are set by the plain name as well */
+			if(uniform_name.size() > 3 && uniform_name.compare(uniform_name.size() - 3, 3, "[0]") == 0){
+				uniform_locations[uniform_name.substr(0, uniform_name.size() - 3)] = location;
+			}
+		}
+
+		/* The per-frame camera block is shared by every program through one binding point */
+		GLuint camera_block = glGetUniformBlockIndex(ID, CameraUniforms::BLOCK_NAME);
+		if(camera_block != GL_INVALID_INDEX){
+			glUniformBlockBinding(ID, camera_block, CameraUniforms::BINDING);
+		}
+	}
 	void ShaderProgram::checkCompileErrors(GLuint id, std::string type){
 		int success;
 		char infolog[1024];
@@ -5,6 +5,9 @@
 #include <stb_image.h>
 
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -13,7 +16,10 @@ namespace Renderer{
 	class ShaderProgram{
 	public:
 		unsigned int ID;
-		ShaderProgram(std::string& vertexCode, std::string& fragmentCode);
+		/* The sources do not have to be null terminated(e.g. views of mapped files), an empty geometry source means no geometry stage */
+		ShaderProgram(std::string_view vertexCode, std::string_view fragmentCode, std::string_view geometryCode = std::string_view());
+		/* Loads a binary from getBinary(), drivers may reject it(after an update e.g.), check checkCompilationSuccess() */
+		ShaderProgram(GLenum binaryFormat, const void* binary, GLsizei length);
 		~ShaderProgram();
 		ShaderProgram(ShaderProgram&& shaderProgram);
 		ShaderProgram& operator=(ShaderProgram&& shaderProgram);
@@ -25,6 +31,9 @@ namespace Renderer{
 		void use();
 		bool checkCompilationSuccess();
 
+		/* Driver specific binary of the linked program for a later ShaderProgram(binaryFormat, binary, length) */
+		bool getBinary(GLenum& binaryFormat, std::vector<char>& binary) const;
+
 		void setBool(const std::string& name, bool value) const;
 		void setInt(const std::string& name, int value) const;
 		void setFloat(const std::string& name, float value) const;
@@ -34,8 +43,23 @@ namespace Renderer{
 		void setMat3(const std::string &name, const glm::mat3 &mat) const;
 		void setMat4(const std::string &name, const glm::mat4 &mat) const;
 
+		/* Location of an active uniform from the table built at link time(-1 if there is no such uniform) */
+		GLint getUniformLocation(const std::string& name) const;
+
+		/* Setters by a location from getUniformLocation(), they do not look anything up */
+		void setInt(GLint location, int value) const;
+		void setFloat(GLint location, float value) const;
+		void setVec2f(GLint location, float v1, float v2) const;
+		void setVec3f(GLint location, float v1, float v2, float v3) const;
+		void setVec4f(GLint location, float v1, float v2, float v3, float v4) const;
+		void setMat4(GLint location, const glm::mat4 &mat) const;
+
 	private:
 		bool isCompiled = false;
+		std::unordered_map<std::string, GLint> uniform_locations;
+
 		void checkCompileErrors(GLuint id, std::string type);
+		/* Caches the locations of all active uniforms and binds known uniform blocks to their binding points */
+		void reflectUniforms();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "StaticMesh.h"
+
+namespace Renderer{
+	StaticMesh::StaticMesh(const float* vertices, size_t vertexCount, GLenum mode) : count((GLsizei)vertexCount), mode(mode){
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+		GLsizeiptr size = (GLsizeiptr)(vertexCount * 6 * sizeof(float));
+		if(GLAD_GL_VERSION_4_4){
+			glBufferStorage(GL_ARRAY_BUFFER, size, vertices, 0);
+		}
+		else{
+			glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+		}
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
+		glEnableVertexAttribArray(1);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+	StaticMesh::~StaticMesh(){
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+	}
+	void StaticMesh::draw() const{
+		glBindVertexArray(VAO);
+		glDrawArrays(mode, 0, count);
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+namespace Renderer{
+	/*
+		Geometry that never changes after creation(the target box, the floor). It is uploaded once into an
+		immutable buffer(or a GL_STATIC_DRAW one on pre-4.4 contexts) with the interleaved XYZRGB float layout.
+	*/
+	class StaticMesh{
+	public:
+		StaticMesh(const float* vertices, size_t vertexCount, GLenum mode);
+		~StaticMesh();
+
+		StaticMesh() = delete;
+		StaticMesh(const StaticMesh&) = delete;
+		StaticMesh& operator=(const StaticMesh&) = delete;
+
+		void draw() const;
+
+	private:
+		GLuint VAO = 0, VBO = 0;
+		GLsizei count;
+		GLenum mode;
+	};
+}
@@ -0,0 +1,509 @@
+#include "StrokeStore.h"
+#include "../Geometry/StrokeArena.h"
+#include "../Geometry/StrokeBuffer.h"
+
+#include <algorithm>
+
+namespace Renderer{
+	/* Only the position goes to the GPU, converted to floats at upload time */
+	static const size_t VERTEX_SIZE = 3 * sizeof(float);
+	/* RGBA8 line style: the strip color, alpha 255 where a segment starts */
+	static const size_t STYLE_SIZE = 4;
+	/* Culled line ranges closer than this many segments are drawn together, segments between them are cheap */
+	static const size_t LINE_RANGE_GAP = 256;
+	/* The holes apply() leaves are squeezed out once they are more than this part of the used vertices */
+	static const size_t COMPACT_HOLES_DIVISOR = 4;
+
+	StrokeStore::StrokeStore(size_t initialVertexCapacity) : capacity(initialVertexCapacity > 0 ? initialVertexCapacity : 1){
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, capacity * VERTEX_SIZE, nullptr, GL_DYNAMIC_DRAW);
+		setAttributes();
+		glEnableVertexAttribArray(0);
+
+		/* Attribute 1(color) stays disabled: it is a per strip constant set with glVertexAttrib3f */
+		glDisableVertexAttribArray(1);
+
+		glGenVertexArrays(1, &line_VAO);
+		glGenBuffers(1, &style_VBO);
+		glBindVertexArray(line_VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, style_VBO);
+		glBufferData(GL_ARRAY_BUFFER, capacity * STYLE_SIZE, nullptr, GL_DYNAMIC_DRAW);
+		setLineAttributes();
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glVertexAttribDivisor(0, 1);
+		glVertexAttribDivisor(1, 1);
+		glVertexAttribDivisor(2, 1);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+	StrokeStore::~StrokeStore(){
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteVertexArrays(1, &line_VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &style_VBO);
+		if(indirect_buffer){
+			glDeleteBuffers(1, &indirect_buffer);
+		}
+	}
+	template<typename Strips>
+	void StrokeStore::sync(const Strips& strips, size_t mutableTail){
+		if(!appendStrips(strips, mutableTail)){
+			reset();
+			appendStrips(strips, 0);
+		}
+	}
+	void StrokeStore::reset(){
+		used = 0;
+		firsts.clear();
+		counts.clear();
+		runs.clear();
+	}
+	void StrokeStore::rewind(size_t strip, size_t vertex){
+		if(strip >= firsts.size()){
+			return;
+		}
+		/* Strips lie in the buffer in their order(with holes left by apply()), the dropped part is its end */
+		size_t kept = std::min((size_t)counts[strip], vertex);
+		size_t strip_count = kept > 0 ? strip + 1 : strip;
+		used = (size_t)firsts[strip] + kept;
+		firsts.resize(strip_count);
+		counts.resize(strip_count);
+		if(kept > 0){
+			counts[strip] = (GLsizei)kept;
+		}
+		while(!runs.empty() && runs.back().first_strip >= strip_count){
+			runs.pop_back();
+		}
+		if(!runs.empty()){
+			runs.back().strip_count = strip_count - runs.back().first_strip;
+		}
+		endLastStrip();
+	}
+	template<typename Strips>
+	void StrokeStore::rebuildRuns(const Strips& strips){
+		runs.clear();
+		for(size_t strip = 0; strip < firsts.size(); ++strip){
+			if(runs.empty()){
+				runs.push_back({strip, 0, 1.0f, 1.0f, 1.0f});
+			}
+			++runs.back().strip_count;
+			if(counts[strip] > 0){
+				setStripColor(strip, strips[strip].data() + 3);
+			}
+		}
+	}
+	template<typename Strips>
+	void StrokeStore::apply(const Strips& strips, const Geometry::StrokeChanges& changes){
+		if(firsts.empty() || changes.empty()){
+			return;
+		}
+		/* Places of the strips after the change, the ones to upload are placed below */
+		std::vector<GLint> next_firsts;
+		std::vector<GLsizei> next_counts;
+		std::vector<char> upload;
+		auto add = [&](GLint first, GLsizei count, bool changed){
+			next_firsts.push_back(first);
+			next_counts.push_back(changed ? 0 : count);
+			upload.push_back(changed);
+		};
+		changes.walk(firsts.size(), [&](size_t before){
+			clearStyles(firsts[before], firsts[before] + counts[before]);
+		}, [&](size_t){
+			add(0, 0, true);
+		}, [&](size_t before, size_t, bool changed){
+			if(changed){
+				clearStyles(firsts[before], firsts[before] + counts[before]);
+			}
+			add(firsts[before], counts[before], changed);
+		});
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		size_t strip = 0, end = 0;
+		while(strip < upload.size()){
+			if(!upload[strip]){
+				end = (size_t)next_firsts[strip] + next_counts[strip];
+				++strip;
+				continue;
+			}
+			/* Consecutive strips to upload share the room up to the next kept strip, the last ones can grow the buffer */
+			size_t group_end = strip, vertices = 0;
+			for(; group_end < upload.size() && upload[group_end]; ++group_end){
+				vertices += strips[group_end].size() / 6;
+			}
+			if(group_end < upload.size() && end + vertices > (size_t)next_firsts[group_end]){
+				break;
+			}
+			reserve(end + vertices);
+			for(; strip < group_end; ++strip){
+				const auto& data = strips[strip];
+				size_t count = data.size() / 6;
+				next_firsts[strip] = (GLint)end;
+				next_counts[strip] = (GLsizei)count;
+				if(count > 0){
+					staging.resize(count * 3);
+					Geometry::packPositions(data.data(), count, staging.data());
+					glBufferSubData(GL_ARRAY_BUFFER, end * VERTEX_SIZE, count * VERTEX_SIZE, staging.data());
+					uploadStyles(end, end + count, end + count, (float)data[3], (float)data[4], (float)data[5]);
+				}
+				end += count;
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		/* From a group that did not fit on, the strips are uploaded again by the next sync() */
+		next_firsts.resize(strip);
+		next_counts.resize(strip);
+		firsts.swap(next_firsts);
+		counts.swap(next_counts);
+		used = firsts.empty() ? 0 : (size_t)firsts.back() + counts.back();
+		rebuildRuns(strips);
+
+		size_t live = 0;
+		for(GLsizei count : counts){
+			live += (size_t)count;
+		}
+		if((used - live) * COMPACT_HOLES_DIVISOR > used){
+			compact();
+		}
+	}
+	template void StrokeStore::apply(const std::vector<std::vector<double>>& strips, const Geometry::StrokeChanges& changes);
+	template void StrokeStore::apply(const Geometry::StrokeArena& strips, const Geometry::StrokeChanges& changes);
+
+	void StrokeStore::endLastStrip(){
+		if(counts.empty() || counts.back() == 0){
+			return;
+		}
+		const ColorRun& run = runs.back();
+		uploadStyles(used - 1, used, used, run.r, run.g, run.b);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	void StrokeStore::draw(GLenum mode) const{
+		if(firsts.empty()){
+			return;
+		}
+		glBindVertexArray(VAO);
+		for(const ColorRun& run : runs){
+			glVertexAttrib3f(1, run.r, run.g, run.b);
+			glMultiDrawArrays(mode, firsts.data() + run.first_strip, counts.data() + run.first_strip, (GLsizei)run.strip_count);
+		}
+	}
+	void StrokeStore::drawRanges(GLenum mode, std::vector<Geometry::StripRange>& ranges){
+		if(firsts.empty() || ranges.empty()){
+			return;
+		}
+		std::sort(ranges.begin(), ranges.end(), [](const Geometry::StripRange& a, const Geometry::StripRange& b){
+			return a.strip != b.strip ? a.strip < b.strip : a.first < b.first;
+		});
+
+		glBindVertexArray(VAO);
+		size_t range = 0;
+		for(const ColorRun& run : runs){
+			size_t end_strip = run.first_strip + run.strip_count;
+			range_firsts.clear();
+			range_counts.clear();
+			for(; range < ranges.size() && ranges[range].strip < end_strip; ++range){
+				const Geometry::StripRange& r = ranges[range];
+				if(r.strip < run.first_strip || r.first >= (size_t)counts[r.strip]){
+					continue;
+				}
+				range_firsts.push_back(firsts[r.strip] + (GLint)r.first);
+				range_counts.push_back((GLsizei)std::min((size_t)r.count, (size_t)counts[r.strip] - r.first));
+			}
+			if(!range_firsts.empty()){
+				glVertexAttrib3f(1, run.r, run.g, run.b);
+				glMultiDrawArrays(mode, range_firsts.data(), range_counts.data(), (GLsizei)range_firsts.size());
+			}
+		}
+	}
+	void StrokeStore::drawLines(bool splitSeam) const{
+		if(used < 2){
+			return;
+		}
+		/* The last vertex starts no segment, segments across strip ends are dropped by the shader */
+		glBindVertexArray(line_VAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, splitSeam ? 12 : 6, (GLsizei)(used - 1));
+	}
+	void StrokeStore::drawLineRanges(std::vector<Geometry::StripRange>& ranges){
+		if(used < 2 || ranges.empty()){
+			return;
+		}
+
+		/* Blocks of LINE_RANGE_GAP segments that hold a visible one, marked in any order instead of sorting the ranges */
+		visible_blocks.assign((used + LINE_RANGE_GAP - 1) / LINE_RANGE_GAP, 0);
+		for(const Geometry::StripRange& r : ranges){
+			if(r.strip >= firsts.size() || r.first + 1 >= (size_t)counts[r.strip]){
+				continue;
+			}
+			size_t first = firsts[r.strip] + r.first;
+			size_t end = firsts[r.strip] + std::min((size_t)r.first + r.count, (size_t)counts[r.strip]) - 1;
+			std::fill(visible_blocks.begin() + first / LINE_RANGE_GAP, visible_blocks.begin() + (end - 1) / LINE_RANGE_GAP + 1, 1);
+		}
+
+		/* Runs of marked blocks become one instanced draw each, segments of the blocks not visible themselves are cheap */
+		line_commands.clear();
+		for(size_t block = 0; block < visible_blocks.size(); ++block){
+			if(!visible_blocks[block]){
+				continue;
+			}
+			size_t first = block * LINE_RANGE_GAP;
+			while(block + 1 < visible_blocks.size() && visible_blocks[block + 1]){
+				++block;
+			}
+			size_t end = std::min((block + 1) * LINE_RANGE_GAP, used - 1);
+			if(end > first){
+				line_commands.push_back({6, (GLuint)(end - first), 0, (GLuint)first});
+			}
+		}
+		if(line_commands.empty()){
+			return;
+		}
+
+		glBindVertexArray(line_VAO);
+		if(!GLAD_GL_VERSION_4_3){
+			for(const DrawCommand& command : line_commands){
+				glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, command.count, command.instance_count, command.base_instance);
+			}
+			return;
+		}
+
+		/* All runs in one call, the commands are streamed into a buffer that is orphaned every frame */
+		if(!indirect_buffer){
+			glGenBuffers(1, &indirect_buffer);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+		indirect_capacity = std::max(indirect_capacity, line_commands.size());
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, indirect_capacity * sizeof(DrawCommand), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, line_commands.size() * sizeof(DrawCommand), line_commands.data());
+		glMultiDrawArraysIndirect(GL_TRIANGLES, (void*)0, (GLsizei)line_commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	template<typename Strips>
+	bool StrokeStore::appendStrips(const Strips& strips, size_t mutableTail){
+		if(strips.size() < firsts.size()){
+			return false;
+		}
+
+		/* Only the last synced strip may have grown, all strips before it are finished */
+		size_t strip_num = firsts.empty() ? 0 : firsts.size() - 1;
+
+		/* Its mutable tail is dropped from the buffer and uploaded again with the new vertices */
+		bool shortened = false;
+		if(!firsts.empty() && firsts[strip_num] + (size_t)counts[strip_num] == used){
+			size_t rewind = std::min(mutableTail, (size_t)counts[strip_num]);
+			rewind = std::min(rewind, strips[strip_num].size() / 6);
+			counts[strip_num] -= (GLsizei)rewind;
+			used -= rewind;
+			shortened = rewind > 0;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		for(; strip_num < strips.size(); ++strip_num){
+			const auto& strip = strips[strip_num];
+			size_t vertices = strip.size() / 6;
+
+			if(strip_num == firsts.size()){
+				firsts.push_back((GLint)used);
+				counts.push_back(0);
+				if(runs.empty()){
+					runs.push_back({strip_num, 0, 1.0f, 1.0f, 1.0f});
+				}
+				++runs.back().strip_count;
+			}
+			size_t uploaded = (size_t)counts[strip_num];
+			if(vertices < uploaded || (vertices > uploaded && firsts[strip_num] + uploaded != used)){
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+				return false;
+			}
+			if(vertices == uploaded){
+				/* A strip that lost its tail for good ends earlier now */
+				if(shortened && strip_num + 1 == firsts.size()){
+					endLastStrip();
+					glBindBuffer(GL_ARRAY_BUFFER, VBO);
+				}
+				continue;
+			}
+
+			if(uploaded == 0){
+				setStripColor(strip_num, strip.data() + 3);
+			}
+
+			size_t added = vertices - uploaded;
+			staging.resize(added * 3);
+			Geometry::packPositions(strip.data() + uploaded * 6, added, staging.data());
+
+			reserve(used + added);
+			glBufferSubData(GL_ARRAY_BUFFER, used * VERTEX_SIZE, added * VERTEX_SIZE, staging.data());
+
+			/* The previous last vertex of the strip starts a segment now */
+			size_t style_first = uploaded > 0 ? used - 1 : used;
+			used += added;
+			counts[strip_num] = (GLsizei)vertices;
+			uploadStyles(style_first, used, used, (float)strip[3], (float)strip[4], (float)strip[5]);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return true;
+	}
+	template void StrokeStore::sync(const std::vector<std::vector<double>>& strips, size_t mutableTail);
+	template void StrokeStore::sync(const Geometry::StrokeArena& strips, size_t mutableTail);
+
+	void StrokeStore::appendVertices(const float* x, const float* y, const float* z, size_t count, float r, float g, float b, bool newStrip){
+		/* Only the last strip can grow, and only if it ends the buffer */
+		if(!newStrip && (firsts.empty() || firsts.back() + (size_t)counts.back() != used)){
+			newStrip = true;
+		}
+		if(newStrip){
+			firsts.push_back((GLint)used);
+			counts.push_back(0);
+			if(runs.empty()){
+				runs.push_back({firsts.size() - 1, 0, 1.0f, 1.0f, 1.0f});
+			}
+			++runs.back().strip_count;
+			const double color[3] = {r, g, b};
+			setStripColor(firsts.size() - 1, color);
+		}
+		if(count == 0){
+			return;
+		}
+
+		staging.resize(count * 3);
+		for(size_t v = 0; v < count; ++v){
+			staging[v * 3] = x[v];
+			staging[v * 3 + 1] = y[v];
+			staging[v * 3 + 2] = z[v];
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		reserve(used + count);
+		glBufferSubData(GL_ARRAY_BUFFER, used * VERTEX_SIZE, count * VERTEX_SIZE, staging.data());
+		size_t style_first = counts.back() > 0 ? used - 1 : used;
+		used += count;
+		counts.back() += (GLsizei)count;
+		uploadStyles(style_first, used, used, r, g, b);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	void StrokeStore::clearStyles(size_t first, size_t end){
+		if(end <= first){
+			return;
+		}
+		style_staging.assign((end - first) * STYLE_SIZE, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, style_VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, first * STYLE_SIZE, style_staging.size(), style_staging.data());
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	}
+	void StrokeStore::uploadStyles(size_t first, size_t end, size_t strip_end, float r, float g, float b){
+		unsigned char color[3] = {(unsigned char)(std::clamp(r, 0.0f, 1.0f) * 255.0f + 0.5f),
+		                          (unsigned char)(std::clamp(g, 0.0f, 1.0f) * 255.0f + 0.5f),
+		                          (unsigned char)(std::clamp(b, 0.0f, 1.0f) * 255.0f + 0.5f)};
+		style_staging.resize((end - first) * STYLE_SIZE);
+		for(size_t vertex = first; vertex < end; ++vertex){
+			unsigned char* style = style_staging.data() + (vertex - first) * STYLE_SIZE;
+			style[0] = color[0];
+			style[1] = color[1];
+			style[2] = color[2];
+			style[3] = vertex + 1 < strip_end ? 255 : 0;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, style_VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, first * STYLE_SIZE, style_staging.size(), style_staging.data());
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	}
+	void StrokeStore::setStripColor(size_t strip_num, const double* color){
+		/* Called once per strip, when its first vertices arrive. The strip is always the last one of the last run */
+		float r = (float)color[0], g = (float)color[1], b = (float)color[2];
+		ColorRun& run = runs.back();
+		if(run.r == r && run.g == g && run.b == b){
+			return;
+		}
+		if(run.strip_count == 1){
+			run.r = r;
+			run.g = g;
+			run.b = b;
+			if(runs.size() > 1){
+				/* Merge back with the previous run if it has the same color */
+				ColorRun& previous = runs[runs.size() - 2];
+				if(previous.r == r && previous.g == g && previous.b == b){
+					++previous.strip_count;
+					runs.pop_back();
+				}
+			}
+			return;
+		}
+		--run.strip_count;
+		runs.push_back({strip_num, 1, r, g, b});
+	}
+	void StrokeStore::reserve(size_t vertexCount){
+		if(vertexCount <= capacity){
+			return;
+		}
+		size_t new_capacity = capacity;
+		while(new_capacity < vertexCount){
+			new_capacity *= 2;
+		}
+
+		/* Grow on the GPU side: the already uploaded vertices are copied buffer to buffer, not sent again */
+		replaceBuffers(new_capacity, {{0, 0, used}});
+	}
+	void StrokeStore::compact(){
+		/* Consecutive strips with nothing between them are moved with one copy */
+		std::vector<BufferCopy> copies;
+		size_t end = 0;
+		for(size_t strip = 0; strip < firsts.size(); ++strip){
+			size_t first = (size_t)firsts[strip], count = (size_t)counts[strip];
+			if(!copies.empty() && copies.back().source + copies.back().count == first){
+				copies.back().count += count;
+			}
+			else if(count > 0){
+				copies.push_back({first, end, count});
+			}
+			firsts[strip] = (GLint)end;
+			end += count;
+		}
+		replaceBuffers(capacity, copies);
+		used = end;
+	}
+	void StrokeStore::replaceBuffers(size_t newCapacity, const std::vector<BufferCopy>& copies){
+		/* Into new buffers, so the copies can not overlap the ranges they read */
+		auto replace = [&](GLuint& buffer, size_t elementSize){
+			GLuint new_buffer;
+			glGenBuffers(1, &new_buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, nullptr, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			for(const BufferCopy& copy : copies){
+				if(copy.count > 0){
+					glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copy.source * elementSize, copy.target * elementSize, copy.count * elementSize);
+				}
+			}
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &buffer);
+			buffer = new_buffer;
+		};
+		replace(VBO, VERTEX_SIZE);
+		replace(style_VBO, STYLE_SIZE);
+		capacity = newCapacity;
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		setAttributes();
+		glBindVertexArray(line_VAO);
+		setLineAttributes();
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	}
+	void StrokeStore::setAttributes(){
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (void*)0);
+	}
+	void StrokeStore::setLineAttributes(){
+		/* Segment start and end: the same positions, the end one vertex further */
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (void*)0);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (void*)VERTEX_SIZE);
+		glBindBuffer(GL_ARRAY_BUFFER, style_VBO);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, STYLE_SIZE, (void*)0);
+	}
+}
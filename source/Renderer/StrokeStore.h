@@ -0,0 +1,150 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "../Geometry/SphereIndex.h"
+
+namespace Renderer{
+	/*
+		GPU copy of the drawn strips. All strips live one after another in a single growable vertex buffer,
+		sync() uploads only the vertices appended since the previous call(glBufferSubData of the new range),
+		and draw() renders every strip with one glMultiDrawArrays call.
+
+		Vertices are stored as three floats(12 bytes instead of the 48 bytes of the CPU side XYZRGB doubles),
+		the color is kept once per strip and fed as a constant value of attribute 1, so consecutive strips of
+		the same color share a single multi-draw.
+
+		drawLines() renders thick anti-aliased lines instead(resources/shaders/LineShader.vs/.fs): one instance
+		per segment reads the same vertex buffer twice, one vertex apart, and a second buffer keeps 4 bytes per
+		vertex with the strip color and whether a segment starts there, so every stroke goes in one instanced call.
+	*/
+	class StrokeStore{
+	public:
+		StrokeStore(size_t initialVertexCapacity = 1 << 16);
+		~StrokeStore();
+
+		StrokeStore(const StrokeStore&) = delete;
+		StrokeStore& operator=(const StrokeStore&) = delete;
+
+		/*
+			Uploads new strips and new vertices of the last strips. Strips are expected to only grow at the end,
+			anything else(a strip got shorter, an older strip changed) makes the whole drawing upload again.
+			The last mutableTail vertices of the last synced strip may have been changed in place(a simplified
+			stroke moves its last vertex), they are uploaded again. Strips is std::vector<std::vector<double>> or
+			Geometry::StrokeArena.
+		*/
+		template<typename Strips>
+		void sync(const Strips& strips, size_t mutableTail = 0);
+
+		/*
+			Uploads float positions straight from separate x, y, z arrays(a mapped session log e.g.), as a new strip
+			or as more vertices of the last one. A later sync() sees strips of the same sizes as uploaded already.
+		*/
+		void appendVertices(const float* x, const float* y, const float* z, size_t count, float r, float g, float b, bool newStrip);
+
+		/* Forgets the uploaded strips, the next sync() uploads everything again(use when the drawing is replaced) */
+		void reset();
+
+		/*
+			Forgets the strips after strip and the vertices of strip from vertex on(the whole strip for 0), the next
+			sync() uploads them again. For strips changed in place further back than a mutable tail(seam pieces of
+			an unfolded drawing)
+		*/
+		void rewind(size_t strip, size_t vertex);
+
+		/*
+			Follows strips changed in the middle(erased) without uploading the others: removed strips leave a hole
+			in the buffer, changed and inserted ones are uploaded into the room up to the next kept strip, or from
+			there on if they do not fit. Once the holes are a quarter of the used vertices the strips are moved
+			together on the GPU. Strips are the strips after the change, the ones not synced yet are left to the
+			next sync().
+		*/
+		template<typename Strips>
+		void apply(const Strips& strips, const Geometry::StrokeChanges& changes);
+
+		void draw(GLenum mode) const;
+
+		/*
+			Draws only the given vertex ranges of the synced strips(the visible ones found by a SphereIndex), one
+			multi-draw per color run. The ranges are sorted in place, parts not uploaded yet are skipped.
+		*/
+		void drawRanges(GLenum mode, std::vector<Geometry::StripRange>& ranges);
+
+		/*
+			Draws every segment as a screen space quad with the line program bound. splitSeam draws two quads per
+			segment, for the unfolded modes of the shader that cut segments crossing the seam.
+		*/
+		void drawLines(bool splitSeam = false) const;
+
+		/*
+			drawLines() of the given vertex ranges only, in any order. Ranges close to each other are drawn as one,
+			all of them with a single indirect multi-draw where GL 4.3 is there, one call per merged range otherwise
+		*/
+		void drawLineRanges(std::vector<Geometry::StripRange>& ranges);
+
+		size_t getVertexCount() const { return used; }
+
+	private:
+		GLuint VAO = 0, VBO = 0;
+		/* Instanced segment attributes over VBO and the per vertex style buffer */
+		GLuint line_VAO = 0, style_VBO = 0;
+		size_t capacity, used = 0;
+
+		/* Start vertex and vertex count of every synced strip, passed straight to glMultiDrawArrays */
+		std::vector<GLint> firsts;
+		std::vector<GLsizei> counts;
+
+		/* Consecutive strips drawn with the same color */
+		struct ColorRun{
+			size_t first_strip, strip_count;
+			float r, g, b;
+		};
+		std::vector<ColorRun> runs;
+
+		/* Reused buffers for the double -> float conversion of uploaded vertices and for their styles */
+		std::vector<float> staging;
+		std::vector<unsigned char> style_staging;
+
+		/* Reused draw arguments of drawRanges() */
+		std::vector<GLint> range_firsts;
+		std::vector<GLsizei> range_counts;
+
+		/* Layout of glMultiDrawArraysIndirect commands */
+		struct DrawCommand{
+			GLuint count, instance_count, first, base_instance;
+		};
+		/* Reused draw arguments of drawLineRanges(): the marked segment blocks and the commands made of them */
+		std::vector<unsigned char> visible_blocks;
+		std::vector<DrawCommand> line_commands;
+		GLuint indirect_buffer = 0;
+		size_t indirect_capacity = 0;
+
+		template<typename Strips>
+		bool appendStrips(const Strips& strips, size_t mutableTail);
+		void setStripColor(size_t strip_num, const double* color);
+		/* Clears the segment start of the last uploaded vertex of the last strip, once the vertices after it were dropped */
+		void endLastStrip();
+		/* No segment starts at the vertices [first, end) any more(a hole left by a removed or moved strip) */
+		void clearStyles(size_t first, size_t end);
+		/* Color runs of the synced strips from their first vertices */
+		template<typename Strips>
+		void rebuildRuns(const Strips& strips);
+		/* Styles of the vertices [first, end) of the strip ending at strip_end(all in buffer positions) */
+		void uploadStyles(size_t first, size_t end, size_t strip_end, float r, float g, float b);
+		void reserve(size_t vertexCount);
+
+		/* Vertices moved from source to target when the buffers are replaced */
+		struct BufferCopy{
+			size_t source, target, count;
+		};
+		/* Moves the strips next to each other, without the holes between them */
+		void compact();
+		/* New vertex and style buffers of newCapacity vertices, holding the given ranges of the old ones */
+		void replaceBuffers(size_t newCapacity, const std::vector<BufferCopy>& copies);
+		void setAttributes();
+		void setLineAttributes();
+	};
+}
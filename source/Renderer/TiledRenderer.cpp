@@ -0,0 +1,230 @@
+#include "TiledRenderer.h"
+#include "OffscreenTarget.h"
+#include "../Export/PngStream.h"
+#include "../Utils/Profiler.h"
+#include "../Utils/ThreadPool.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace Renderer{
+	/* The PNG of one tiled render, the bands wait here in order until an encoder task takes the next one */
+	struct TiledPng{
+		Export::PngStreamWriter png;
+		std::string file_path;
+		int stride = 0;
+		bool ok = true;
+
+		struct Band{
+			std::vector<unsigned char> rows;
+			int count = 0;
+			bool last = false;
+		};
+		std::mutex bands_mutex;
+		std::deque<Band> bands;
+
+		/* Held while a band is written, tasks running on several workers still write the bands in order */
+		std::mutex write_mutex;
+
+		void writeNext(){
+			PROFILE_SCOPE("encodeTiles");
+			std::lock_guard<std::mutex> write_lock(write_mutex);
+			Band band;
+			{
+				std::lock_guard<std::mutex> lock(bands_mutex);
+				band = std::move(bands.front());
+				bands.pop_front();
+			}
+			ok = ok && png.writeRows(band.rows.data(), band.count, stride);
+			if(band.last && !(png.close() && ok)){
+				std::cout << "Failed to save " << file_path << "\n";
+			}
+		}
+	};
+
+	TiledRenderer::TiledRenderer(Utils::ThreadPool& encoders, size_t slotCount) : encoders(encoders), slots(slotCount > 0 ? slotCount : 1){
+		for(Slot& slot : slots){
+			glGenBuffers(1, &slot.PBO);
+		}
+	}
+	TiledRenderer::~TiledRenderer(){
+		flush();
+		for(Slot& slot : slots){
+			if(slot.fence){
+				glDeleteSync(slot.fence);
+			}
+			glDeleteBuffers(1, &slot.PBO);
+		}
+	}
+	bool TiledRenderer::start(int width, int height, const OrthoFrustum& frustum, const std::string& filePath){
+		if(output || width <= 0 || height <= 0){
+			return false;
+		}
+
+		auto png = std::make_shared<TiledPng>();
+		if(!png->png.open(filePath, width, height, 3)){
+			return false;
+		}
+		png->file_path = filePath;
+		png->stride = width * 3;
+
+		output = png;
+		this->width = width;
+		this->height = height;
+		this->frustum = frustum;
+		rows_drawn = next_band = next_queued = 0;
+		return true;
+	}
+	bool TiledRenderer::isRendering() const{
+		return output && rows_drawn < height;
+	}
+	void TiledRenderer::renderBand(OffscreenTarget& tile, const std::function<void(const glm::mat4& projection)>& drawScene){
+		if(!isRendering() || !tile.isComplete()){
+			return;
+		}
+		Slot* slot = nullptr;
+		for(Slot& candidate : slots){
+			if(candidate.state == SlotState::Free){
+				slot = &candidate;
+				break;
+			}
+		}
+		if(!slot){
+			return;
+		}
+
+		int tile_width = tile.getWidth(), tile_height = tile.getHeight();
+		size_t stride = (size_t)width * 3;
+		float units_x = (frustum.right - frustum.left) / width, units_y = (frustum.top - frustum.bottom) / height;
+
+		/* Bands go from the top of the image down, in the order PNG stores rows */
+		int band_top = rows_drawn, rows = std::min(tile_height, height - band_top);
+		float top = frustum.top - band_top * units_y, bottom = frustum.top - (band_top + rows) * units_y;
+
+		size_t size = stride * rows;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->PBO);
+		if(size > slot->capacity){
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+			slot->capacity = size;
+		}
+
+		/* Every tile is read into its columns of the band, with the rows of the whole image */
+		tile.bind();
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glPixelStorei(GL_PACK_ROW_LENGTH, width);
+		for(int tile_left = 0; tile_left < width; tile_left += tile_width){
+			int columns = std::min(tile_width, width - tile_left);
+			float left = frustum.left + tile_left * units_x, right = frustum.left + (tile_left + columns) * units_x;
+
+			/* Border tiles are smaller, only part of the target is used for them */
+			glViewport(0, 0, columns, rows);
+			drawScene(glm::ortho(left, right, bottom, top, frustum.zNear, frustum.zFar));
+			glReadPixels(0, 0, columns, rows, GL_RGB, GL_UNSIGNED_BYTE, (void*)((size_t)tile_left * 3));
+		}
+		glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		tile.unbind();
+
+		slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot->state = SlotState::Reading;
+		slot->band = next_band++;
+		slot->rows = rows;
+		rows_drawn += rows;
+	}
+	void TiledRenderer::poll(){
+		for(Slot& slot : slots){
+			process(slot, 0);
+		}
+
+		/* Readbacks may finish in any order, the bands go to the encoders in the order of the file */
+		bool queued = true;
+		while(output && queued){
+			queued = false;
+			for(Slot& slot : slots){
+				if(slot.state != SlotState::Ready || slot.band != next_queued){
+					continue;
+				}
+
+				/* The band moves to the encoder only if the queue accepts the task, otherwise try next frame */
+				TiledPng::Band band;
+				band.rows.swap(slot.pixels);
+				band.count = slot.rows;
+				band.last = next_queued + 1 == next_band && rows_drawn >= height;
+				{
+					std::lock_guard<std::mutex> lock(output->bands_mutex);
+					output->bands.push_back(std::move(band));
+				}
+				if(!encoders.trySubmit([png = output](){ png->writeNext(); })){
+					/* No task takes the band, the earlier ones only pop the bands in front of it */
+					std::lock_guard<std::mutex> lock(output->bands_mutex);
+					slot.pixels.swap(output->bands.back().rows);
+					output->bands.pop_back();
+					break;
+				}
+
+				slot.state = SlotState::Free;
+				queued = true;
+				if(++next_queued == next_band && rows_drawn >= height){
+					output.reset();
+				}
+				break;
+			}
+		}
+	}
+	void TiledRenderer::flush(){
+		while(output && !isRendering()){
+			for(Slot& slot : slots){
+				process(slot, GL_TIMEOUT_IGNORED);
+			}
+			poll();
+			if(output){
+				/* The encoder queue is full, give the workers some time */
+				std::this_thread::yield();
+			}
+		}
+
+		/* The window was closed in the middle of the render, the writer removes the file with the last band task */
+		if(output){
+			std::cout << "Failed to save " << output->file_path << "\n";
+			output.reset();
+		}
+	}
+	size_t TiledRenderer::getPendingCount() const{
+		size_t pending = 0;
+		for(const Slot& slot : slots){
+			pending += slot.state != SlotState::Free;
+		}
+		return pending;
+	}
+	void TiledRenderer::process(Slot& slot, GLuint64 timeout){
+		if(slot.state != SlotState::Reading){
+			return;
+		}
+		GLenum status = glClientWaitSync(slot.fence, timeout == 0 ? 0 : GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED){
+			return;
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		/* GL rows go bottom-up */
+		size_t stride = (size_t)width * 3;
+		slot.pixels.resize(stride * slot.rows);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		const unsigned char* mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, stride * slot.rows, GL_MAP_READ_BIT);
+		if(mapped){
+			for(int row = 0; row < slot.rows; ++row){
+				std::memcpy(slot.pixels.data() + row * stride, mapped + (size_t)(slot.rows - 1 - row) * stride, stride);
+			}
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.state = SlotState::Ready;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Utils{
+	class ThreadPool;
+}
+
+namespace Renderer{
+	class OffscreenTarget;
+
+	struct OrthoFrustum{
+		float left, right, bottom, top, zNear, zFar;
+	};
+
+	struct TiledPng;
+
+	/*
+		Renders an orthographic view of any size by cutting the frustum into tiles the size of the offscreen target.
+		One row of tiles(a band) is drawn per frame and read into a pixel buffer object behind a fence, like the
+		ImageExporter does with whole images. poll() hands finished bands to the encoder pool in order, whose tasks
+		compress them into the PNG one after the other, a band the full queue does not take stays in its slot until
+		a later frame. The render thread never waits for the GPU or the encoders, and memory use is bounded by the
+		readback slots and the pool's queue, not the size of the image.
+	*/
+	class TiledRenderer{
+	public:
+		TiledRenderer(Utils::ThreadPool& encoders, size_t slotCount = 2);
+		~TiledRenderer();
+
+		TiledRenderer(const TiledRenderer&) = delete;
+		TiledRenderer& operator=(const TiledRenderer&) = delete;
+
+		/* False while the bands of the previous render are drawn or wait for the encoders */
+		bool canStart() const { return !output; }
+
+		/* Starts a render, false if canStart() is false or the file could not be started */
+		bool start(int width, int height, const OrthoFrustum& frustum, const std::string& filePath);
+
+		/* True until the last band is drawn, the scene must not change until then */
+		bool isRendering() const;
+
+		/*
+			Draws the next band into a free readback slot, does nothing while every slot is busy. drawScene gets
+			the projection of the current tile and has to clear and draw everything itself. The tile's size must
+			not change while a render is drawn
+		*/
+		void renderBand(OffscreenTarget& tile, const std::function<void(const glm::mat4& projection)>& drawScene);
+
+		/* Non-blocking, call once per frame */
+		void poll();
+
+		/* Blocks until every band drawn is handed to the encoders(for shutdown), a render not drawn to the end is dropped */
+		void flush();
+
+		/* Bands drawn but not handed to the encoders yet */
+		size_t getPendingCount() const;
+
+	private:
+		enum class SlotState{
+			Free,
+			Reading,
+			Ready
+		};
+
+		struct Slot{
+			GLuint PBO = 0;
+			GLsync fence = nullptr;
+			SlotState state = SlotState::Free;
+			int band = 0, rows = 0;
+			size_t capacity = 0;
+			std::vector<unsigned char> pixels;
+		};
+
+		Utils::ThreadPool& encoders;
+		std::vector<Slot> slots;
+
+		std::shared_ptr<TiledPng> output;
+		int width = 0, height = 0;
+		OrthoFrustum frustum = {};
+		/* Rows drawn so far, the next band to draw and the next band to hand to the encoders */
+		int rows_drawn = 0, next_band = 0, next_queued = 0;
+
+		void process(Slot& slot, GLuint64 timeout);
+	};
+}
@@ -1,48 +1,209 @@
 #include "ResourceManager.h"
 #include "../Renderer/ShaderProgram.h"
+#include "../Utils/ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+
+#if defined(_WIN32)
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+/* Magic of a cached program binary, followed by the GL binary format(uint32) and binary size(uint64) */
+static const char SHADER_CACHE_MAGIC[4] = {'S', 'P', 'B', '1'};
+
+/* FNV-1a, only has to tell different sources and drivers apart */
+static uint64_t hashString(std::string_view text, uint64_t hash = 14695981039346656037ull){
+    for(unsigned char c : text){
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    /* Separator, so that ("ab", "c") and ("a", "bc") differ */
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+/* Suffix of a temporary file no other writer uses: the process id and a counter within the process */
+static std::string uniqueSuffix(){
+    static std::atomic<uint32_t> next_file{0};
+#if defined(_WIN32)
+    long process = (long)_getpid();
+#else
+    long process = (long)getpid();
+#endif
+    return "." + std::to_string(process) + "." + std::to_string(next_file.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+}
+
+static std::string glString(GLenum name){
+    const GLubyte* value = glGetString(name);
+    return value ? std::string(reinterpret_cast<const char*>(value)) : std::string{};
+}
 
 ResourceManager::ResourceManager(const std::string& executablePath){
     size_t found = executablePath.find_last_of("/\\");
     e_path = executablePath.substr(0, found);
 }
 
-std::string ResourceManager::getFileCode(const std::string& relFilePath) const{
-    std::ifstream file;
-    file.open(e_path + "/" + relFilePath.c_str(), std::ios::in | std::ios::binary);
-    if(!file.is_open()){
+ResourceManager::~ResourceManager(){
+    /* Workers still reference this manager */
+    std::unique_lock<std::mutex> lock(loads_mutex);
+    load_ready.wait(lock, [this]{ return loads_in_flight == 0; });
+}
+
+std::shared_ptr<const Utils::MappedFile> ResourceManager::mapAbsoluteFile(const std::string& filePath) const{
+    auto file = std::make_shared<Utils::MappedFile>(filePath);
+    return file->isOpen() ? std::shared_ptr<const Utils::MappedFile>(std::move(file)) : nullptr;
+}
+
+std::shared_ptr<const Utils::MappedFile> ResourceManager::mapFile(const std::string& relFilePath) const{
+    auto file = mapAbsoluteFile(e_path + "/" + relFilePath);
+    if(!file){
         std::cerr << "Failed to open file: " << relFilePath << "\n";
-        return std::string{};
     }
+    return file;
+}
+
+std::future<std::shared_ptr<const Utils::MappedFile>> ResourceManager::mapFileAsync(const std::string& relFilePath, Utils::ThreadPool& pool) const{
+    /* std::function needs a copyable task */
+    auto promise = std::make_shared<std::promise<std::shared_ptr<const Utils::MappedFile>>>();
+    auto future = promise->get_future();
+    {
+        std::lock_guard<std::mutex> lock(loads_mutex);
+        loads_in_flight++;
+    }
+    pool.submit([this, relFilePath, promise]{
+        promise->set_value(mapFile(relFilePath));
+        /* Notified under the lock, the destructor can not return in between and destroy load_ready */
+        std::lock_guard<std::mutex> lock(loads_mutex);
+        loads_in_flight--;
+        load_ready.notify_all();
+    });
+    return future;
+}
+
+std::shared_ptr<Renderer::ShaderProgram> ResourceManager::loadShaderProgram(const std::string& shaderProgramName, const std::string& vertexPath, const std::string& FragmentPath,
+                                                                            const std::string& geometryPath){
+    ShaderProgramAsset asset{shaderProgramName, vertexPath, FragmentPath, geometryPath};
+    auto vertex = mapFile(vertexPath);
+    auto fragment = mapFile(FragmentPath);
+    auto geometry = geometryPath.empty() ? nullptr : mapFile(geometryPath);
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    std::string cachePath;
+    std::shared_ptr<const Utils::MappedFile> cached;
+    if(vertex && fragment){
+        cachePath = getShaderCachePath(shaderProgramName, vertex->view(), fragment->view(), geometry ? geometry->view() : std::string_view(), getDriverHash());
+        cached = cachePath.empty() ? nullptr : mapAbsoluteFile(cachePath);
+    }
+    return createShaderProgram(asset, vertex.get(), fragment.get(), geometry.get(), cached.get(), cachePath);
 }
 
-std::shared_ptr<Renderer::ShaderProgram> ResourceManager::loadShaderProgram(const std::string& shaderProgramName, const std::string& vertexPath, const std::string& FragmentPath){
-    std::string vertexCode = getFileCode(vertexPath);
-    if(vertexCode.empty()){
+std::shared_ptr<Renderer::ShaderProgram> ResourceManager::createShaderProgram(const ShaderProgramAsset& asset, const Utils::MappedFile* vertex, const Utils::MappedFile* fragment,
+                                                                              const Utils::MappedFile* geometry, const Utils::MappedFile* cached, const std::string& cachePath){
+    if(!vertex || vertex->getSize() == 0){
         std::cerr << "No vertex shader code!" << "\n";
         return nullptr;
     }
-
-    std::string fragmentCode = getFileCode(FragmentPath);
-    if(fragmentCode.empty()){
+    if(!fragment || fragment->getSize() == 0){
         std::cerr << "No fragment shader code!" << "\n";
         return nullptr;
     }
+    if(!asset.geometryPath.empty() && (!geometry || geometry->getSize() == 0)){
+        std::cerr << "No geometry shader code!" << "\n";
+        return nullptr;
+    }
 
-    shader_programs.emplace(shaderProgramName, std::make_shared<Renderer::ShaderProgram>(vertexCode, fragmentCode));
-    std::shared_ptr<Renderer::ShaderProgram> newShader = shader_programs.at(shaderProgramName);
+    /* Linking from a cached binary skips compiling, a rejected or missing one falls back to the sources */
+    std::shared_ptr<Renderer::ShaderProgram> newShader = cached ? loadCachedShaderProgram(*cached, cachePath) : nullptr;
+    if(!newShader){
+        newShader = std::make_shared<Renderer::ShaderProgram>(vertex->view(), fragment->view(), geometry ? geometry->view() : std::string_view());
+        if(newShader->checkCompilationSuccess()){
+            storeCachedShaderProgram(cachePath, *newShader);
+        }
+    }
+    shader_programs.emplace(asset.name, newShader);
+    newShader = shader_programs.at(asset.name);
     
     if (newShader->checkCompilationSuccess()){
         return newShader;
     }
 
-    std::cerr << "Can not load shader program:\nVertex: " << vertexPath << "\n" << "Fragment: " << FragmentPath << "\n";
+    std::cerr << "Can not load shader program:\nVertex: " << asset.vertexPath << "\n" << "Fragment: " << asset.fragmentPath << "\n";
     return nullptr;
 }
 
+std::vector<std::future<std::shared_ptr<Renderer::ShaderProgram>>> ResourceManager::loadShaderProgramsAsync(const std::vector<ShaderProgramAsset>& manifest, Utils::ThreadPool& pool){
+    /* GL strings can only be queried on the context thread */
+    uint64_t driverHash = getDriverHash();
+
+    std::vector<std::future<std::shared_ptr<Renderer::ShaderProgram>>> futures;
+    futures.reserve(manifest.size());
+    for(const ShaderProgramAsset& asset : manifest){
+        auto pending = std::make_shared<std::unique_ptr<PendingProgram>>(new PendingProgram());
+        (*pending)->asset = asset;
+        futures.push_back((*pending)->promise.get_future());
+        {
+            std::lock_guard<std::mutex> lock(loads_mutex);
+            loads_in_flight++;
+        }
+        pool.submit([this, pending, driverHash]{
+            PendingProgram& program = **pending;
+            program.vertex = mapFile(program.asset.vertexPath);
+            program.fragment = mapFile(program.asset.fragmentPath);
+            if(!program.asset.geometryPath.empty()){
+                program.geometry = mapFile(program.asset.geometryPath);
+            }
+            if(program.vertex && program.fragment){
+                program.cachePath = getShaderCachePath(program.asset.name, program.vertex->view(), program.fragment->view(),
+                                                       program.geometry ? program.geometry->view() : std::string_view(), driverHash);
+                if(!program.cachePath.empty()){
+                    program.cached = mapAbsoluteFile(program.cachePath);
+                }
+            }
+            std::lock_guard<std::mutex> lock(loads_mutex);
+            ready_loads.push_back(std::move(*pending));
+            loads_in_flight--;
+            load_ready.notify_all();
+        });
+    }
+    return futures;
+}
+
+void ResourceManager::createPendingProgram(PendingProgram& pending){
+    pending.promise.set_value(createShaderProgram(pending.asset, pending.vertex.get(), pending.fragment.get(), pending.geometry.get(), pending.cached.get(), pending.cachePath));
+}
+
+size_t ResourceManager::processPendingLoads(){
+    std::deque<std::unique_ptr<PendingProgram>> ready;
+    {
+        std::lock_guard<std::mutex> lock(loads_mutex);
+        ready.swap(ready_loads);
+    }
+    for(auto& pending : ready){
+        createPendingProgram(*pending);
+    }
+    return ready.size();
+}
+
+void ResourceManager::finishPendingLoads(){
+    while(true){
+        processPendingLoads();
+
+        std::unique_lock<std::mutex> lock(loads_mutex);
+        if(loads_in_flight == 0 && ready_loads.empty()){
+            return;
+        }
+        load_ready.wait(lock, [this]{ return !ready_loads.empty() || loads_in_flight == 0; });
+    }
+}
+
 std::shared_ptr<Renderer::ShaderProgram> ResourceManager::getShaderProgram(const std::string& shaderProgramName){
     ShaderProgramsMap::const_iterator it = shader_programs.find(shaderProgramName);
     if(it != shader_programs.end()){
@@ -51,4 +212,88 @@ std::shared_ptr<Renderer::ShaderProgram> ResourceManager::getShaderProgram(const
     
     std::cerr << "Can not find shader program!\n";
     return nullptr;
+}
+
+uint64_t ResourceManager::getDriverHash() const{
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if(formats <= 0){
+        return 0;
+    }
+    uint64_t hash = hashString(glString(GL_VENDOR));
+    hash = hashString(glString(GL_RENDERER), hash);
+    return hashString(glString(GL_VERSION), hash);
+}
+
+std::string ResourceManager::getShaderCachePath(const std::string& shaderProgramName, std::string_view vertexCode, std::string_view fragmentCode, std::string_view geometryCode,
+                                                uint64_t driverHash) const{
+    /* No driver hash means the driver can not save binaries */
+    if(shader_cache_dir.empty() || driverHash == 0){
+        return std::string{};
+    }
+
+    uint64_t hash = hashString(vertexCode, driverHash);
+    hash = hashString(fragmentCode, hash);
+    hash = hashString(geometryCode, hash);
+
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+    return e_path + "/" + shader_cache_dir + "/" + shaderProgramName + "-" + key + ".bin";
+}
+
+std::shared_ptr<Renderer::ShaderProgram> ResourceManager::loadCachedShaderProgram(const Utils::MappedFile& cached, const std::string& cachePath) const{
+    /* Header: magic, GL binary format and binary size */
+    const size_t header = sizeof(SHADER_CACHE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t);
+    if(cached.getSize() < header || !std::equal(SHADER_CACHE_MAGIC, SHADER_CACHE_MAGIC + 4, cached.getData())){
+        return nullptr;
+    }
+    uint32_t format = 0;
+    uint64_t size = 0;
+    std::memcpy(&format, cached.getData() + 4, sizeof(format));
+    std::memcpy(&size, cached.getData() + 8, sizeof(size));
+    if(size == 0 || size != cached.getSize() - header){
+        return nullptr;
+    }
+
+    auto shaderProgram = std::make_shared<Renderer::ShaderProgram>((GLenum)format, cached.getData() + header, (GLsizei)size);
+    if(!shaderProgram->checkCompilationSuccess()){
+        std::cerr << "Cached shader program was rejected, compiling: " << cachePath << "\n";
+        return nullptr;
+    }
+    return shaderProgram;
+}
+
+void ResourceManager::storeCachedShaderProgram(const std::string& cachePath, const Renderer::ShaderProgram& shaderProgram) const{
+    GLenum format = 0;
+    std::vector<char> binary;
+    if(cachePath.empty() || !shaderProgram.getBinary(format, binary)){
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::path path(cachePath);
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    /* Written next to the target and renamed, so a concurrent or interrupted run never reads a partial file. Every
+       writer has its own temporary file, two of them storing the same program do not write into each other's */
+    std::filesystem::path tempPath = path;
+    tempPath += uniqueSuffix();
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        uint32_t format32 = format;
+        uint64_t size = binary.size();
+        file.write(SHADER_CACHE_MAGIC, sizeof(SHADER_CACHE_MAGIC));
+        file.write(reinterpret_cast<const char*>(&format32), sizeof(format32));
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        file.write(binary.data(), (std::streamsize)binary.size());
+        if(!file){
+            file.close();
+            std::filesystem::remove(tempPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, path, error);
+    if(error){
+        std::filesystem::remove(tempPath, error);
+    }
 }
\ No newline at end of file
@@ -1,32 +1,103 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <map>
+#include <vector>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
 
 #include <iostream>
 #include <sstream>
 #include <fstream>
 
+#include "../Utils/MappedFile.h"
+
 namespace Renderer{
     class ShaderProgram;
 }
 
+namespace Utils{
+    class ThreadPool;
+}
+
+/* One program of an asset manifest, paths are relative to the executable(no geometry path - no geometry stage) */
+struct ShaderProgramAsset{
+    std::string name;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string geometryPath = "";
+};
+
 class ResourceManager{
 public:
     ResourceManager(const std::string& executable_path);
-    ~ResourceManager() = default;
+    ~ResourceManager();
     ResourceManager(ResourceManager&&) = delete;
     ResourceManager& operator=(const ResourceManager&) = delete;
     ResourceManager& operator=(ResourceManager&&) = delete;
 
-    std::shared_ptr<Renderer::ShaderProgram> loadShaderProgram(const std::string& shaderProgramName, const std::string& vertexPath, const std::string& FragmentPath);
+    std::shared_ptr<Renderer::ShaderProgram> loadShaderProgram(const std::string& shaderProgramName, const std::string& vertexPath, const std::string& FragmentPath,
+                                                               const std::string& geometryPath = std::string());
     std::shared_ptr<Renderer::ShaderProgram> getShaderProgram(const std::string& shaderProgramName);
+
+    /* Directory for linked program binaries, relative to the executable("shader_cache" by default), empty disables the cache */
+    void setShaderCacheDir(const std::string& relDirPath){ shader_cache_dir = relDirPath; }
+
+    /* Memory maps a file relative to the executable, the contents are read without copies through view() */
+    std::shared_ptr<const Utils::MappedFile> mapFile(const std::string& relFilePath) const;
+    std::future<std::shared_ptr<const Utils::MappedFile>> mapFileAsync(const std::string& relFilePath, Utils::ThreadPool& pool) const;
+
+    /*
+        Loads a manifest of programs in parallel: the pool maps the sources and the cached binaries and hashes
+        them, the GL objects are created on the context thread by processPendingLoads() or finishPendingLoads(),
+        which fulfill the returned futures(nullptr for a program that failed). Call it on the context thread.
+    */
+    std::vector<std::future<std::shared_ptr<Renderer::ShaderProgram>>> loadShaderProgramsAsync(const std::vector<ShaderProgramAsset>& manifest, Utils::ThreadPool& pool);
+
+    /* Creates the programs whose files are ready without waiting, returns the number of them */
+    size_t processPendingLoads();
+    /* Creates all the programs requested so far, blocking until their files are ready */
+    void finishPendingLoads();
+
 private:
     typedef std::map<const std::string, std::shared_ptr<Renderer::ShaderProgram>> ShaderProgramsMap;
     ShaderProgramsMap shader_programs;
 
     std::string e_path;
+    std::string shader_cache_dir = "shader_cache";
+
+    /* Files of a program, read on a worker and waiting for the context thread */
+    struct PendingProgram{
+        ShaderProgramAsset asset;
+        std::shared_ptr<const Utils::MappedFile> vertex, fragment, geometry, cached;
+        std::string cachePath;
+        std::promise<std::shared_ptr<Renderer::ShaderProgram>> promise;
+    };
+    std::deque<std::unique_ptr<PendingProgram>> ready_loads;
+    /* Tasks on a pool referencing this manager(program loads and mapFileAsync()), the destructor waits for them */
+    mutable size_t loads_in_flight = 0;
+    mutable std::mutex loads_mutex;
+    mutable std::condition_variable load_ready;
+
+    std::shared_ptr<const Utils::MappedFile> mapAbsoluteFile(const std::string& filePath) const;
+
+    /*
+        Program binaries are stored per sources and driver: the file name has a hash of both shaders and of the GL
+        vendor, renderer and version strings, so edited shaders or an updated driver never pick up a stale binary
+    */
+    uint64_t getDriverHash() const;
+    std::string getShaderCachePath(const std::string& shaderProgramName, std::string_view vertexCode, std::string_view fragmentCode, std::string_view geometryCode,
+                                   uint64_t driverHash) const;
+    std::shared_ptr<Renderer::ShaderProgram> loadCachedShaderProgram(const Utils::MappedFile& cached, const std::string& cachePath) const;
+    void storeCachedShaderProgram(const std::string& cachePath, const Renderer::ShaderProgram& shaderProgram) const;
 
-    std::string getFileCode(const std::string& relFilePath) const;
-};
\ No newline at end of file
+    /* GL side of loading a program, on the context thread; cached may be nullptr */
+    std::shared_ptr<Renderer::ShaderProgram> createShaderProgram(const ShaderProgramAsset& asset, const Utils::MappedFile* vertex, const Utils::MappedFile* fragment,
+                                                                 const Utils::MappedFile* geometry, const Utils::MappedFile* cached, const std::string& cachePath);
+    void createPendingProgram(PendingProgram& pending);
+};
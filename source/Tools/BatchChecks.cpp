@@ -0,0 +1,464 @@
+#include "BatchChecks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../Geometry/SphereIndex.h"
+#include "../Geometry/SphereUnfold.h"
+#include "../Geometry/StrokeArena.h"
+#include "../Geometry/StrokeBuffer.h"
+#include "../Geometry/StrokeGenerators.h"
+#include "../Geometry/UnfoldKernel.h"
+#include "../Utils/WorkStealingPool.h"
+
+typedef std::vector<std::vector<double>> Strips;
+
+template<typename Arena>
+static Strips copyStrips(const Arena& arena){
+    Strips strips;
+    for(size_t strip = 0; strip < arena.size(); ++strip){
+        strips.emplace_back(arena[strip].begin(), arena[strip].end());
+    }
+    return strips;
+}
+
+static bool sameBuffers(const Geometry::StrokeBuffer& a, const Geometry::StrokeBuffer& b){
+    if(a.x != b.x || a.y != b.y || a.z != b.z || a.offsets != b.offsets || a.colors.size() != b.colors.size()){
+        return false;
+    }
+    for(size_t stroke = 0; stroke < a.colors.size(); ++stroke){
+        if(a.colors[stroke].r != b.colors[stroke].r || a.colors[stroke].g != b.colors[stroke].g || a.colors[stroke].b != b.colors[stroke].b){
+            return false;
+        }
+    }
+    return true;
+}
+
+int checkParallel(){
+    /* Stroke lengths around the task size of the parallel unfold, empty and single vertex strokes included */
+    const size_t lengths[] = {0, 1, 2, 5, 32767, 32768, 32769, 65536};
+    std::vector<Geometry::StrokeBuffer> drawings;
+    std::mt19937 rng(7);
+    for(int drawing = 0; drawing < 6; ++drawing){
+        Geometry::StrokeBuffer strokes;
+        int stroke_count = 1 + (int)(rng() % 8);
+        for(int stroke = 0; stroke < stroke_count; ++stroke){
+            strokes.beginStroke({(float)stroke, (float)drawing, 1.0f});
+            size_t vertices = drawing % 2 ? lengths[rng() % 8] : rng() % 40000;
+            double longitude = (rng() % 1000) / 100.0;
+            for(size_t vertex = 0; vertex < vertices; ++vertex){
+                longitude += 0.003 + (rng() % 100) / 100000.0;
+                double latitude = 0.5 * std::sin(vertex * 0.001);
+                strokes.append((float)(Geometry::S_RADIUS * std::cos(latitude) * std::cos(longitude)),
+                               (float)(Geometry::S_RADIUS * std::sin(latitude) + Geometry::camera_y_shift),
+                               (float)(Geometry::S_RADIUS * std::cos(latitude) * std::sin(longitude)));
+            }
+        }
+        drawings.push_back(std::move(strokes));
+    }
+
+    bool ok = true;
+    for(Geometry::KernelIsa isa : {Geometry::KernelIsa::Scalar, Geometry::KernelIsa::SSE41, Geometry::KernelIsa::AVX2}){
+        Geometry::setKernelIsa(isa);
+        if(Geometry::activeKernelIsa() != isa){
+            std::cout << Geometry::kernelIsaName(isa) << ": not supported\n";
+            continue;
+        }
+        for(size_t threads : {1, 4, 16}){
+            Utils::WorkStealingPool pool(threads);
+            size_t mismatches = 0;
+            for(const Geometry::StrokeBuffer& drawing : drawings){
+                Geometry::StrokeBuffer sequential = drawing, parallel = drawing;
+                Geometry::unfold(sequential);
+                Geometry::unfold(parallel, pool);
+                mismatches += sameBuffers(sequential, parallel) ? 0 : 1;
+            }
+            ok = ok && mismatches == 0;
+            std::cout << Geometry::kernelIsaName(isa) << ", " << threads << " thread(s): " << drawings.size() << " drawings, "
+                      << mismatches << " differ from the sequential unfold" << (mismatches == 0 ? "" : " FAILED") << "\n";
+        }
+    }
+    Geometry::setKernelIsa(Geometry::detectKernelIsa());
+    return ok ? 0 : 1;
+}
+
+static glm::dvec3 directionOf(const double* vertex){
+    return glm::normalize(glm::dvec3(vertex[0], vertex[1] - Geometry::camera_y_shift, vertex[2]));
+}
+
+/* Angle between the direction and the closest point of the segment, measured the way SphereIndex measures it */
+static double segmentAngle(const double* a, const double* b, const glm::dvec3& direction){
+    glm::dvec3 ua = directionOf(a), ub = directionOf(b), chord = ub - ua;
+    double length = glm::dot(chord, chord);
+    double t = length > 0.0 ? std::clamp(glm::dot(direction - ua, chord) / length, 0.0, 1.0) : 0.0;
+    return std::acos(std::clamp(glm::dot(glm::normalize(ua + t * chord), direction), -1.0, 1.0));
+}
+
+static glm::dvec3 randomDirection(std::mt19937& rng){
+    return glm::normalize(glm::dvec3(rng() % 2001 - 1000.0, rng() % 2001 - 1000.0, rng() % 2001 - 1000.0));
+}
+
+/* Segments erased within radius of the direction by a linear scan: pieces after the first become new strips in front
+   of the trailing empty one, strips with nothing left are dropped */
+static Strips eraseLinear(const Strips& strips, const glm::dvec3& direction, double radius, size_t& erased){
+    Strips kept, pieces;
+    erased = 0;
+    for(size_t strip = 0; strip + 1 < strips.size(); ++strip){
+        const std::vector<double>& vertices = strips[strip];
+        size_t count = vertices.size() / 6, start = 0;
+        bool split = false, first = true;
+        auto emit = [&](size_t begin, size_t last){
+            if(last <= begin){
+                return;
+            }
+            std::vector<double> piece(vertices.begin() + begin * 6, vertices.begin() + (last + 1) * 6);
+            (first ? kept : pieces).push_back(std::move(piece));
+            first = false;
+        };
+        for(size_t segment = 0; segment + 1 < count; ++segment){
+            if(segmentAngle(&vertices[segment * 6], &vertices[segment * 6 + 6], direction) <= radius){
+                ++erased;
+                split = true;
+                emit(start, segment);
+                start = segment + 1;
+            }
+        }
+        if(!split){
+            kept.push_back(vertices);
+            continue;
+        }
+        emit(start, count - 1);
+    }
+    kept.insert(kept.end(), pieces.begin(), pieces.end());
+    kept.emplace_back();
+    return kept;
+}
+
+/* Same segments and the same answers to picks as an index built from scratch */
+static bool sameIndex(const Geometry::SphereIndex& index, const Geometry::StrokeArena& arena, std::mt19937& rng){
+    Geometry::SphereIndex fresh;
+    fresh.sync(arena);
+    if(index.getSegmentCount() != fresh.getSegmentCount()){
+        return false;
+    }
+    for(int query = 0; query < 50; ++query){
+        glm::dvec3 direction = randomDirection(rng);
+        Geometry::StrokeHit hit, fresh_hit;
+        bool found = index.pick(arena, direction, 0.1, hit), fresh_found = fresh.pick(arena, direction, 0.1, fresh_hit);
+        if(found != fresh_found || (found && (hit.strip != fresh_hit.strip || hit.segment != fresh_hit.segment))){
+            return false;
+        }
+    }
+    return true;
+}
+
+int checkIndex(){
+    Strips strips;
+    Geometry::generateRandomWalks(strips, 60000);
+    Geometry::generateScribbles(strips, 20000);
+    strips.emplace_back();
+    size_t segments = 0;
+    for(const std::vector<double>& strip : strips){
+        segments += strip.size() >= 12 ? strip.size() / 6 - 1 : 0;
+    }
+    std::mt19937 rng(3);
+    bool ok = true;
+
+    /* Built strip by strip in small steps with a mutable tail, like while drawing */
+    Geometry::SphereIndex grown, index;
+    Strips growing;
+    for(const std::vector<double>& strip : strips){
+        growing.emplace_back();
+        for(size_t begin = 0; begin < strip.size(); begin += 6 * 37){
+            growing.back().insert(growing.back().end(), strip.begin() + begin, strip.begin() + std::min(strip.size(), begin + 6 * 37));
+            grown.sync(growing, 1);
+        }
+    }
+    grown.sync(growing, 0);
+    index.sync(strips);
+    bool synced = grown.getSegmentCount() == segments && index.getSegmentCount() == segments;
+    ok = ok && synced;
+    std::cout << "sync: " << segments << " segments, " << grown.getSegmentCount() << " indexed incrementally, "
+              << index.getSegmentCount() << " at once" << (synced ? "" : " FAILED") << "\n";
+
+    size_t pick_misses = 0;
+    for(int query = 0; query < 100; ++query){
+        glm::dvec3 direction = randomDirection(rng);
+        Geometry::StrokeHit hit;
+        bool found = index.pick(strips, direction, 0.05, hit);
+        double best = 0.05;
+        bool linear_found = false;
+        for(const std::vector<double>& strip : strips){
+            for(size_t vertex = 0; vertex + 12 <= strip.size(); vertex += 6){
+                double angle = segmentAngle(&strip[vertex], &strip[vertex + 6], direction);
+                if(angle <= best){
+                    best = angle;
+                    linear_found = true;
+                }
+            }
+        }
+        pick_misses += found != linear_found || (found && std::fabs(hit.angle - best) > 1e-12) ? 1 : 0;
+    }
+    ok = ok && pick_misses == 0;
+    std::cout << "pick: 100 directions, " << pick_misses << " differ from a linear scan" << (pick_misses == 0 ? "" : " FAILED") << "\n";
+
+    /* Every segment starting inside the frustum has to be in a visible range */
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    size_t cull_misses = 0, submitted = 0;
+    std::vector<Geometry::StripRange> ranges;
+    for(int view = 0; view < 20; ++view){
+        glm::vec3 eye(0.0f, (float)Geometry::camera_y_shift, 0.0f), front = glm::normalize(glm::vec3(randomDirection(rng)) * glm::vec3(1.0f, 0.5f, 1.0f));
+        glm::mat4 clip = projection * glm::lookAt(eye, eye + front, glm::vec3(0.0f, 1.0f, 0.0f));
+        ranges.clear();
+        index.collectVisible(clip, ranges);
+        std::vector<std::vector<char>> covered(strips.size());
+        for(size_t strip = 0; strip < strips.size(); ++strip){
+            covered[strip].assign(strips[strip].size() / 6, 0);
+        }
+        for(const Geometry::StripRange& range : ranges){
+            for(uint32_t vertex = range.first; vertex + 1 < range.first + range.count; ++vertex){
+                covered[range.strip][vertex] = 1;
+            }
+            submitted += range.count - 1;
+        }
+        for(size_t strip = 0; strip < strips.size(); ++strip){
+            for(size_t vertex = 0; vertex + 1 < strips[strip].size() / 6; ++vertex){
+                const double* position = &strips[strip][vertex * 6];
+                glm::vec4 point = clip * glm::vec4((float)position[0], (float)position[1], (float)position[2], 1.0f);
+                bool inside = point.w > 0.0f && std::fabs(point.x) < point.w && std::fabs(point.y) < point.w && std::fabs(point.z) < point.w;
+                cull_misses += inside && !covered[strip][vertex] ? 1 : 0;
+            }
+        }
+    }
+    ok = ok && cull_misses == 0;
+    std::cout << "culling: 20 views, " << cull_misses << " visible segments missed, " << 100.0 * submitted / (20.0 * segments)
+              << "% of the segments submitted" << (cull_misses == 0 ? "" : " FAILED") << "\n";
+
+    /* Erasing splits the strips like a linear scan does, and an index following the changes matches a fresh one */
+    Geometry::StrokeArena arena;
+    for(const std::vector<double>& strip : strips){
+        arena.addStroke();
+        arena.append(arena.size() - 1, strip.data(), strip.size());
+    }
+    Geometry::SphereIndex follower;
+    index.reset();
+    index.sync(arena);
+    follower.sync(arena);
+    size_t erase_failures = 0;
+    for(int stroke = 0; stroke < 10; ++stroke){
+        const Strips before = copyStrips(arena);
+        size_t strip = rng() % (before.size() - 1);
+        if(before[strip].size() < 12){
+            continue;
+        }
+        glm::dvec3 direction = directionOf(&before[strip][(rng() % (before[strip].size() / 6)) * 6]);
+        size_t linear_erased;
+        Strips expected = eraseLinear(before, direction, 0.03, linear_erased);
+        Geometry::StrokeChanges changes;
+        size_t erased = index.erase(arena, direction, 0.03, 0, &changes);
+        follower.apply(arena, changes);
+        bool passed = erased == linear_erased && copyStrips(arena) == expected && sameIndex(index, arena, rng) && sameIndex(follower, arena, rng);
+        erase_failures += passed ? 0 : 1;
+    }
+
+    /* A whole stroke, with every piece erasing left of it */
+    for(int stroke = 0; stroke < 5; ++stroke){
+        uint32_t id = arena.strokeId(rng() % (arena.size() - 1));
+        Strips expected;
+        for(size_t strip = 0; strip < arena.size(); ++strip){
+            if(arena.strokeId(strip) != id){
+                expected.emplace_back(arena[strip].begin(), arena[strip].end());
+            }
+        }
+        Geometry::StrokeChanges changes;
+        index.eraseStroke(arena, id, &changes);
+        follower.apply(arena, changes);
+        bool passed = copyStrips(arena) == expected && sameIndex(index, arena, rng) && sameIndex(follower, arena, rng);
+        erase_failures += passed ? 0 : 1;
+    }
+    ok = ok && erase_failures == 0;
+    std::cout << "erase: 10 erases and 5 whole strokes, " << erase_failures << " differ from a linear scan or a fresh index"
+              << (erase_failures == 0 ? "" : " FAILED") << "\n";
+    return ok ? 0 : 1;
+}
+
+int checkArena(){
+    /* Random edits of the arena and of a plain copy, snapshots have to keep what they saw and restores have to
+       report the strokes they replaced */
+    size_t failures = 0;
+    for(unsigned seed = 1; seed <= 8 && failures == 0; ++seed){
+        std::mt19937 rng(seed);
+        auto pick = [&](size_t count){ return std::uniform_int_distribution<size_t>(0, count - 1)(rng); };
+        Geometry::StrokeArena arena;
+        Strips model;
+        std::deque<std::pair<Geometry::StrokeArena::Snapshot, Strips>> snapshots;
+        double value = 0.0;
+        auto vertices = [&](size_t count){
+            std::vector<double> values(count * 6);
+            for(double& v : values){
+                v = ++value;
+            }
+            return values;
+        };
+        for(int step = 0; step < 2000 && failures == 0; ++step){
+            size_t operation = pick(12);
+            if(operation == 0 || arena.empty()){
+                arena.addStroke();
+                model.emplace_back();
+            }
+            else if(operation <= 3){
+                size_t strip = pick(arena.size());
+                std::vector<double> added = vertices(1 + pick(20));
+                arena.append(strip, added.data(), added.size());
+                model[strip].insert(model[strip].end(), added.begin(), added.end());
+            }
+            else if(operation == 4){
+                size_t strip = pick(arena.size()), count = model[strip].size() / 6;
+                size_t kept = count > 0 ? pick(count + 1) * 6 : 0;
+                arena.truncate(strip, kept);
+                model[strip].resize(kept);
+            }
+            else if(operation == 5){
+                size_t strip = pick(arena.size());
+                if(!model[strip].empty()){
+                    arena.mutableData(strip)[0] = model[strip][0] = ++value;
+                }
+            }
+            else if(operation == 6){
+                size_t position = pick(arena.size() + 1), count = 1 + pick(3);
+                arena.insertStrokes(position, count);
+                model.insert(model.begin() + position, count, std::vector<double>());
+            }
+            else if(operation == 7){
+                std::vector<size_t> removed;
+                for(size_t strip = 0; strip < arena.size(); ++strip){
+                    if(pick(40) == 0){
+                        removed.push_back(strip);
+                    }
+                }
+                arena.removeStrokes(removed);
+                for(size_t r = removed.size(); r-- > 0;){
+                    model.erase(model.begin() + removed[r]);
+                }
+            }
+            else if(operation == 8){
+                snapshots.emplace_back(arena.snapshot(), model);
+                if(snapshots.size() > 30){
+                    snapshots.erase(snapshots.begin() + pick(snapshots.size()));
+                }
+            }
+            else if(operation == 9 && !snapshots.empty()){
+                size_t target = pick(snapshots.size());
+                Strips before = model;
+                Geometry::StrokeChanges changes;
+                arena.restore(snapshots[target].first, &changes);
+                model = snapshots[target].second;
+
+                /* The changes turn the old strokes into the new ones */
+                Strips walked;
+                size_t r = 0, i = 0, old = 0;
+                for(size_t after = 0; after < model.size(); ++after){
+                    if(i < changes.inserted.size() && changes.inserted[i] == after){
+                        walked.push_back(model[after]);
+                        ++i;
+                        continue;
+                    }
+                    while(r < changes.removed.size() && changes.removed[r] == old){
+                        ++r;
+                        ++old;
+                    }
+                    if(old >= before.size()){
+                        break;
+                    }
+                    walked.push_back(before[old++]);
+                }
+                if(walked != model){
+                    std::cout << "seed " << seed << ", step " << step << ": the changes do not describe the restore\n";
+                    ++failures;
+                }
+            }
+            else if(operation == 10 && !snapshots.empty()){
+                snapshots.erase(snapshots.begin() + pick(snapshots.size()));
+            }
+            else if(operation == 11 && snapshots.size() >= 2){
+                size_t a = pick(snapshots.size()), b = pick(snapshots.size());
+                if(snapshots[a].first.sharesAll(snapshots[b].first) && snapshots[a].second != snapshots[b].second){
+                    std::cout << "seed " << seed << ", step " << step << ": snapshots share strokes they do not have\n";
+                    ++failures;
+                }
+            }
+
+            if(copyStrips(arena) != model){
+                std::cout << "seed " << seed << ", step " << step << ", operation " << operation << ": the strokes differ\n";
+                ++failures;
+            }
+            for(const auto& snapshot : snapshots){
+                if(copyStrips(snapshot.first) != snapshot.second){
+                    std::cout << "seed " << seed << ", step " << step << ", operation " << operation << ": a snapshot changed\n";
+                    ++failures;
+                    break;
+                }
+            }
+        }
+    }
+    std::cout << "model: 8 seeds of 2000 random edits, " << failures << " mismatches" << (failures == 0 ? "" : " FAILED") << "\n";
+
+    /* A snapshot read on another thread(an export) while the arena keeps changing. Build with
+       -DSPHERE_SANITIZE=thread to have the reads checked for races */
+    Geometry::StrokeArena arena;
+    const double vertex[6] = {0.0, 1.0, 0.0, 1.0, 1.0, 1.0};
+    for(int stroke = 0; stroke < 200; ++stroke){
+        arena.addStroke();
+        for(int added = 0; added < 100; ++added){
+            arena.append(stroke, vertex, 6);
+        }
+    }
+    std::mt19937 rng(1);
+    size_t read_failures = 0;
+    for(int round = 0; round < 10; ++round){
+        Geometry::StrokeArena::Snapshot snapshot = arena.snapshot();
+        size_t expected = 0;
+        for(size_t strip = 0; strip < snapshot.size(); ++strip){
+            expected += snapshot[strip].size() / 6;
+        }
+        std::atomic<bool> done{false};
+        size_t wrong_reads = 0;
+        std::thread reader([&](){
+            for(int read = 0; read < 10; ++read){
+                wrong_reads += Geometry::StrokeBuffer::fromStrips(snapshot).vertexCount() != expected ? 1 : 0;
+            }
+            done = true;
+        });
+        for(int edit = 0; !done && edit < 20000; ++edit){
+            size_t strip = rng() % arena.size();
+            switch(rng() % 4){
+                case 0:
+                    arena.append(strip, vertex, 6);
+                    break;
+                case 1:
+                    arena.truncate(strip, 0);
+                    break;
+                case 2:
+                    if(arena[strip].size() > 0){
+                        arena.mutableData(strip)[0] = (double)rng();
+                    }
+                    break;
+                default:
+                    arena.addStroke();
+            }
+        }
+        reader.join();
+        read_failures += wrong_reads;
+    }
+    std::cout << "concurrent reads: 10 snapshots read while the arena changed, " << read_failures << " wrong reads"
+              << (read_failures == 0 ? "" : " FAILED") << "\n";
+    return failures == 0 && read_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+    Self checks of the library run by SphereBatch(--check-parallel, --check-index, --check-arena) and by ctest.
+    Each one prints what it compared and returns the exit code, 0 if nothing differed.
+*/
+
+/* The parallel unfold against the sequential one, bit for bit, for every supported kernel and 1, 4 and 16 threads */
+int checkParallel();
+
+/* SphereIndex culling, picking and erasing against linear scans of the strips */
+int checkIndex();
+
+/* StrokeArena and its snapshots against a plain model under random edits, and a snapshot read while the arena changes */
+int checkArena();
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Geometry/SphereUnfold.h"
+#include "../Geometry/StrokeIO.h"
+#include "../Geometry/StrokeBuffer.h"
+#include "../Geometry/UnfoldKernel.h"
+#include "../Geometry/SessionLog.h"
+#include "../Geometry/Projections.h"
+#include "../Export/ImageWriter.h"
+#include "../Export/SoftwareRaster.h"
+#include "../Export/VectorWriter.h"
+#include "../Utils/WorkStealingPool.h"
+#include "BatchChecks.h"
+
+/*
+    Headless batch unfolding: reads stroke files, runs the same sphere -> cylinder -> plane pipeline as the
+    interactive drawer, and writes the unfolded strips and/or a rendered PNG. No window and no GL context
+    are created, so it runs on plain render nodes. The unfolded polylines can also go straight to SVG or
+    binary polyline files, which skips rasterization entirely.
+*/
+
+struct BatchOptions{
+    std::filesystem::path output_dir;
+    int width = 1920, height = 1080;
+    unsigned threads = 0;
+    float line_width = 3.0f;
+    Geometry::Projection projection = Geometry::Projection::Cylinder;
+    bool write_image = true, write_geometry = true, write_svg = false, write_polylines = false, check_precision = false;
+    /* Self check to run instead of unfolding: "parallel", "index" or "arena" */
+    std::string check;
+};
+
+static void printUsage(const char* program){
+    std::cout << "Usage: " << program << " [options] <input.strokes | session.ssl | directory>...\n"
+              << "  -o <dir>            output directory(default: next to each input)\n"
+              << "  -s <W>x<H>          size of rendered images(default: 1920x1080)\n"
+              << "  -j <threads>        number of worker threads(default: all cores)\n"
+              << "  --line-width <px>   width of rendered lines(default: 3)\n"
+              << "  --no-image          do not render PNG images\n"
+              << "  --no-geometry       do not write unfolded stroke files\n"
+              << "  --svg               write unfolded strokes as SVG polylines(<name>.svg)\n"
+              << "  --polylines         write unfolded strokes as binary polylines(<name>.spl)\n"
+              << "  --projection <name> cylinder, equirectangular, mercator, lambert, gnomonic or stereographic\n"
+              << "                      (default: cylinder)\n"
+              << "  --isa <name>        force unfold kernels: scalar, sse4.1 or avx2(default: best supported)\n"
+              << "  --check-precision   compare the float kernels against the double path and exit\n"
+              << "  --check-parallel    compare the parallel unfold against the sequential one and exit\n"
+              << "  --check-index       compare the stroke index against linear scans and exit\n"
+              << "  --check-arena       compare the stroke arena and its snapshots against a plain copy and exit\n";
+}
+
+/* With a pool the unfold of the drawing itself is split into tasks(same result as the sequential one) */
+static bool processDrawing(const std::filesystem::path& input, const BatchOptions& options, Utils::WorkStealingPool* pool){
+    std::vector<std::vector<double>> strips;
+    Geometry::StrokeBuffer strokes;
+    if(input.extension() == ".ssl"){
+        /* Session logs already hold float SoA positions, the last drawing is copied over without parsing */
+        Geometry::SessionReader session;
+        if(!session.open(input.string())){
+            return false;
+        }
+        session.appendTo(strokes, session.getDrawingCount() - 1);
+    }
+    else{
+        if(!Geometry::readStrokes(input.string(), strips)){
+            return false;
+        }
+        strokes = Geometry::StrokeBuffer::fromStrips(strips);
+    }
+    if(options.projection != Geometry::Projection::Cylinder){
+        Geometry::unfold(strokes, options.projection);
+    }
+    else if(pool){
+        Geometry::unfold(strokes, *pool);
+    }
+    else{
+        Geometry::unfold(strokes);
+    }
+
+    std::filesystem::path output_base = (options.output_dir.empty() ? input.parent_path() : options.output_dir) / input.stem();
+    bool ok = true;
+    if(options.write_svg){
+        Export::SvgOptions svg;
+        svg.line_width = options.line_width;
+        ok = Export::writeSvg(output_base.string() + ".svg", strokes, svg) && ok;
+    }
+    if(options.write_polylines){
+        ok = Export::writePolylines(output_base.string() + ".spl", strokes) && ok;
+    }
+    if(!options.write_geometry && !options.write_image){
+        return ok;
+    }
+
+    strips.clear();
+    strokes.appendToStrips(strips);
+    if(options.write_geometry){
+        ok = Geometry::writeStrokes(output_base.string() + ".unfolded.strokes", strips) && ok;
+    }
+    if(options.write_image){
+        Export::SoftwareRaster raster(options.width, options.height);
+        raster.line_width = options.line_width;
+        if(options.projection != Geometry::Projection::Cylinder){
+            /* The cylinder keeps the frame of the interactive drawer, other maps are fitted into the image */
+            raster.ortho_scale = Geometry::fitHalfHeight(options.projection, (float)options.width / (float)options.height);
+        }
+        raster.drawStrips(strips);
+        ok = Export::writePng(output_base.string() + ".png", raster.getWidth(), raster.getHeight(), 3, raster.data(), raster.getStride()) && ok;
+    }
+    return ok;
+}
+
+static int checkPrecision(const std::vector<std::filesystem::path>& inputs){
+    std::vector<std::vector<double>> strips;
+    for(const std::filesystem::path& input : inputs){
+        Geometry::SessionReader session;
+        if(input.extension() == ".ssl"){
+            if(!session.open(input.string())){
+                return -1;
+            }
+            session.appendToStrips(strips, session.getDrawingCount() - 1);
+        }
+        else if(!Geometry::readStrokes(input.string(), strips)){
+            return -1;
+        }
+    }
+    if(strips.empty()){
+        /* Latitude rings over the drawable part of the sphere(the camera pitch is limited to 89 degrees) */
+        for(int ring = -89; ring <= 89; ++ring){
+            std::vector<double> strip;
+            double latitude = ring * Geometry::PI / 180.0;
+            for(int step = 0; step <= 3600; ++step){
+                double longitude = step * Geometry::PI / 1800.0;
+                strip.insert(strip.end(), {Geometry::S_RADIUS * std::cos(latitude) * std::cos(longitude),
+                                           Geometry::S_RADIUS * std::sin(latitude) + Geometry::camera_y_shift,
+                                           Geometry::S_RADIUS * std::cos(latitude) * std::sin(longitude), 1.0, 1.0, 1.0});
+            }
+            strips.push_back(std::move(strip));
+        }
+    }
+
+    /* Errors well below a pixel of a 16K wide unfold(the plane is about 2 * PI wide) */
+    const double tolerance = 1e-4;
+    bool ok = true;
+    for(Geometry::KernelIsa isa : {Geometry::KernelIsa::Scalar, Geometry::KernelIsa::SSE41, Geometry::KernelIsa::AVX2}){
+        Geometry::setKernelIsa(isa);
+        if(Geometry::activeKernelIsa() != isa){
+            std::cout << Geometry::kernelIsaName(isa) << ": not supported\n";
+            continue;
+        }
+        Geometry::UnfoldPrecision precision = Geometry::checkUnfoldPrecision(strips, isa);
+        bool passed = precision.cylinder_error < tolerance && precision.plane_error < tolerance;
+        ok = ok && passed;
+        std::cout << Geometry::kernelIsaName(isa) << ": " << precision.vertices << " vertices, max cylinder error "
+                  << precision.cylinder_error << ", max plane error " << precision.plane_error << (passed ? "" : " FAILED") << "\n";
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv){
+    BatchOptions options;
+    std::vector<std::filesystem::path> inputs;
+
+    for(int arg = 1; arg < argc; ++arg){
+        const char* current = argv[arg];
+        bool has_value = arg + 1 < argc;
+        if(!std::strcmp(current, "-h") || !std::strcmp(current, "--help")){
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if(!std::strcmp(current, "-o") && has_value){
+            options.output_dir = argv[++arg];
+        }
+        else if(!std::strcmp(current, "-s") && has_value){
+            if(std::sscanf(argv[++arg], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0){
+                std::cerr << "Bad image size: " << argv[arg] << "\n";
+                return -1;
+            }
+        }
+        else if(!std::strcmp(current, "-j") && has_value){
+            options.threads = (unsigned)std::max(1, std::atoi(argv[++arg]));
+        }
+        else if(!std::strcmp(current, "--line-width") && has_value){
+            options.line_width = (float)std::atof(argv[++arg]);
+        }
+        else if(!std::strcmp(current, "--no-image")){
+            options.write_image = false;
+        }
+        else if(!std::strcmp(current, "--no-geometry")){
+            options.write_geometry = false;
+        }
+        else if(!std::strcmp(current, "--svg")){
+            options.write_svg = true;
+        }
+        else if(!std::strcmp(current, "--polylines")){
+            options.write_polylines = true;
+        }
+        else if(!std::strcmp(current, "--check-precision")){
+            options.check_precision = true;
+        }
+        else if(!std::strcmp(current, "--check-parallel") || !std::strcmp(current, "--check-index") || !std::strcmp(current, "--check-arena")){
+            options.check = current + std::strlen("--check-");
+        }
+        else if(!std::strcmp(current, "--projection") && has_value){
+            if(!Geometry::parseProjection(argv[++arg], options.projection)){
+                std::cerr << "Unknown projection: " << argv[arg] << "\n";
+                return -1;
+            }
+        }
+        else if(!std::strcmp(current, "--isa") && has_value){
+            std::string isa = argv[++arg];
+            if(isa == "scalar"){
+                Geometry::setKernelIsa(Geometry::KernelIsa::Scalar);
+            }
+            else if(isa == "sse4.1"){
+                Geometry::setKernelIsa(Geometry::KernelIsa::SSE41);
+            }
+            else if(isa == "avx2"){
+                Geometry::setKernelIsa(Geometry::KernelIsa::AVX2);
+            }
+            else{
+                std::cerr << "Unknown instruction set: " << isa << "\n";
+                return -1;
+            }
+        }
+        else if(current[0] == '-'){
+            std::cerr << "Unknown option: " << current << "\n";
+            printUsage(argv[0]);
+            return -1;
+        }
+        else if(std::filesystem::is_directory(current)){
+            for(const auto& entry : std::filesystem::directory_iterator(current)){
+                if(entry.is_regular_file() && (entry.path().extension() == ".strokes" || entry.path().extension() == ".ssl")){
+                    inputs.push_back(entry.path());
+                }
+            }
+        }
+        else{
+            inputs.push_back(current);
+        }
+    }
+
+    if(options.check_precision){
+        return checkPrecision(inputs);
+    }
+    if(options.check == "parallel"){
+        return checkParallel();
+    }
+    if(options.check == "index"){
+        return checkIndex();
+    }
+    if(options.check == "arena"){
+        return checkArena();
+    }
+    if(inputs.empty()){
+        printUsage(argv[0]);
+        return -1;
+    }
+    if(!options.output_dir.empty()){
+        std::filesystem::create_directories(options.output_dir);
+    }
+    std::sort(inputs.begin(), inputs.end());
+
+    if(options.threads == 0){
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    unsigned file_workers = std::min<unsigned>(options.threads, (unsigned)inputs.size());
+
+    /* Fewer drawings than threads(one huge export): the spare threads help unfolding every drawing */
+    std::unique_ptr<Utils::WorkStealingPool> unfoldPool;
+    if(file_workers < options.threads){
+        unfoldPool = std::make_unique<Utils::WorkStealingPool>(options.threads);
+    }
+
+    /* Drawings are independent, so the workers just grab the next file until the list is exhausted */
+    std::atomic<size_t> next_input{0}, failed{0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for(unsigned t = 0; t < file_workers; ++t){
+        workers.emplace_back([&](){
+            for(size_t i = next_input++; i < inputs.size(); i = next_input++){
+                if(!processDrawing(inputs[i], options, unfoldPool.get())){
+                    std::cerr << "Failed to process: " << inputs[i].string() << "\n";
+                    ++failed;
+                }
+            }
+        });
+    }
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Unfolded " << inputs.size() - failed << "/" << inputs.size() << " drawings in " << seconds << " s using "
+              << options.threads << " thread(s), " << Geometry::kernelIsaName(Geometry::activeKernelIsa()) << " kernels\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Geometry/SphereUnfold.h"
+#include "../Geometry/StrokeArena.h"
+#include "../Geometry/StrokeBuffer.h"
+#include "../Geometry/StrokeGenerators.h"
+#include "../Geometry/UnfoldKernel.h"
+#include "../Export/ImageWriter.h"
+#include "../Export/PngStream.h"
+#include "../Export/SoftwareRaster.h"
+#include "../Utils/WorkStealingPool.h"
+
+/*
+    Throughput benchmark of the unfold pipeline on synthetic drawings. Every stage is timed on its own(the input
+    of a stage is prepared outside of the measured time), the median of the iterations is reported as JSON or CSV
+    so the numbers can be compared between commits and machines.
+*/
+
+struct BenchOptions{
+    size_t vertices = 1000000;
+    int iterations = 5;
+    unsigned threads = 0;
+    int width = 1920, height = 1080;
+    bool csv = false, png = true;
+    /* Directory to keep the encoded images in, for checking them with other decoders */
+    std::string keep_png;
+    std::vector<std::string> generators{"walk", "spiral", "scribble"};
+    std::vector<Geometry::KernelIsa> isas;
+};
+
+/* Rows per band of the streamed PNG stage */
+static const int PNG_STREAM_BAND = 256;
+
+struct BenchResult{
+    std::string generator, stage, isa;
+    size_t vertices = 0, bytes = 0;
+    double seconds = 0.0;
+};
+
+static void printUsage(const char* program){
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  -n <vertices>       vertices per generated drawing(default: 1000000)\n"
+              << "  -i <iterations>     runs of every stage, the median is reported(default: 5)\n"
+              << "  -j <threads>        threads of the parallel unfold stage(default: all cores)\n"
+              << "  -s <W>x<H>          size of the encoded images(default: 1920x1080)\n"
+              << "  --generator <name>  walk, spiral, scribble or all(default: all)\n"
+              << "  --isa <name>        scalar, sse4.1, avx2 or all(default: best supported)\n"
+              << "  --no-png            skip the PNG encoding stages\n"
+              << "  --keep-png <dir>    keep the images of the PNG stages as <generator>.png and <generator>.stream.png\n"
+              << "  --csv               print CSV instead of JSON\n";
+}
+
+/* Runs prepare() and then the measured stage() iterations times, returns the median time */
+static double measure(int iterations, const std::function<void()>& prepare, const std::function<void()>& stage){
+    std::vector<double> times;
+    for(int run = 0; run < iterations; ++run){
+        prepare();
+        auto start = std::chrono::steady_clock::now();
+        stage();
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static void benchDrawing(const std::string& generator, const std::vector<std::vector<double>>& strips, const BenchOptions& options,
+                         Geometry::KernelIsa isa, Utils::WorkStealingPool& pool, std::vector<BenchResult>& results){
+    Geometry::setKernelIsa(isa);
+    std::string isa_name = Geometry::kernelIsaName(isa);
+    auto add = [&](const char* stage, size_t vertices, size_t bytes, double seconds){
+        results.push_back({generator, stage, isa_name, vertices, bytes, seconds});
+    };
+
+    size_t vertices = 0;
+    for(const std::vector<double>& strip : strips){
+        vertices += strip.size() / Geometry::VERTEX_STRIDE;
+    }
+    const size_t interleaved_bytes = vertices * Geometry::VERTEX_STRIDE * sizeof(double);
+
+    /* Drawing the strips vertex by vertex: one heap vector per strip, or pooled extents reused between runs */
+    std::vector<std::vector<double>> drawn_strips;
+    add("append_strips", vertices, interleaved_bytes, measure(options.iterations, [&](){ drawn_strips.clear(); }, [&](){
+        for(const std::vector<double>& strip : strips){
+            drawn_strips.emplace_back();
+            for(size_t v_num = 0; v_num < strip.size(); v_num += Geometry::VERTEX_STRIDE){
+                drawn_strips.back().insert(drawn_strips.back().end(), strip.data() + v_num, strip.data() + v_num + Geometry::VERTEX_STRIDE);
+            }
+        }
+    }));
+    Geometry::StrokeArena drawn_arena;
+    add("append_arena", vertices, interleaved_bytes, measure(options.iterations, [&](){ drawn_arena.clear(); }, [&](){
+        for(const std::vector<double>& strip : strips){
+            size_t stroke = drawn_arena.size();
+            drawn_arena.addStroke();
+            for(size_t v_num = 0; v_num < strip.size(); v_num += Geometry::VERTEX_STRIDE){
+                drawn_arena.append(stroke, strip.data() + v_num, Geometry::VERTEX_STRIDE);
+            }
+        }
+    }));
+
+    /* A version of the drawing for undo or export: a deep copy of the strips, or a snapshot sharing the extents */
+    std::vector<std::vector<double>> copied_strips;
+    add("copy_strips", vertices, interleaved_bytes, measure(options.iterations, [&](){ copied_strips.clear(); }, [&](){
+        copied_strips = drawn_strips;
+    }));
+    Geometry::StrokeArena::Snapshot drawn_snapshot;
+    add("snapshot", vertices, interleaved_bytes, measure(options.iterations, [&](){ drawn_snapshot = Geometry::StrokeArena::Snapshot(); }, [&](){
+        drawn_snapshot = drawn_arena.snapshot();
+    }));
+    drawn_snapshot = Geometry::StrokeArena::Snapshot();
+
+    /* Strips -> SoA float buffer */
+    Geometry::StrokeBuffer source;
+    add("pack_soa", vertices, interleaved_bytes, measure(options.iterations, [&](){ source.clear(); }, [&](){
+        source = Geometry::StrokeBuffer::fromStrips(strips);
+    }));
+
+    Geometry::StrokeBuffer cylinder;
+    add("cylinder", vertices, vertices * 3 * sizeof(float), measure(options.iterations, [&](){ cylinder = source; }, [&](){
+        Geometry::toCylinder(cylinder);
+    }));
+
+    Geometry::StrokeBuffer split;
+    add("seam_split", vertices, vertices * 3 * sizeof(float), measure(options.iterations, [&](){ split.clear(); }, [&](){
+        Geometry::splitSeam(cylinder, split);
+    }));
+
+    Geometry::StrokeBuffer plane;
+    add("project", split.vertexCount(), split.vertexCount() * 3 * sizeof(float), measure(options.iterations, [&](){ plane = split; }, [&](){
+        Geometry::projectPoints(plane);
+    }));
+
+    /* The whole pipeline, sequential and split into tasks on the pool, the two results must be identical */
+    Geometry::StrokeBuffer sequential, parallel;
+    add("unfold", vertices, vertices * 3 * sizeof(float), measure(options.iterations, [&](){ sequential = source; }, [&](){
+        Geometry::unfold(sequential);
+    }));
+    add("unfold_parallel", vertices, vertices * 3 * sizeof(float), measure(options.iterations, [&](){ parallel = source; }, [&](){
+        Geometry::unfold(parallel, pool);
+    }));
+    if(parallel.x != sequential.x || parallel.y != sequential.y || parallel.z != sequential.z || parallel.offsets != sequential.offsets){
+        std::cerr << generator << ", " << isa_name << ": parallel unfold differs from the sequential one\n";
+    }
+
+    /* Double XYZRGB strips -> XYZ floats, what the stroke store does before every upload */
+    std::vector<float> positions(vertices * 3);
+    add("upload_pack", vertices, interleaved_bytes, measure(options.iterations, [](){}, [&](){
+        float* out = positions.data();
+        for(const std::vector<double>& strip : strips){
+            size_t count = strip.size() / Geometry::VERTEX_STRIDE;
+            Geometry::packPositions(strip.data(), count, out);
+            out += count * 3;
+        }
+    }));
+
+    if(!options.png){
+        return;
+    }
+
+    /* Encoding only: the unfolded drawing is rasterized once, outside of the measured time */
+    std::vector<std::vector<double>> unfolded;
+    plane.appendToStrips(unfolded);
+    Export::SoftwareRaster raster(options.width, options.height);
+    raster.drawStrips(unfolded);
+    size_t image_bytes = (size_t)raster.getStride() * raster.getHeight();
+    std::filesystem::path image_dir = options.keep_png.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path(options.keep_png);
+    std::string image_path = (image_dir / (generator + ".png")).string(), stream_path = (image_dir / (generator + ".stream.png")).string();
+
+    add("png_encode", plane.vertexCount(), image_bytes, measure(options.iterations, [](){}, [&](){
+        Export::writePng(image_path, raster.getWidth(), raster.getHeight(), 3, raster.data(), raster.getStride());
+    }));
+    /* In bands of rows like the tiled export, every band is a deflate block of its own */
+    add("png_stream", plane.vertexCount(), image_bytes, measure(options.iterations, [](){}, [&](){
+        Export::PngStreamWriter png;
+        png.open(stream_path, raster.getWidth(), raster.getHeight(), 3);
+        for(int row = 0; row < raster.getHeight(); row += PNG_STREAM_BAND){
+            png.writeRows(raster.data() + (size_t)row * raster.getStride(), std::min(PNG_STREAM_BAND, raster.getHeight() - row), raster.getStride());
+        }
+        png.close();
+    }));
+    if(options.keep_png.empty()){
+        std::filesystem::remove(image_path);
+        std::filesystem::remove(stream_path);
+    }
+}
+
+static void printResults(const std::vector<BenchResult>& results, bool csv){
+    if(csv){
+        std::printf("generator,isa,stage,vertices,bytes,seconds,vertices_per_s,mb_per_s\n");
+    }
+    else{
+        std::printf("[\n");
+    }
+    for(size_t i = 0; i < results.size(); ++i){
+        const BenchResult& result = results[i];
+        double seconds = std::max(result.seconds, 1e-12);
+        double vertices_per_s = result.vertices / seconds, mb_per_s = result.bytes / seconds / 1e6;
+        if(csv){
+            std::printf("%s,%s,%s,%zu,%zu,%.9f,%.1f,%.2f\n", result.generator.c_str(), result.isa.c_str(), result.stage.c_str(),
+                        result.vertices, result.bytes, result.seconds, vertices_per_s, mb_per_s);
+        }
+        else{
+            std::printf("  {\"generator\": \"%s\", \"isa\": \"%s\", \"stage\": \"%s\", \"vertices\": %zu, \"bytes\": %zu, "
+                        "\"seconds\": %.9f, \"vertices_per_s\": %.1f, \"mb_per_s\": %.2f}%s\n",
+                        result.generator.c_str(), result.isa.c_str(), result.stage.c_str(), result.vertices, result.bytes,
+                        result.seconds, vertices_per_s, mb_per_s, i + 1 < results.size() ? "," : "");
+        }
+    }
+    if(!csv){
+        std::printf("]\n");
+    }
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+
+    for(int arg = 1; arg < argc; ++arg){
+        const char* current = argv[arg];
+        bool has_value = arg + 1 < argc;
+        if(!std::strcmp(current, "-h") || !std::strcmp(current, "--help")){
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if(!std::strcmp(current, "-n") && has_value){
+            options.vertices = (size_t)std::max(1LL, std::atoll(argv[++arg]));
+        }
+        else if(!std::strcmp(current, "-i") && has_value){
+            options.iterations = std::max(1, std::atoi(argv[++arg]));
+        }
+        else if(!std::strcmp(current, "-j") && has_value){
+            options.threads = (unsigned)std::max(1, std::atoi(argv[++arg]));
+        }
+        else if(!std::strcmp(current, "-s") && has_value){
+            if(std::sscanf(argv[++arg], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0){
+                std::cerr << "Bad image size: " << argv[arg] << "\n";
+                return -1;
+            }
+        }
+        else if(!std::strcmp(current, "--generator") && has_value){
+            std::string generator = argv[++arg];
+            if(generator == "all"){
+                options.generators = {"walk", "spiral", "scribble"};
+            }
+            else if(generator == "walk" || generator == "spiral" || generator == "scribble"){
+                options.generators = {generator};
+            }
+            else{
+                std::cerr << "Unknown generator: " << generator << "\n";
+                return -1;
+            }
+        }
+        else if(!std::strcmp(current, "--isa") && has_value){
+            std::string isa = argv[++arg];
+            if(isa == "all"){
+                options.isas = {Geometry::KernelIsa::Scalar, Geometry::KernelIsa::SSE41, Geometry::KernelIsa::AVX2};
+            }
+            else if(isa == "scalar"){
+                options.isas = {Geometry::KernelIsa::Scalar};
+            }
+            else if(isa == "sse4.1"){
+                options.isas = {Geometry::KernelIsa::SSE41};
+            }
+            else if(isa == "avx2"){
+                options.isas = {Geometry::KernelIsa::AVX2};
+            }
+            else{
+                std::cerr << "Unknown instruction set: " << isa << "\n";
+                return -1;
+            }
+        }
+        else if(!std::strcmp(current, "--no-png")){
+            options.png = false;
+        }
+        else if(!std::strcmp(current, "--keep-png") && has_value){
+            options.keep_png = argv[++arg];
+        }
+        else if(!std::strcmp(current, "--csv")){
+            options.csv = true;
+        }
+        else{
+            std::cerr << "Unknown option: " << current << "\n";
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if(options.isas.empty()){
+        options.isas = {Geometry::detectKernelIsa()};
+    }
+
+    Utils::WorkStealingPool pool(options.threads);
+    std::vector<BenchResult> results;
+    for(const std::string& generator : options.generators){
+        std::vector<std::vector<double>> strips;
+        if(generator == "walk"){
+            Geometry::generateRandomWalks(strips, options.vertices);
+        }
+        else if(generator == "spiral"){
+            Geometry::generateSpirals(strips, options.vertices);
+        }
+        else{
+            Geometry::generateScribbles(strips, options.vertices);
+        }
+
+        for(Geometry::KernelIsa isa : options.isas){
+            Geometry::setKernelIsa(isa);
+            if(Geometry::activeKernelIsa() != isa){
+                std::cerr << Geometry::kernelIsaName(isa) << ": not supported, skipped\n";
+                continue;
+            }
+            benchDrawing(generator, strips, options, isa, pool, results);
+        }
+    }
+    printResults(results, options.csv);
+    return 0;
+}
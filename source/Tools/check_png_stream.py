@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""
+Round trip check of the hand-written DEFLATE of Export::PngStreamWriter against zlib.
+
+SphereBench encodes the same rasters with stb_image_write and with the streaming writer(in bands of rows like the
+tiled export) and keeps both files with --keep-png. Both are decoded here with zlib, which also checks the Adler-32
+of the stream, and the chunk CRCs are verified, the pixels have to be identical.
+
+Usage: check_png_stream.py <path to SphereBench>
+"""
+
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+SIZES = ["1920x1080", "257x131", "1x300", "4096x20"]
+GENERATORS = ["walk", "spiral", "scribble"]
+
+
+def read_png(path):
+    with open(path, "rb") as file:
+        data = file.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError("bad signature")
+    position, idat = 8, b""
+    width = height = channels = None
+    while position < len(data):
+        length, kind = struct.unpack(">I4s", data[position:position + 8])
+        body = data[position + 8:position + 8 + length]
+        crc, = struct.unpack(">I", data[position + 8 + length:position + 12 + length])
+        if zlib.crc32(kind + body) & 0xffffffff != crc:
+            raise ValueError("bad CRC of a %s chunk" % kind.decode())
+        if kind == b"IHDR":
+            width, height, depth, color = struct.unpack(">IIBB", body[:10])
+            if depth != 8 or color not in (2, 6):
+                raise ValueError("unexpected format")
+            channels = 3 if color == 2 else 4
+        elif kind == b"IDAT":
+            idat += body
+        elif kind == b"IEND":
+            break
+        position += 12 + length
+
+    raw = zlib.decompress(idat)
+    stride = width * channels
+    if len(raw) != height * (stride + 1):
+        raise ValueError("%d bytes inflated, %d expected" % (len(raw), height * (stride + 1)))
+    return unfilter(raw, width, height, channels)
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def unfilter(raw, width, height, channels):
+    stride = width * channels
+    pixels = bytearray(height * stride)
+    previous = bytearray(stride)
+    for row in range(height):
+        kind = raw[row * (stride + 1)]
+        line = bytearray(raw[row * (stride + 1) + 1:(row + 1) * (stride + 1)])
+        for i in range(stride):
+            left = line[i - channels] if i >= channels else 0
+            up = previous[i]
+            up_left = previous[i - channels] if i >= channels else 0
+            if kind == 1:
+                line[i] = (line[i] + left) & 0xff
+            elif kind == 2:
+                line[i] = (line[i] + up) & 0xff
+            elif kind == 3:
+                line[i] = (line[i] + ((left + up) >> 1)) & 0xff
+            elif kind == 4:
+                line[i] = (line[i] + paeth(left, up, up_left)) & 0xff
+            elif kind != 0:
+                raise ValueError("bad filter %d" % kind)
+        pixels[row * stride:(row + 1) * stride] = line
+        previous = line
+    return width, height, bytes(pixels)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip())
+        return 2
+    bench = sys.argv[1]
+    failed = 0
+    with tempfile.TemporaryDirectory() as directory:
+        for size in SIZES:
+            subprocess.run([bench, "-n", "20000", "-i", "1", "-s", size, "--keep-png", directory],
+                           check=True, stdout=subprocess.DEVNULL)
+            for generator in GENERATORS:
+                try:
+                    reference = read_png(os.path.join(directory, generator + ".png"))
+                    streamed = read_png(os.path.join(directory, generator + ".stream.png"))
+                    ok = reference == streamed
+                    message = "" if ok else " pixels differ"
+                except (ValueError, zlib.error) as error:
+                    ok, message = False, " " + str(error)
+                failed += not ok
+                print("%s %s: %s%s" % (size, generator, "ok" if ok else "FAILED", message))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,95 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+	#include <fstream>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Utils{
+	MappedFile::MappedFile(const std::string& filePath){
+#if defined(_WIN32)
+		std::ifstream file(filePath, std::ios::in | std::ios::binary | std::ios::ate);
+		if(!file.is_open()){
+			return;
+		}
+		std::streamoff length = file.tellg();
+		if(length > 0){
+			char* buffer = new char[(size_t)length];
+			file.seekg(0);
+			if(!file.read(buffer, length)){
+				delete[] buffer;
+				return;
+			}
+			data = buffer;
+			size = (size_t)length;
+		}
+		open = true;
+#else
+		int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+		if(fd < 0){
+			return;
+		}
+		struct stat info;
+		if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)){
+			::close(fd);
+			return;
+		}
+		/* Zero length mappings are invalid, an empty file just has an empty view */
+		if(info.st_size > 0){
+			void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(address == MAP_FAILED){
+				::close(fd);
+				return;
+			}
+			/* Assets are read once front to back */
+			madvise(address, (size_t)info.st_size, MADV_SEQUENTIAL);
+			data = static_cast<const char*>(address);
+			size = (size_t)info.st_size;
+			mapped = true;
+		}
+		/* The mapping keeps the file referenced */
+		::close(fd);
+		open = true;
+#endif
+	}
+	MappedFile::~MappedFile(){
+		release();
+	}
+	MappedFile::MappedFile(MappedFile&& other) noexcept : data(other.data), size(other.size), open(other.open), mapped(other.mapped){
+		other.data = nullptr;
+		other.size = 0;
+		other.open = false;
+		other.mapped = false;
+	}
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept{
+		if(this != &other){
+			release();
+			data = other.data;
+			size = other.size;
+			open = other.open;
+			mapped = other.mapped;
+			other.data = nullptr;
+			other.size = 0;
+			other.open = false;
+			other.mapped = false;
+		}
+		return *this;
+	}
+	void MappedFile::release(){
+#if defined(_WIN32)
+		delete[] data;
+#else
+		if(mapped){
+			munmap(const_cast<char*>(data), size);
+		}
+#endif
+		data = nullptr;
+		size = 0;
+		open = false;
+		mapped = false;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Utils{
+	/*
+		Read-only view of a whole file. The file is memory mapped, so reading it does not copy anything and the
+		pages are shared with the OS file cache(platforms without mmap get a plain read into a buffer).
+		The view stays valid as long as the object lives.
+	*/
+	class MappedFile{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& filePath);
+		~MappedFile();
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/* False if the file could not be opened, an empty file is open with an empty view */
+		bool isOpen() const { return open; }
+
+		std::string_view view() const { return std::string_view(data, size); }
+		const char* getData() const { return data; }
+		size_t getSize() const { return size; }
+
+	private:
+		const char* data = nullptr;
+		size_t size = 0;
+		bool open = false;
+		bool mapped = false;
+
+		void release();
+	};
+}
@@ -0,0 +1,132 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <set>
+
+namespace Utils{
+	static const std::chrono::steady_clock::time_point EPOCH = std::chrono::steady_clock::now();
+	static std::atomic<uint32_t> next_track{1};
+
+	Profiler& Profiler::global(){
+		static Profiler profiler;
+		return profiler;
+	}
+	Profiler::Profiler() : slots(new Slot[CAPACITY]){
+	}
+	uint64_t Profiler::now(){
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - EPOCH).count();
+	}
+	void Profiler::record(const char* name, uint64_t start_ns, uint64_t duration_ns){
+		thread_local uint32_t thread_track = next_track.fetch_add(1, std::memory_order_relaxed);
+
+		ProfileSample sample;
+		sample.name = name;
+		sample.start_ns = start_ns;
+		sample.duration_ns = duration_ns;
+		sample.frame = getFrame();
+		sample.track = thread_track;
+		push(sample);
+	}
+	void Profiler::recordGpu(const char* name, uint64_t start_ns, uint64_t duration_ns, uint32_t frame){
+		ProfileSample sample;
+		sample.name = name;
+		sample.start_ns = start_ns;
+		sample.duration_ns = duration_ns;
+		sample.frame = frame;
+		sample.track = 0;
+		push(sample);
+	}
+	void Profiler::push(const ProfileSample& sample){
+		if(!isEnabled()){
+			return;
+		}
+		uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+		Slot& slot = slots[index & (CAPACITY - 1)];
+		slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(sample.name, std::memory_order_relaxed);
+		slot.start_ns.store(sample.start_ns, std::memory_order_relaxed);
+		slot.duration_ns.store(sample.duration_ns, std::memory_order_relaxed);
+		slot.frame.store(sample.frame, std::memory_order_relaxed);
+		slot.track.store(sample.track, std::memory_order_relaxed);
+		slot.sequence.store(2 * index + 2, std::memory_order_release);
+	}
+	void Profiler::clear(){
+		cleared.store(head.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+	std::vector<ProfileSample> Profiler::snapshot() const{
+		uint64_t end = head.load(std::memory_order_acquire);
+		uint64_t begin = std::max(cleared.load(std::memory_order_relaxed), end > CAPACITY ? end - CAPACITY : 0);
+
+		std::vector<ProfileSample> samples;
+		samples.reserve(end - begin);
+		for(uint64_t index = begin; index < end; ++index){
+			const Slot& slot = slots[index & (CAPACITY - 1)];
+			/* Skip the slots that are being written or were already reused by a newer sample */
+			uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			if(sequence != 2 * index + 2){
+				continue;
+			}
+			ProfileSample sample;
+			sample.name = slot.name.load(std::memory_order_relaxed);
+			sample.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+			sample.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+			sample.frame = slot.frame.load(std::memory_order_relaxed);
+			sample.track = slot.track.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(slot.sequence.load(std::memory_order_relaxed) != sequence){
+				continue;
+			}
+			samples.push_back(sample);
+		}
+		return samples;
+	}
+	bool Profiler::writeCsv(const std::string& filePath) const{
+		FILE* file = std::fopen(filePath.c_str(), "wb");
+		if(!file){
+			std::cerr << "Failed to create profile file: " << filePath << "\n";
+			return false;
+		}
+		std::fputs("frame,track,stage,start_us,duration_us\n", file);
+		for(const ProfileSample& sample : snapshot()){
+			std::fprintf(file, "%u,%s%u,%s,%.3f,%.3f\n", sample.frame, sample.track == 0 ? "gpu" : "cpu", sample.track,
+						 sample.name, sample.start_ns / 1000.0, sample.duration_ns / 1000.0);
+		}
+		bool ok = std::ferror(file) == 0;
+		ok = std::fclose(file) == 0 && ok;
+		return ok;
+	}
+	bool Profiler::writeChromeTrace(const std::string& filePath) const{
+		FILE* file = std::fopen(filePath.c_str(), "wb");
+		if(!file){
+			std::cerr << "Failed to create profile file: " << filePath << "\n";
+			return false;
+		}
+		std::vector<ProfileSample> samples = snapshot();
+		std::set<uint32_t> tracks;
+		for(const ProfileSample& sample : samples){
+			tracks.insert(sample.track);
+		}
+
+		std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+		bool first = true;
+		for(uint32_t track : tracks){
+			std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+						 first ? "" : ",\n", track, track == 0 ? "GPU" : "CPU thread", track);
+			first = false;
+		}
+		for(const ProfileSample& sample : samples){
+			std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+						 first ? "" : ",\n", sample.name, sample.track, sample.start_ns / 1000.0, sample.duration_ns / 1000.0, sample.frame);
+			first = false;
+		}
+		std::fputs("\n]}\n", file);
+
+		bool ok = std::ferror(file) == 0;
+		ok = std::fclose(file) == 0 && ok;
+		return ok;
+	}
+}
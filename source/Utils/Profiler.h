@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Utils{
+	struct ProfileSample{
+		/* Stage name, has to be a string literal(only the pointer is stored) */
+		const char* name = nullptr;
+		uint64_t start_ns = 0, duration_ns = 0;
+		uint32_t frame = 0;
+		/* 0 is the GPU, CPU threads are numbered from 1 in the order they first record something */
+		uint32_t track = 0;
+	};
+
+	/*
+		Collects timing samples of the frame loop into a fixed size ring. Recording is lock-free and wait-free:
+		a writer claims a slot with one fetch_add and publishes it through the slot's sequence number, so the
+		render thread and the encoder threads can record at the same time. When disabled, a scope costs one
+		relaxed atomic load. Old samples are overwritten once the ring is full.
+	*/
+	class Profiler{
+	public:
+		static const size_t CAPACITY = 1 << 16;
+
+		/* The process wide profiler all the scopes write to */
+		static Profiler& global();
+
+		Profiler();
+
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		void setEnabled(bool enabled){ this->enabled.store(enabled, std::memory_order_relaxed); }
+		bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+		void beginFrame(){ frame.fetch_add(1, std::memory_order_relaxed); }
+		uint32_t getFrame() const { return frame.load(std::memory_order_relaxed); }
+
+		void record(const char* name, uint64_t start_ns, uint64_t duration_ns);
+		/* GPU results arrive frames later, so they carry the frame they were issued in */
+		void recordGpu(const char* name, uint64_t start_ns, uint64_t duration_ns, uint32_t frame);
+		void clear();
+
+		/* Nanoseconds of the steady clock since the profiler was created */
+		static uint64_t now();
+
+		/* Samples still in the ring, from the oldest one */
+		std::vector<ProfileSample> snapshot() const;
+
+		bool writeCsv(const std::string& filePath) const;
+		/* chrome://tracing / Perfetto "Trace Event" JSON */
+		bool writeChromeTrace(const std::string& filePath) const;
+
+	private:
+		/* The fields are relaxed atomics, a reader racing with a writer gets torn values it throws away, never a data race */
+		struct Slot{
+			/* 2 * index + 1 while the sample is written, 2 * index + 2 when it is complete */
+			std::atomic<uint64_t> sequence{0};
+			std::atomic<const char*> name{nullptr};
+			std::atomic<uint64_t> start_ns{0}, duration_ns{0};
+			std::atomic<uint32_t> frame{0}, track{0};
+		};
+
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<uint64_t> head{0}, cleared{0};
+		std::atomic<uint32_t> frame{0};
+		std::atomic<bool> enabled{false};
+
+		void push(const ProfileSample& sample);
+	};
+
+	/* Times the enclosing block on the CPU */
+	class ProfileScope{
+	public:
+		explicit ProfileScope(const char* name) : name(Profiler::global().isEnabled() ? name : nullptr){
+			if(this->name){
+				start = Profiler::now();
+			}
+		}
+		~ProfileScope(){
+			if(name){
+				Profiler::global().record(name, start, Profiler::now() - start);
+			}
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		const char* name;
+		uint64_t start = 0;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) Utils::ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
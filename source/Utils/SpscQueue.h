@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Utils{
+	/*
+		Bounded lock-free queue for exactly one producer and one consumer. push() and pop() never block or allocate,
+		so the producer can be an input callback that must return right away. Capacity is rounded up to a power of two.
+	*/
+	template<typename T>
+	class SpscQueue{
+	public:
+		explicit SpscQueue(size_t capacity = 4096){
+			size_t size = 2;
+			while(size < capacity){
+				size *= 2;
+			}
+			mask = size - 1;
+			items.reset(new T[size]);
+		}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		/* Producer side, returns false if the queue is full */
+		bool push(const T& item){
+			size_t tail_now = tail.load(std::memory_order_relaxed);
+			if(tail_now - cached_head > mask){
+				cached_head = head.load(std::memory_order_acquire);
+				if(tail_now - cached_head > mask){
+					return false;
+				}
+			}
+			items[tail_now & mask] = item;
+			tail.store(tail_now + 1, std::memory_order_release);
+			return true;
+		}
+
+		/* Consumer side, returns false if the queue is empty */
+		bool pop(T& item){
+			size_t head_now = head.load(std::memory_order_relaxed);
+			if(head_now == cached_tail){
+				cached_tail = tail.load(std::memory_order_acquire);
+				if(head_now == cached_tail){
+					return false;
+				}
+			}
+			item = items[head_now & mask];
+			head.store(head_now + 1, std::memory_order_release);
+			return true;
+		}
+
+		size_t capacity() const { return mask + 1; }
+
+	private:
+		std::unique_ptr<T[]> items;
+		size_t mask;
+
+		/* Producer and consumer indices live on separate cache lines, each side caches the other one's index */
+		alignas(64) std::atomic<size_t> head{0};
+		size_t cached_tail = 0;
+		alignas(64) std::atomic<size_t> tail{0};
+		size_t cached_head = 0;
+	};
+}
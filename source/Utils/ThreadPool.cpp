@@ -0,0 +1,76 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace Utils{
+	ThreadPool::ThreadPool(size_t threads, size_t maxQueued) : max_queued(maxQueued){
+		if(threads == 0){
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		workers.reserve(threads);
+		for(size_t i = 0; i < threads; ++i){
+			workers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+	ThreadPool::~ThreadPool(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		task_added.notify_all();
+		for(std::thread& worker : workers){
+			worker.join();
+		}
+	}
+	bool ThreadPool::trySubmit(std::function<void()> task){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(max_queued != 0 && tasks.size() >= max_queued){
+				return false;
+			}
+			tasks.push_back(std::move(task));
+		}
+		task_added.notify_one();
+		return true;
+	}
+	void ThreadPool::submit(std::function<void()> task){
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			task_taken.wait(lock, [this](){ return max_queued == 0 || tasks.size() < max_queued; });
+			tasks.push_back(std::move(task));
+		}
+		task_added.notify_one();
+	}
+	void ThreadPool::waitIdle(){
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this](){ return tasks.empty() && running == 0; });
+	}
+	bool ThreadPool::isFull() const{
+		std::lock_guard<std::mutex> lock(mutex);
+		return max_queued != 0 && tasks.size() >= max_queued;
+	}
+	void ThreadPool::workerLoop(){
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true){
+			task_added.wait(lock, [this](){ return stopping || !tasks.empty(); });
+			if(tasks.empty()){
+				/* Stopping and nothing left to do, queued tasks are always finished before the pool goes away */
+				return;
+			}
+
+			std::function<void()> task = std::move(tasks.front());
+			tasks.pop_front();
+			++running;
+			lock.unlock();
+			task_taken.notify_one();
+
+			task();
+
+			lock.lock();
+			--running;
+			if(tasks.empty() && running == 0){
+				idle.notify_all();
+			}
+		}
+	}
+}
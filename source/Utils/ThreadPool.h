@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils{
+	/*
+		Fixed set of worker threads with a bounded FIFO task queue. trySubmit() never blocks and reports
+		a full queue, so a producer that must not stall(the render loop) can apply backpressure itself.
+	*/
+	class ThreadPool{
+	public:
+		/* threads == 0 uses all hardware threads, maxQueued == 0 means an unbounded queue */
+		explicit ThreadPool(size_t threads = 0, size_t maxQueued = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/* Queues the task if there is room for it, returns false otherwise */
+		bool trySubmit(std::function<void()> task);
+
+		/* Queues the task, blocking while the queue is full */
+		void submit(std::function<void()> task);
+
+		/* Blocks until the queue is empty and no task is running */
+		void waitIdle();
+
+		bool isFull() const;
+		size_t getThreadCount() const { return workers.size(); }
+
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> tasks;
+		size_t max_queued, running = 0;
+		bool stopping = false;
+
+		mutable std::mutex mutex;
+		std::condition_variable task_added, task_taken, idle;
+
+		void workerLoop();
+	};
+}
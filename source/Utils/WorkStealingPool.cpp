@@ -0,0 +1,116 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+namespace Utils{
+	/* Set while a thread runs a task, nested loops run inline instead of waiting for the busy pool */
+	static thread_local bool inside_task = false;
+
+	WorkStealingPool::WorkStealingPool(size_t threads){
+		if(threads == 0){
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		queues.reserve(threads);
+		for(size_t i = 0; i < threads; ++i){
+			queues.push_back(std::make_unique<TaskQueue>());
+		}
+		/* Queue 0 belongs to the calling thread */
+		workers.reserve(threads - 1);
+		for(size_t i = 1; i < threads; ++i){
+			workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+		}
+	}
+	WorkStealingPool::~WorkStealingPool(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(std::thread& worker : workers){
+			worker.join();
+		}
+	}
+	void WorkStealingPool::parallelFor(size_t count, const std::function<void(size_t)>& task){
+		if(count == 0){
+			return;
+		}
+		if(inside_task || workers.empty() || count == 1){
+			for(size_t i = 0; i < count; ++i){
+				task(i);
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> run_lock(run_mutex);
+		job = &task;
+		remaining.store(count, std::memory_order_relaxed);
+
+		/* Contiguous runs keep neighbouring tasks(and the memory they touch) on one thread until stolen */
+		size_t threads = queues.size();
+		for(size_t q = 0; q < threads; ++q){
+			std::lock_guard<std::mutex> lock(queues[q]->mutex);
+			for(size_t i = q * count / threads; i < (q + 1) * count / threads; ++i){
+				queues[q]->tasks.push_back(i);
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++generation;
+		}
+		wake.notify_all();
+
+		work(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this](){ return remaining.load(std::memory_order_acquire) == 0; });
+		job = nullptr;
+	}
+	bool WorkStealingPool::takeTask(size_t self, size_t& task){
+		{
+			TaskQueue& own = *queues[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if(!own.tasks.empty()){
+				task = own.tasks.front();
+				own.tasks.pop_front();
+				return true;
+			}
+		}
+		/* Steal the far end of a victim's run, the part its owner would reach last */
+		for(size_t step = 1; step < queues.size(); ++step){
+			TaskQueue& victim = *queues[(self + step) % queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if(!victim.tasks.empty()){
+				task = victim.tasks.back();
+				victim.tasks.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+	void WorkStealingPool::work(size_t self){
+		inside_task = true;
+		size_t task;
+		while(takeTask(self, task)){
+			(*job)(task);
+			if(remaining.fetch_sub(1, std::memory_order_acq_rel) == 1){
+				std::lock_guard<std::mutex> lock(mutex);
+				done.notify_all();
+			}
+		}
+		inside_task = false;
+	}
+	void WorkStealingPool::workerLoop(size_t self){
+		size_t seen = 0;
+		while(true){
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&](){ return stopping || generation != seen; });
+				if(stopping){
+					return;
+				}
+				seen = generation;
+			}
+			work(self);
+		}
+	}
+}
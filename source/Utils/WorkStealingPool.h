@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils{
+	/*
+		Fork-join pool for data parallel loops. parallelFor() deals the task indices out in contiguous runs, one
+		deque per thread, every thread takes its own tasks from the front and steals from the back of the others
+		once it runs dry, so uneven tasks(long strokes, many seam splits) even out without a central queue.
+		The calling thread works too and the call returns when every task has finished.
+	*/
+	class WorkStealingPool{
+	public:
+		/* threads == 0 uses all hardware threads, the caller counts as one of them */
+		explicit WorkStealingPool(size_t threads = 0);
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+		/* Runs task(i) for every i in [0, count). Calls from several threads run one after another, a call from
+		   inside a task runs its loop inline */
+		void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+		size_t getThreadCount() const { return queues.size(); }
+
+	private:
+		struct alignas(64) TaskQueue{
+			std::mutex mutex;
+			std::deque<size_t> tasks;
+		};
+
+		std::vector<std::unique_ptr<TaskQueue>> queues;
+		std::vector<std::thread> workers;
+
+		const std::function<void(size_t)>* job = nullptr;
+		std::atomic<size_t> remaining{0};
+
+		/* Serializes parallelFor() callers */
+		std::mutex run_mutex;
+
+		std::mutex mutex;
+		std::condition_variable wake, done;
+		size_t generation = 0;
+		bool stopping = false;
+
+		bool takeTask(size_t self, size_t& task);
+		void work(size_t self);
+		void workerLoop(size_t self);
+	};
+}
@@ -7,26 +7,54 @@
 #include <filesystem>
 #include <vector>
 #include <math.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <memory>
 
 #include "Renderer/ShaderProgram.h"
+#include "Renderer/CameraUniforms.h"
+#include "Renderer/StaticMesh.h"
+#include "Renderer/StrokeStore.h"
+#include "Renderer/ImageExporter.h"
+#include "Renderer/OffscreenTarget.h"
+#include "Renderer/TiledRenderer.h"
+#include "Renderer/GpuTimer.h"
+#include "Renderer/FrameScheduler.h"
 #include "ResourceMan/ResourceManager.h"
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
-
-#define PI 3.14159265358
+#include "Geometry/SphereUnfold.h"
+#include "Geometry/UnfoldKernel.h"
+#include "Geometry/StrokeBuilder.h"
+#include "Geometry/StrokeSimplifier.h"
+#include "Geometry/IncrementalUnfolder.h"
+#include "Geometry/SessionLog.h"
+#include "Geometry/Projections.h"
+#include "Geometry/SphereIndex.h"
+#include "Geometry/StrokeArena.h"
+#include "Geometry/DrawingHistory.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/Profiler.h"
+#include "Utils/SpscQueue.h"
+#include "Export/VectorWriter.h"
+
+using Geometry::S_RADIUS;
+using Geometry::camera_y_shift;
 
 /*  
-    Some useful constants for configuring render window, radius of a sphere to draw on, camera vertical shift, 
-    orthogonal projection, and mouse sensetivity
+    Some useful constants for configuring render window, orthogonal projection, and mouse sensetivity
+    (radius of a sphere to draw on and camera vertical shift live in Geometry/SphereUnfold.h)
 */
 const int WIDTH = 1920, HEIGHT = 1080;
-const double S_RADIUS = 0.7f;
-const double camera_y_shift = 1.0f;
 const float scale = 1.9;
 const float aspect = (float)(WIDTH) / (float)(HEIGHT);
 const float MOUSE_SENS = 0.07f;
 
+/* Exports bigger than this on any side are rendered tile by tile */
+const int MAX_EXPORT_TILE = 4096;
+
 /* Camera initial configurations */
 glm::vec3 cameraPos = glm::vec3(0.0f, camera_y_shift, 0.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -45,18 +73,126 @@ float lastFrame = 0.0f;
 
 /* Some variables-indicators*/
 bool firstMouse = true, left_pressed = false, p_pressed = false, save_render = false, to_clear = false;
+/* A movement key is held: the camera moves every frame without any new events */
+bool moving = false;
+bool f9_pressed = false, toggle_profiler = false;
+/* Live preview of the unfolded drawing next to the sphere view, V toggles it */
+bool split_view = true, v_pressed = false;
+/* Projection the sphere view draws the strokes with, unfolded on the GPU: 0 sphere, 1 cylinder, 2 plane. M cycles it */
+int stroke_mode = 0;
+bool m_pressed = false;
+/* Eraser tool, E toggles it: holding the left button erases the segments under the crosshair, Shift + click
+   erases the whole stroke closest to it */
+bool eraser_mode = false, e_pressed = false, erase_stroke = false;
+const double ERASER_RADIUS = 0.02, PICK_RADIUS = 0.05;
+/* Ctrl + Z steps back through the history of the drawing, Ctrl + Y(or Ctrl + Shift + Z) forward again */
+int history_step = 0;
+bool z_pressed = false, y_pressed = false;
+const size_t HISTORY_DEPTH = 100;
+/* Width of the strokes in pixels, on the screen and in saved projections */
+const float LINE_WIDTH = 3.0f;
+/* Half height of the orthogonal "photo", fitted to the map when saved projections use another one than the cylinder */
+float photo_scale = scale;
+
+/*
+    Drawing input is captured per input event, not per frame: the mouse callbacks push timestamped camera
+    orientations into a lock-free queue, and the frame loop feeds them to the stroke builder, which places
+    vertices at a fixed angular step. Stroke quality does not depend on the frame rate this way.
+*/
+struct InputEvent{
+    enum Type{
+        Press,
+        Move,
+        Release
+    } type;
+    Geometry::StrokeSample sample;
+};
+Utils::SpscQueue<InputEvent> input_events(1 << 14);
+const double STROKE_ANGULAR_STEP = 0.002;
+
+/* A saved projection being unfolded on an encoder thread from a snapshot of the drawing, which goes on meanwhile */
+struct PhotoJob{
+    /* The drawing, or the strips the incremental unfolder made of it already(the cylinder projection) */
+    Geometry::StrokeArena::Snapshot drawing;
+    Geometry::StrokeBuffer unfolded;
+    std::atomic<bool> done{false};
+    /* The drawing was cleared before the task finished, the result is thrown away */
+    bool dropped = false;
+};
+
+/* Frames are drawn only when the callbacks or the loop marked something as changed */
+Renderer::FrameScheduler frameScheduler;
  
 /* Functions/callbacks declarations*/
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+void window_refresh_callback(GLFWwindow *window);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn); 
-void processInput(GLFWwindow *window, std::vector<std::vector<double>>& p_to_draw);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void processInput(GLFWwindow *window);
+void pushInputEvent(InputEvent::Type type);
 
-void project_points(std::vector<std::vector<double>>& strips);
-void fill_strip_vector(std::vector<std::vector<double>>& strips);
-void saveImage(const char* filepath, GLFWwindow* window);
+void fill_strip_vector(Geometry::StrokeArena& strips);
+void dumpProfile();
+void saveImage(Renderer::ImageExporter& exporter, Renderer::TiledRenderer& tiledRenderer, Renderer::OffscreenTarget& target, const std::string& filepath, int width, int height,
+               const std::function<void(const glm::mat4&)>& drawScene);
 
 int main(int argc, char** argv)
 {       
+    /* Resolution of saved projections, the window's framebuffer size if not set with --export-size WxH */
+    int export_width = 0, export_height = 0;
+    /* Optional vector copy of every saved projection: "svg" or "spl"(binary polylines) */
+    std::string export_vector;
+    /* Geodesic error bound of the stroke simplification in radians(0 keeps every vertex), and whether the
+       unsimplified strokes are kept for saved projections */
+    double simplify_tolerance = 0.0005;
+    bool keep_raw = false;
+    /* Binary log the drawing is appended to while it is drawn, its last drawing is restored at startup */
+    std::string session_path;
+    bool gpu_preview = false;
+    /* Map projection of saved projections, the live preview always shows the cylinder unroll */
+    Geometry::Projection projection = Geometry::Projection::Cylinder;
+    for(int arg = 1; arg < argc; ++arg){
+        if(!std::strcmp(argv[arg], "--export-size") && arg + 1 < argc){
+            if(std::sscanf(argv[++arg], "%dx%d", &export_width, &export_height) != 2 || export_width <= 0 || export_height <= 0){
+                std::cout << "Bad export size: " << argv[arg] << "\n";
+                return -1;
+            }
+        }
+        else if(!std::strcmp(argv[arg], "--profile")){
+            /* Frame profiling from the start, F9 toggles it at runtime */
+            Utils::Profiler::global().setEnabled(true);
+        }
+        else if(!std::strcmp(argv[arg], "--simplify") && arg + 1 < argc){
+            simplify_tolerance = std::max(0.0, std::atof(argv[++arg]));
+        }
+        else if(!std::strcmp(argv[arg], "--keep-raw")){
+            keep_raw = true;
+        }
+        else if(!std::strcmp(argv[arg], "--no-preview")){
+            split_view = false;
+        }
+        else if(!std::strcmp(argv[arg], "--session") && arg + 1 < argc){
+            session_path = argv[++arg];
+        }
+        else if(!std::strcmp(argv[arg], "--projection") && arg + 1 < argc){
+            if(!Geometry::parseProjection(argv[++arg], projection)){
+                std::cout << "Unknown projection: " << argv[arg] << "\n";
+                return -1;
+            }
+        }
+        else if(!std::strcmp(argv[arg], "--gpu-preview")){
+            /* The preview is unfolded by the shader from the sphere strokes instead of uploading the CPU result */
+            gpu_preview = true;
+        }
+        else if(!std::strcmp(argv[arg], "--export-vector") && arg + 1 < argc){
+            export_vector = argv[++arg];
+            if(export_vector != "svg" && export_vector != "spl"){
+                std::cout << "Unknown vector format: " << export_vector << "\n";
+                return -1;
+            }
+        }
+    }
+
     /* Initialize the library */
     if (!glfwInit())
         return -1;
@@ -84,11 +220,20 @@ int main(int argc, char** argv)
 
     /* Make the window's context current and set all callbacks*/
     glfwMakeContextCurrent(window);
+    /* Continuous redraws(moving camera, drawing) are paced by the display instead of spinning */
+    glfwSwapInterval(1);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    /* Unaccelerated motion events straight from the device, every one of them becomes an orientation sample */
+    if(glfwRawMouseMotionSupported()){
+        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+    }
+
     if(!gladLoadGL())
     {
         std::cout << "Can't load GLAD!\n";
@@ -96,11 +241,11 @@ int main(int argc, char** argv)
     }
     
     std::cout << GLVersion.major << "." << GLVersion.minor << "\n";
+    std::cout << "Unfold kernels: " << Geometry::kernelIsaName(Geometry::activeKernelIsa()) << "\n";
     
-    /* Some OpenGL configuration: Z-test, line smoothness, and line width */
+    /* Some OpenGL configuration: Z-test, and blending for the anti-aliased edges of the strokes(enabled while they are drawn) */
     glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LINE_SMOOTH);
-    glLineWidth(3.0f);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     /* Target box vertex coordinates & color atributes*/
     float vertices[] = {
@@ -148,35 +293,151 @@ int main(int argc, char** argv)
         -0.5f,  0.5f, -0.5f,    0.2f, 0.6f, 0.3f
     };
 
+    /* Just add the floor to a scene for more comfortable orientation in the environment*/
+    float floor_vertices[] = {
+         10.0f, -0.1f,  10.0f,      0.0f, 0.0f, 0.0f,
+         10.0f, -0.1f, -10.0f,      0.5f, 0.5f, 0.5f,
+        -10.0f, -0.1f, -10.0f,      1.0f, 1.0f, 1.0f,
+        -10.0f, -0.1f,  10.0f,      0.5f, 0.5f, 0.5f,
+         10.0f, -0.1f,  10.0f,      0.0f, 0.0f, 0.0f
+    };
+
     {
-        /* Creating resource manager to work with all the resources(shaders for now)*/
+        /* Renders are read back through PBOs and compressed to PNG on background threads, the queue is bounded
+           so a burst of saves can not pile up unwritten frames in memory. Until then the threads load assets */
+        Utils::ThreadPool encoders(2, 4);
+
+        /* Creating resource manager to work with all the resources(shaders for now). Files are mapped and hashed
+           on the pool, the programs are created here on the context thread */
         ResourceManager resourceManager(argv[0]);
-        auto defaultShaderProgram = resourceManager.loadShaderProgram("DefaultShaderProgram", "resources/shaders/vertexShader.vs", "resources/shaders/fragmentShader.fs");
+        auto shaderPrograms = resourceManager.loadShaderProgramsAsync({
+            {"DefaultShaderProgram", "resources/shaders/vertexShader.vs", "resources/shaders/fragmentShader.fs"},
+            {"UnfoldShaderProgram", "resources/shaders/UnfoldShader.vs", "resources/shaders/FragmentShader.fs", "resources/shaders/UnfoldShader.gs"},
+            {"LineShaderProgram", "resources/shaders/LineShader.vs", "resources/shaders/LineShader.fs"}
+        }, encoders);
+        resourceManager.finishPendingLoads();
+        auto defaultShaderProgram = shaderPrograms[0].get();
+        GLint world_t_location = defaultShaderProgram->getUniformLocation("world_t");
+
+        /* Same strokes, mapped to the cylinder or the plane per vertex and split on the seam per segment, so
+           switching the projection does not touch the uploaded vertices */
+        auto unfoldShaderProgram = shaderPrograms[1].get();
+        GLint unfold_world_t_location = -1, unfold_mode_location = -1;
+        if(unfoldShaderProgram){
+            unfold_world_t_location = unfoldShaderProgram->getUniformLocation("world_t");
+            unfold_mode_location = unfoldShaderProgram->getUniformLocation("unfold_mode");
+            unfoldShaderProgram->use();
+            unfoldShaderProgram->setFloat("s_radius", (float)S_RADIUS);
+            unfoldShaderProgram->setFloat("camera_y_shift", (float)camera_y_shift);
+        }
+        else{
+            gpu_preview = false;
+        }
+
+        /* Strokes as screen space quads with round caps and anti-aliased edges(wide lines are not in the core
+           profile), with the unfold of the program above. Without it they fall back to one pixel line strips */
+        auto lineShaderProgram = shaderPrograms[2].get();
+        GLint line_world_t_location = -1, line_mode_location = -1, line_viewport_location = -1;
+        if(lineShaderProgram){
+            line_world_t_location = lineShaderProgram->getUniformLocation("world_t");
+            line_mode_location = lineShaderProgram->getUniformLocation("unfold_mode");
+            line_viewport_location = lineShaderProgram->getUniformLocation("viewport");
+            lineShaderProgram->use();
+            lineShaderProgram->setFloat("line_width", LINE_WIDTH);
+            lineShaderProgram->setFloat("s_radius", (float)S_RADIUS);
+            lineShaderProgram->setFloat("camera_y_shift", (float)camera_y_shift);
+        }
 
-        /* Creating and configuring VBO and VAO to */
-        unsigned int VBO, VAO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
+        /* View and projection go to a uniform buffer shared by all programs, only the model matrix is per draw */
+        Renderer::CameraUniforms cameraUniforms;
 
-        glBindVertexArray(VAO);
+        /* Static geometry is uploaded once, drawn strips are appended to the GPU stroke store as they grow */
+        Renderer::StaticMesh box(vertices, sizeof(vertices) / (6 * sizeof(float)), GL_TRIANGLES);
+        Renderer::StaticMesh floor(floor_vertices, sizeof(floor_vertices) / (6 * sizeof(float)), GL_TRIANGLE_STRIP);
+        Renderer::StrokeStore strokeStore;
+        Renderer::StrokeStore previewStore;
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        Renderer::ImageExporter exporter(encoders);
+        Renderer::TiledRenderer tiledRenderer(encoders);
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        /* Projections are rendered offscreen, so their size does not depend on the display */
+        if(export_width == 0){
+            glfwGetFramebufferSize(window, &export_width, &export_height);
+        }
+        int tile_size = std::min(MAX_EXPORT_TILE, Renderer::OffscreenTarget::maxSize());
+        Renderer::GpuTimer gpuTimer;
+        Renderer::OffscreenTarget exportTarget(std::min(export_width, tile_size), std::min(export_height, tile_size));
+
+        /* The drawing: strokes grow in pooled extents of chunk arenas, so drawing for a long time does not keep
+           allocating, and every stage reads them in place */
+        Geometry::StrokeArena points_to_draw;
+
+        Geometry::StrokeBuilder strokeBuilder(STROKE_ANGULAR_STEP);
+        Geometry::StrokeSimplifier strokeSimplifier(simplify_tolerance);
+        Geometry::StrokeArena raw_points;
+        strokeBuilder.setSimplifier(&strokeSimplifier);
+        if(keep_raw){
+            fill_strip_vector(raw_points);
+            strokeBuilder.setRawOutput(&raw_points);
+        }
 
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
-        glEnableVertexAttribArray(1);
+        /* The drawing is unfolded vertex by vertex as it grows, for the preview and for saved projections.
+           Only the floating last vertex of a simplified stroke changes in place */
+        Geometry::IncrementalUnfolder unfolder;
+        size_t stroke_tail = strokeSimplifier.getTolerance() > 0.0 ? 1 : 0;
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        /* The last unfolded drawing, kept for the vector export */
+        Geometry::StrokeBuffer unfolded;
 
-        /* Creating vectors for storing drawings and their backup*/
-        std::vector<std::vector<double>> points_to_draw, t_points_to_draw;
-        std::vector<std::vector<double>>& user_vertices = points_to_draw;
+        /* Restoring the last drawing of the session log: the positions are uploaded straight from the mapped file */
+        Geometry::SessionWriter sessionWriter;
+        if(!session_path.empty()){
+            Geometry::SessionReader sessionReader;
+            if(std::filesystem::exists(session_path) && sessionReader.open(session_path)){
+                size_t drawing = sessionReader.getDrawingCount() - 1;
+                points_to_draw.clear();
+                sessionReader.appendToStrips(points_to_draw, drawing);
+                for(const Geometry::SessionReader::Record& record : sessionReader.getRecords()){
+                    if(record.drawing == drawing){
+                        strokeStore.appendVertices(record.x, record.y, record.z, record.count, record.color.r, record.color.g, record.color.b, !record.continues);
+                    }
+                }
+                if(keep_raw){
+                    raw_points.clear();
+                    sessionReader.appendToStrips(raw_points, drawing);
+                    /* Both hold the strokes of the log in order, the raw ones are found by the ids of the drawn ones */
+                    for(size_t strip = 0; strip < raw_points.size() && strip < points_to_draw.size(); ++strip){
+                        raw_points.setStrokeId(strip, points_to_draw.strokeId(strip));
+                    }
+                    fill_strip_vector(raw_points);
+                }
+                std::cout << "Restored " << points_to_draw.size() << " strokes from " << session_path << "\n";
+            }
+            if(sessionWriter.open(session_path)){
+                sessionWriter.setLogged(keep_raw ? raw_points : points_to_draw);
+            }
+        }
         fill_strip_vector(points_to_draw);
 
+        /* States of the drawing after every stroke, erase and clear. They share the unchanged strokes with each
+           other and with the drawing, see Geometry::StrokeArena::Snapshot */
+        Geometry::DrawingHistory history(HISTORY_DEPTH);
+        Geometry::StrokeArena* raw_history = keep_raw ? &raw_points : nullptr;
+        history.commit(points_to_draw, raw_history);
+        /* Segments were erased since the last state */
+        bool erased = false;
+
+        /* The saved projection being unfolded, if any */
+        std::unique_ptr<PhotoJob> photo_job;
+        /* The vector copy of the last save, while the encoder queue has no room for it */
+        std::function<void()> vector_job;
+
+        /* Segments of the sphere strokes binned by direction: only the visible bins are drawn, and the eraser
+           finds the segments under the crosshair without walking the whole drawing */
+        Geometry::SphereIndex strokeIndex, rawIndex;
+        /* Vertex ranges of the visible bins, reused between frames */
+        std::vector<Geometry::StripRange> visible_strokes;
+
         /* Variables for counting number of saved projections and indicator of the mode of rendering(sphere, cylinder, and plane)*/
         int num_of_saved_projections = -1, render_num = 0;
         
@@ -193,108 +454,226 @@ int main(int argc, char** argv)
             } 
         }
 
-        /* Initial projection is perspective */
-        glm::mat4 projection_t = glm::perspective(glm::radians(fov), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
+        /* Initial projection is perspective, the orthogonal one is used to "take a photo" of the unfolded drawing */
+        bool plane_view = false;
+        /* The view of a tiled save, the camera may move before its last band is drawn */
+        glm::mat4 tiled_view_t(1.0f);
 
-        /* Code for debuging(FPS metric) */
-        // int fps_to_show_counter = 0;
-        // double fps_sum_to_avg = 0.0f;
-        
         /* Loop until the user closes the window */
         while (!glfwWindowShouldClose(window)) 
         {
+            /* The loop may have been waiting for events for a long time, that must not turn into a camera jump */
             float currentFrame = static_cast<float>(glfwGetTime());
-            deltaTime = currentFrame - lastFrame;
+            deltaTime = std::min(currentFrame - lastFrame, 0.1f);
             lastFrame = currentFrame;
 
-            /* Code for debuging(FPS metric) */
-            // if(fps_to_show_counter % 50 == 0){
-            //     std::cout << "FPS:" << fps_sum_to_avg / 50 << "\n";
-            //     fps_sum_to_avg = 0.0f;
-            // }           
-            // fps_sum_to_avg += 1.0f / deltaTime;
-            // fps_to_show_counter++;
+            /* Frame profiling: stage timings go into a ring that is written out when profiling is switched off */
+            Utils::Profiler& profiler = Utils::Profiler::global();
+            if(toggle_profiler){
+                toggle_profiler = false;
+                if(profiler.isEnabled()){
+                    dumpProfile();
+                    profiler.setEnabled(false);
+                }
+                else{
+                    profiler.clear();
+                    profiler.setEnabled(true);
+                }
+            }
+            profiler.beginFrame();
+            gpuTimer.collect();
+            PROFILE_SCOPE("frame");
 
             /* Processing input */
-            processInput(window, points_to_draw);
-
-            /* Clearing the buffer */
-            glClearColor(0.f, 0.f, 0.f, 1.f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            /* Choosing the program to render */
-            defaultShaderProgram->use();           
+            {
+                PROFILE_SCOPE("processInput");
+                processInput(window);
+
+                /* Strokes from the orientation samples captured since the previous frame */
+                InputEvent event;
+                while(input_events.pop(event)){
+                    frameScheduler.markDirty(Renderer::FrameScheduler::Strokes);
+                    if(event.type == InputEvent::Press){
+                        strokeBuilder.begin(points_to_draw, event.sample);
+                    }
+                    else if(event.type == InputEvent::Move){
+                        if(strokeBuilder.isDrawing()){
+                            strokeBuilder.add(points_to_draw, event.sample);
+                        }
+                    }
+                    else if(strokeBuilder.isDrawing()){
+                        strokeBuilder.end(points_to_draw, event.sample);
+                        history.commit(points_to_draw, raw_history);
+                    }
+                }
+                /* The camera can also move(WASD) without any mouse motion */
+                if(strokeBuilder.isDrawing() && left_pressed){
+                    strokeBuilder.add(points_to_draw, {glm::dvec3(cameraPos), glm::dvec3(cameraFront), glfwGetTime()});
+                    frameScheduler.markDirty(Renderer::FrameScheduler::Strokes);
+                }
+            }
 
-            /* If it is needed to clear the drawing and reset camera position and orientation */
-            if(to_clear){
-                t_points_to_draw.clear();
+            /* If it is needed to clear the drawing and reset camera position and orientation. The cleared drawing
+               stays in the history. A tiled save keeps the scene until its last band is drawn */
+            if(to_clear && !tiledRenderer.isRendering()){
                 points_to_draw.clear();
+                raw_points.clear();
+                if(keep_raw){
+                    fill_strip_vector(raw_points);
+                }
                 fill_strip_vector(points_to_draw);
+                strokeStore.reset();
+                previewStore.reset();
+                unfolder.reset();
+                sessionWriter.clear();
+                strokeIndex.reset();
+                rawIndex.reset();
+                unfolded.clear();
+                strokeBuilder.cancel();
                 cameraPos = glm::vec3(0.0f, camera_y_shift, 0.0f);
                 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 
-                projection_t = glm::perspective(glm::radians(fov), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
-                to_clear = save_render = false;
+                if(photo_job){
+                    photo_job->dropped = true;
+                }
+                plane_view = false;
+                to_clear = save_render = erased = false;
+                history.commit(points_to_draw, raw_history);
+                frameScheduler.markDirty(Renderer::FrameScheduler::All);
             }
 
-            if(save_render && points_to_draw[1].size() != 0){
-                t_points_to_draw = points_to_draw;
+            /* Strips changed in the middle(erasing, undo): only they are uploaded and unfolded again, and the log
+               gets edits of the strokes they belong to */
+            auto applyChanges = [&](const Geometry::StrokeChanges& changes, const Geometry::StrokeChanges& rawChanges){
+                const Geometry::StrokeChanges& drawn_changes = keep_raw ? rawChanges : changes;
+                Geometry::StrokeChanges unfolded_changes;
+                strokeStore.apply(points_to_draw, changes);
+                unfolder.apply(keep_raw ? raw_points : points_to_draw, drawn_changes, unfolded_changes);
+                previewStore.apply(unfolder.getStrips(), unfolded_changes);
+                sessionWriter.apply(keep_raw ? raw_points : points_to_draw, drawn_changes);
+                frameScheduler.markDirty(Renderer::FrameScheduler::Strokes);
+            };
+
+            /* Undo/redo, not in the middle of a stroke or an erase. The restored strips share their extents with
+               the state, and only the strips that differ from it are replaced */
+            if(history_step != 0){
+                if(!plane_view && !strokeBuilder.isDrawing() && !(eraser_mode && left_pressed)){
+                    if(erased){
+                        history.commit(points_to_draw, raw_history);
+                        erased = false;
+                    }
+                    Geometry::StrokeChanges changes, raw_changes;
+                    if(history_step < 0 ? history.undo(points_to_draw, raw_history, &changes, &raw_changes) :
+                                          history.redo(points_to_draw, raw_history, &changes, &raw_changes)){
+                        strokeIndex.apply(points_to_draw, changes, stroke_tail);
+                        if(keep_raw){
+                            rawIndex.apply(raw_points, raw_changes);
+                        }
+                        if(!changes.empty() || !raw_changes.empty()){
+                            applyChanges(changes, raw_changes);
+                        }
+                    }
+                }
+                history_step = 0;
+            }
 
-                /* Transforming the coordinates of the vertices from "sphere" to "cylinder" view*/
-                for (int strip_num = 1; strip_num < t_points_to_draw.size(); ++strip_num){
-                    std::vector<double>* strip = t_points_to_draw.data() + strip_num;
-                    for(int v_num = 0; v_num < strip->size(); v_num += 6){
-                        double x = (*strip)[v_num], y = (*strip)[v_num + 1] - camera_y_shift, z = (*strip)[v_num + 2];
-                        double xzPlaneDistance = glm::distance(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(x, 0.0f, z));
-                        double y_angle = glm::degrees(glm::asin(y / S_RADIUS));
+            /* While a saved projection is shown the strips hold the unfolded drawing, which is not indexed */
+            if(!plane_view){
+                PROFILE_SCOPE("index");
+                strokeIndex.sync(points_to_draw, stroke_tail);
+                if(keep_raw){
+                    rawIndex.sync(raw_points);
+                }
 
-                        (*strip)[v_num] = x / xzPlaneDistance * S_RADIUS;
-                        (*strip)[v_num + 1] = PI * S_RADIUS / 2 * y_angle / 90 + camera_y_shift;
-                        (*strip)[v_num + 2] = z / xzPlaneDistance * S_RADIUS;
+                if(eraser_mode && left_pressed){
+                    glm::dvec3 direction = glm::dvec3(cameraPos + cameraFront * (float)S_RADIUS) - glm::dvec3(0.0, camera_y_shift, 0.0);
+                    Geometry::StrokeChanges changes, raw_changes;
+                    if(erase_stroke){
+                        /* Once per click. The raw strips are split differently by erasing, the picked stroke is found
+                           in them by its id */
+                        Geometry::StrokeHit hit;
+                        if(strokeIndex.pick(points_to_draw, direction, PICK_RADIUS, hit)){
+                            uint32_t stroke_id = points_to_draw.strokeId(hit.strip);
+                            strokeIndex.eraseStroke(points_to_draw, stroke_id, &changes);
+                            if(keep_raw){
+                                rawIndex.eraseStroke(raw_points, stroke_id, &raw_changes);
+                            }
+                        }
+                        erase_stroke = false;
+                    }
+                    else{
+                        strokeIndex.erase(points_to_draw, direction, ERASER_RADIUS, stroke_tail, &changes);
+                        if(keep_raw){
+                            rawIndex.erase(raw_points, direction, ERASER_RADIUS, 0, &raw_changes);
+                        }
+                    }
+
+                    if(!changes.empty() || !raw_changes.empty()){
+                        applyChanges(changes, raw_changes);
+                        erased = true;
                     }
                 }
+                /* One state per drag of the eraser */
+                else if(erased){
+                    history.commit(points_to_draw, raw_history);
+                    erased = false;
+                }
+            }
 
-                for (int strip_num = 1; strip_num < t_points_to_draw.size(); ++strip_num){
-                    std::vector<double>* strip = t_points_to_draw.data() + strip_num;
-                    for(int v_num = 6; v_num < strip->size(); v_num += 6){
-                        double x_curr = (*strip)[v_num], x_prev = (*strip)[v_num - 6], y_curr = (*strip)[v_num + 1], y_prev = (*strip)[v_num - 5];;
-                        double z_curr = (*strip)[v_num + 2], z_prev = (*strip)[v_num - 4];
-                        int x_curr_sgn = int(std::signbit(x_curr)), x_prev_sgn = int(std::signbit(x_prev));
-                        if(z_curr > 0.00001f && x_curr_sgn + x_prev_sgn == 1){
-                            double z_inter = -x_curr * (z_prev - z_curr) / (x_prev - x_curr) + z_curr;
-                            double y_inter = -x_curr * (y_prev - y_curr) / (x_prev - x_curr) + y_curr;
-
-                            if(x_prev_sgn){
-                                strip->insert(strip->begin() + v_num, -0.000001f);
-                            }
-                            else{
-                                strip->insert(strip->begin() + v_num, 0.000001f);
-                            }
-                            strip->insert(strip->begin() + v_num + 1, y_inter);
-                            strip->insert(strip->begin() + v_num + 2, z_inter);
-                            strip->insert(strip->begin() + v_num + 3, (*strip)[v_num - 3]);
-                            strip->insert(strip->begin() + v_num + 4, (*strip)[v_num - 2]);
-                            strip->insert(strip->begin() + v_num + 5, (*strip)[v_num - 1]);
-                            
-                            std::vector<double> strip_piece(strip->begin() + v_num, strip->end());
-                            strip_piece[0] *= -1.0f;
-
-                            while(strip->size() != v_num + 6){
-                                strip->pop_back();
-                            }
-                            t_points_to_draw.insert(t_points_to_draw.begin() + strip_num + 1, strip_piece);
-                        }                           
+            /* Transforming the new vertices from "sphere" to "cylinder" view, splitting them on the seam, and
+               projecting them on a plane */
+            {
+                PROFILE_SCOPE("unfold");
+                unfolder.sync(keep_raw ? raw_points : points_to_draw, keep_raw ? 0 : stroke_tail);
+            }
+            {
+                PROFILE_SCOPE("sessionLog");
+                sessionWriter.sync(keep_raw ? raw_points : points_to_draw, keep_raw ? 0 : stroke_tail);
+            }
+
+            /* The photo is unfolded from a snapshot on an encoder thread(no vertex is copied on this one), the user
+               keeps drawing meanwhile. The cylinder projection is the one the unfolder keeps up to date, its strips
+               are only packed. While the queue is full the save request just stays pending for the next frames */
+            if(save_render && !photo_job && !plane_view && points_to_draw[0].size() != 0){
+                PROFILE_SCOPE("snapshot");
+                bool unfolded_already = projection == Geometry::Projection::Cylinder;
+                photo_job = std::make_unique<PhotoJob>();
+                photo_job->drawing = unfolded_already ? unfolder.snapshot() : (keep_raw ? raw_points : points_to_draw).snapshot();
+                if(!encoders.trySubmit([job = photo_job.get(), projection = projection, unfolded_already](){
+                    job->unfolded = Geometry::StrokeBuffer::fromStrips(job->drawing);
+                    if(!unfolded_already){
+                        Geometry::unfold(job->unfolded, projection);
                     }
+                    job->done.store(true, std::memory_order_release);
+                })){
+                    photo_job.reset();
                 }
-                
-                /* At this moment all vertices are preprocessed and can be projected on a plane*/
-                project_points(t_points_to_draw);
-                
-                /* Configuring and applying orthogonal projection to "take a photo" of a drawing */
-                projection_t = glm::ortho(-aspect * scale, aspect * scale, -scale, scale, 0.0f, 1.0f);
-                cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+            }
 
-                user_vertices = t_points_to_draw;
+            /* While every readback slot is busy the photo waits for the next frames */
+            if(photo_job && photo_job->done.load(std::memory_order_acquire) && (photo_job->dropped || exporter.canCapture())){
+                PROFILE_SCOPE("takePhoto");
+                if(!photo_job->dropped){
+                    unfolded = std::move(photo_job->unfolded);
+                    photo_scale = projection == Geometry::Projection::Cylinder ? scale :
+                        Geometry::fitHalfHeight(projection, (float)export_width / (float)export_height);
+
+                    /* Switching to the orthogonal projection to "take a photo" of a drawing */
+                    plane_view = true;
+                    cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+
+                    /* The photo replaces the scene on the GPU only, it is uploaded straight from the unfolded buffer
+                       while the drawing stays where it is */
+                    strokeStore.reset();
+                    for(size_t stroke = 0; stroke < unfolded.strokeCount(); ++stroke){
+                        size_t begin = unfolded.strokeBegin(stroke);
+                        const Geometry::StrokeColor& color = unfolded.colors[stroke];
+                        strokeStore.appendVertices(unfolded.x.data() + begin, unfolded.y.data() + begin, unfolded.z.data() + begin,
+                                                   unfolded.strokeSize(stroke), color.r, color.g, color.b, true);
+                    }
+                    frameScheduler.markDirty(Renderer::FrameScheduler::Projection | Renderer::FrameScheduler::Strokes);
+                }
+                photo_job.reset();
             }
 
             /* Creating transformaiton matrices: model->world, world->view, view->crop&projection */
@@ -304,61 +683,233 @@ int main(int argc, char** argv)
             /* "Moving" the target box a little bit further from the camera*/
             world_t = glm::translate(world_t, glm::vec3(0.0f, 0.4f, -3.0f));
 
-            defaultShaderProgram->setMat4("world_t", world_t);
-            defaultShaderProgram->setMat4("view_t", view_t);
-            defaultShaderProgram->setMat4("projection_t", projection_t);
-
-            /* Binding vertex and atribute buffers and confiuring them to work with box model */
-            glBindVertexArray(VAO);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
-
-            /* Render target box */
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            /* Binds the line program for the current viewport(the window, a preview pane, or an export tile), returns its size */
+            auto useLineProgram = [&](int unfoldMode){
+                GLint viewport[4];
+                glGetIntegerv(GL_VIEWPORT, viewport);
+                lineShaderProgram->use();
+                lineShaderProgram->setMat4(line_world_t_location, glm::mat4(1.0f));
+                lineShaderProgram->setInt(line_mode_location, unfoldMode);
+                lineShaderProgram->setVec2f(line_viewport_location, (float)viewport[2], (float)viewport[3]);
+
+                /* Overlapping edges of neighbouring segments must not hide each other */
+                glEnable(GL_BLEND);
+                glDepthMask(GL_FALSE);
+                return glm::vec2((float)viewport[2], (float)viewport[3]);
+            };
+            auto endLines = [&](){
+                glDepthMask(GL_TRUE);
+                glDisable(GL_BLEND);
+            };
+
+            /* The whole scene for a given projection, drawn to the window and to export targets */
+            auto drawScene = [&](const glm::mat4& projection){
+                /* Clearing the buffer */
+                glClearColor(0.f, 0.f, 0.f, 1.f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                /* Choosing the program to render */
+                defaultShaderProgram->use();
+
+                cameraUniforms.update(view_t, projection);
+                defaultShaderProgram->setMat4(world_t_location, world_t);
+
+                /* Render target box */
+                box.draw();
+
+                /* Reset model->world transformation matrix for rendering the floor and drown lines */
+                defaultShaderProgram->setMat4(world_t_location, glm::mat4(1.0f));
+                floor.draw();
+
+                /* Saved projections replace the strokes with the unfolded ones already */
+                int unfold_mode = plane_view ? 0 : stroke_mode;
+                if(lineShaderProgram){
+                    glm::vec2 viewport = useLineProgram(unfold_mode);
+                    if(unfold_mode == 0 && !plane_view){
+                        /* The frustum is widened by the half width of the lines, segments just outside it still have visible edges */
+                        glm::vec2 margin = viewport / (viewport + LINE_WIDTH + 2.0f);
+                        visible_strokes.clear();
+                        strokeIndex.collectVisible(glm::scale(glm::mat4(1.0f), glm::vec3(margin, 1.0f)) * projection * view_t, visible_strokes);
+                        strokeStore.drawLineRanges(visible_strokes);
+                    }
+                    else{
+                        strokeStore.drawLines(unfold_mode != 0);
+                    }
+                    endLines();
+                    return;
+                }
+                if(stroke_mode != 0 && !plane_view && unfoldShaderProgram){
+                    unfoldShaderProgram->use();
+                    unfoldShaderProgram->setMat4(unfold_world_t_location, glm::mat4(1.0f));
+                    unfoldShaderProgram->setInt(unfold_mode_location, stroke_mode);
+                }
 
-            /* Reset model->world transformation matrix for rendering drown lines */
-            defaultShaderProgram->setMat4("world_t", glm::mat4(1.0f));
+                /* Strokes on the sphere are culled by the bins of the index, the unfolded ones are not indexed */
+                if(stroke_mode == 0 && !plane_view){
+                    visible_strokes.clear();
+                    strokeIndex.collectVisible(projection * view_t, visible_strokes);
+                    strokeStore.drawRanges(GL_LINE_STRIP, visible_strokes);
+                }
+                else{
+                    strokeStore.draw(GL_LINE_STRIP);
+                }
+            };
+
+            /* The unfolded drawing on the plane z = -S_RADIUS, seen from the sphere center */
+            auto drawPreview = [&](int x, int width, int height){
+                glViewport(x, 0, width, height);
+                glEnable(GL_SCISSOR_TEST);
+                glScissor(x, 0, width, height);
+                glClearColor(0.08f, 0.08f, 0.08f, 1.f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glDisable(GL_SCISSOR_TEST);
+
+                /* Unfolded x spans [-PI, PI], y the height of the cylinder around the camera */
+                float pane_aspect = (float)width / (float)height;
+                float half_height = 1.05f * std::max((float)Geometry::PI / pane_aspect, (float)(Geometry::PI * S_RADIUS / 2));
+                glm::vec3 center = glm::vec3(0.0f, camera_y_shift, 0.0f);
+                cameraUniforms.update(glm::lookAt(center, center + glm::vec3(0.0f, 0.0f, -1.0f), cameraUp),
+                                      glm::ortho(-half_height * pane_aspect, half_height * pane_aspect, -half_height, half_height, 0.0f, 1.0f));
+
+                /* With the GPU preview the sphere strokes are unfolded by the shader, while a saved projection
+                   is shown they are unfolded already */
+                if(lineShaderProgram){
+                    useLineProgram(gpu_preview && !plane_view ? 2 : 0);
+                    (gpu_preview ? strokeStore : previewStore).drawLines(gpu_preview && !plane_view);
+                    endLines();
+                    return;
+                }
+                if(gpu_preview && !plane_view){
+                    unfoldShaderProgram->use();
+                    unfoldShaderProgram->setMat4(unfold_world_t_location, glm::mat4(1.0f));
+                    unfoldShaderProgram->setInt(unfold_mode_location, 2);
+                }
+                else{
+                    defaultShaderProgram->use();
+                    defaultShaderProgram->setMat4(world_t_location, glm::mat4(1.0f));
+                }
+                (gpu_preview ? strokeStore : previewStore).draw(GL_LINE_STRIP);
+            };
+
+            /* Nothing changed since the last frame: the picture on the screen is still right */
+            int fb_width = 0, fb_height = 0;
+            glfwGetFramebufferSize(window, &fb_width, &fb_height);
+            if(frameScheduler.takeDirty() != 0 && fb_width > 0 && fb_height > 0){
+                /* Upload only what was drawn since the previous frame and render all strips with one call */
+                {
+                    PROFILE_SCOPE("upload");
+                    if(!plane_view){
+                        strokeStore.sync(points_to_draw, stroke_tail);
+                    }
+                    if(split_view && !gpu_preview){
+                        /* Seam pieces changed in place can lie before the last strip, start over from there */
+                        size_t changed_strip, changed_vertex;
+                        if(unfolder.takeChanged(changed_strip, changed_vertex)){
+                            previewStore.rewind(changed_strip, changed_vertex);
+                        }
+                        previewStore.sync(unfolder.getStrips());
+                    }
+                }
+                {
+                    PROFILE_SCOPE("draw");
+                    Renderer::GpuScope gpuScope(gpuTimer, "draw");
+
+                    /* The sphere view takes the left half of the window when the preview is shown */
+                    int scene_width = split_view ? fb_width / 2 : fb_width;
+                    float scene_aspect = (float)scene_width / (float)fb_height;
+                    glm::mat4 projection_t = plane_view ?
+                        glm::ortho(-scene_aspect * photo_scale, scene_aspect * photo_scale, -photo_scale, photo_scale, 0.0f, 1.0f) :
+                        glm::perspective(glm::radians(fov), scene_aspect, 0.1f, 100.0f);
+
+                    glViewport(0, 0, scene_width, fb_height);
+                    drawScene(projection_t);
+                    if(split_view){
+                        drawPreview(scene_width, fb_width - scene_width, fb_height);
+                    }
+                    glViewport(0, 0, fb_width, fb_height);
+                }
 
-            bool floor_render = true;
+                if(save_render && plane_view && !to_clear && !vector_job && !tiledRenderer.isRendering() && exporter.canCapture() && tiledRenderer.canStart())
+                {
+                    PROFILE_SCOPE("saveImage");
+                    /* Name(path) of the rendered image*/
+                    std::string render_name = "../renders/render" + std::to_string(++num_of_saved_projections) + ".png";
+                
+                    {
+                        Renderer::GpuScope gpuScope(gpuTimer, "saveImage");
+                        saveImage(exporter, tiledRenderer, exportTarget, render_name, export_width, export_height, drawScene);
+                    }
+                    tiled_view_t = view_t;
+
+                    /* The polylines are exact already, they are written directly without rendering anything, on an
+                       encoder thread that takes the unfolded buffer over(the drawing is cleared next anyway). While
+                       the queue is full the job stays pending for the next frames */
+                    if(export_vector == "svg" || export_vector == "spl"){
+                        std::string vector_name = render_name.substr(0, render_name.size() - 3) + export_vector;
+                        auto strokes = std::make_shared<const Geometry::StrokeBuffer>(std::move(unfolded));
+                        vector_job = [vector_name, strokes, svg = export_vector == "svg"](){
+                            if(!(svg ? Export::writeSvg(vector_name, *strokes) : Export::writePolylines(vector_name, *strokes))){
+                                std::cout << "Failed to save " << vector_name << "\n";
+                            }
+                        };
+                    }
+                
+                    /* The scene is reset on the next frame, or after the last band of a tiled save */
+                    to_clear = true;
+                    frameScheduler.markDirty(Renderer::FrameScheduler::All);
+                }
 
-            /* Loop over the all... things to render (floor and line pieces) */
-            for (std::vector<double> strip : user_vertices){
-                if(strip.size() != 0){
-                    glBufferData(GL_ARRAY_BUFFER, sizeof(double) * strip.size(), strip.data(), GL_DYNAMIC_DRAW);
-                    glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 6*sizeof(double), (void*)0);
-                    glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 6*sizeof(double), (void*)(3*sizeof(double)));
+                /* One band of a tiled save per frame, drawn with the view of the photo */
+                if(tiledRenderer.isRendering()){
+                    PROFILE_SCOPE("saveTiles");
+                    Renderer::GpuScope gpuScope(gpuTimer, "saveTiles");
+                    view_t = tiled_view_t;
+                    tiledRenderer.renderBand(exportTarget, drawScene);
+                    frameScheduler.markDirty(Renderer::FrameScheduler::Export);
+                }
 
-                    if(floor_render){
-                        glDrawArrays(GL_TRIANGLE_STRIP, 0, strip.size() / 6);
-                        floor_render = false;
-                    }
-                    else{
-                        glDrawArrays(GL_LINE_STRIP, 0, strip.size() / 6);
-                    } 
+                /* Swap front and back buffers */
+                {
+                    PROFILE_SCOPE("swapBuffers");
+                    glfwSwapBuffers(window);
                 }
             }
 
-            if(save_render)
+            /* Hand finished readbacks over to the encoder threads */
             {
-                /* Name(path) of the rendered image*/
-                std::string render_name = "../renders/render" + std::to_string(++num_of_saved_projections) + ".png";
-                
-                saveImage(render_name.c_str(), window);
-                
-                to_clear = true;
+                PROFILE_SCOPE("exportPoll");
+                exporter.poll();
+                tiledRenderer.poll();
+                if(vector_job && encoders.trySubmit(vector_job)){
+                    vector_job = nullptr;
+                }
             }
 
-            /* Swap front and back buffers */
-            glfwSwapBuffers(window);
+            /* A save that waited for a free readback slot or for room in the encoder queue can go now */
+            if(save_render && !photo_job && exporter.canCapture()){
+                frameScheduler.markDirty(Renderer::FrameScheduler::Export);
+            }
+
+            /* Process events, sleeping until the next one if there is nothing to draw, no readback in flight, no
+               export waiting for the encoders and no photo being unfolded. The dirty flags were taken by this frame
+               already, a held movement key or mouse button(WASD while drawing) keeps the next frames coming without
+               waiting for key repeats */
+            frameScheduler.waitEvents(exporter.getPendingCount() > 0 || tiledRenderer.getPendingCount() > 0 || vector_job || photo_job || moving || left_pressed);
+        }
 
-            /* Poll for and process events */
-            glfwPollEvents();
+        /* A photo task still reading its snapshot, and the vector copy of the last save that is not queued yet */
+        if(photo_job){
+            encoders.waitIdle();
         }
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
+        if(vector_job){
+            encoders.submit(std::move(vector_job));
+        }
+
+        /* The floating last vertex of an unfinished stroke is final now */
+        sessionWriter.sync(keep_raw ? raw_points : points_to_draw);
+    }
+    if(Utils::Profiler::global().isEnabled()){
+        dumpProfile();
     }
     glfwTerminate();
     return 0;
@@ -366,6 +917,12 @@ int main(int argc, char** argv)
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height){
     glViewport(0, 0, width, height);
+    frameScheduler.markDirty(Renderer::FrameScheduler::Window);
+}
+
+void window_refresh_callback(GLFWwindow *window){
+    /* The window was exposed or damaged and its contents have to be drawn again */
+    frameScheduler.markDirty(Renderer::FrameScheduler::Window);
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
@@ -402,97 +959,90 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     front.y = sin(glm::radians(pitch));
     front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
     cameraFront = glm::normalize(front);
+    frameScheduler.markDirty(Renderer::FrameScheduler::Camera);
+
+    if(left_pressed && !eraser_mode){
+        pushInputEvent(InputEvent::Move);
+    }
 } 
 
-void saveImage(const char* filepath, GLFWwindow* window) {
- int width, height;
- glfwGetFramebufferSize(window, &width, &height);
- GLsizei nrChannels = 3;
- GLsizei stride = nrChannels * width;
- GLsizei bufferSize = stride * height;
- std::vector<char> buffer(bufferSize);
- glPixelStorei(GL_PACK_ALIGNMENT, 4);
- glReadBuffer(GL_BACK);
- glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, buffer.data());
- stbi_flip_vertically_on_write(true);
- stbi_write_png(filepath, width, height, nrChannels, buffer.data(), stride);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    /* Left mouse button - draw */
+    if(button != GLFW_MOUSE_BUTTON_LEFT){
+        return;
+    }
+    frameScheduler.markDirty(Renderer::FrameScheduler::Strokes);
+
+    /* The eraser works in the frame loop while the button is held, no strokes are drawn */
+    if(eraser_mode){
+        if(action == GLFW_PRESS){
+            left_pressed = true;
+            erase_stroke = (mods & GLFW_MOD_SHIFT) != 0;
+        }
+        else if(action == GLFW_RELEASE){
+            left_pressed = erase_stroke = false;
+        }
+        return;
+    }
+    if(action == GLFW_PRESS){
+        left_pressed = true;
+        pushInputEvent(InputEvent::Press);
+    }
+    else if(action == GLFW_RELEASE && left_pressed){
+        left_pressed = false;
+        pushInputEvent(InputEvent::Release);
+    }
+}
+
+void pushInputEvent(InputEvent::Type type){
+    InputEvent event;
+    event.type = type;
+    event.sample.center = glm::dvec3(cameraPos);
+    event.sample.direction = glm::dvec3(cameraFront);
+    event.sample.time = glfwGetTime();
+    /* The queue only overflows if frames stall for seconds, the motion is dropped then(the stroke goes straight on) */
+    input_events.push(event);
 }
 
-void fill_strip_vector(std::vector<std::vector<double>>& strips){
-    /* Just add the floor to a scene for more comfortable orientation in the environment*/
-    std::vector<double> floor{
-         10.0f, -0.1f,  10.0f,      0.0f, 0.0f, 0.0f,
-         10.0f, -0.1f, -10.0f,      0.5f, 0.5f, 0.5f,
-        -10.0f, -0.1f, -10.0f,      1.0f, 1.0f, 1.0f,
-        -10.0f, -0.1f,  10.0f,      0.5f, 0.5f, 0.5f,
-         10.0f, -0.1f,  10.0f,      0.0f, 0.0f, 0.0f
-    }, strip;
-    strips.push_back(floor);
-    strips.push_back(strip);
+void saveImage(Renderer::ImageExporter& exporter, Renderer::TiledRenderer& tiledRenderer, Renderer::OffscreenTarget& target, const std::string& filepath, int width, int height,
+               const std::function<void(const glm::mat4&)>& drawScene) {
+    /* Same "photo" as on the screen, but with the horizontal extent following the export's own aspect ratio */
+    float export_aspect = (float)width / (float)height;
+    Renderer::OrthoFrustum frustum = {-export_aspect * photo_scale, export_aspect * photo_scale, -photo_scale, photo_scale, 0.0f, 1.0f};
+
+    if(width <= target.getWidth() && height <= target.getHeight()){
+        /* Fits into one target: render it once and let the exporter read it back asynchronously */
+        target.bind();
+        drawScene(glm::ortho(frustum.left, frustum.right, frustum.bottom, frustum.top, frustum.zNear, frustum.zFar));
+        exporter.capture(width, height, filepath);
+        target.unbind();
+    }
+    /* Larger ones are drawn band by band over the next frames */
+    else if(!tiledRenderer.start(width, height, frustum, filepath)){
+        std::cout << "Failed to save " << filepath << "\n";
+    }
 }
 
-void project_points(std::vector<std::vector<double>>& strips){
-    /* Unfold the surface of a cylinder */
-    for (int strip_num = 1; strip_num < strips.size(); ++strip_num){
-        std::vector<double>* strip = strips.data() + strip_num;
-        for(int v_num = 0; v_num < strip->size(); v_num += 6){
-            double x = (*strip)[v_num], z = (*strip)[v_num + 2], z_asin = glm::asin(-z / S_RADIUS);
-            if(!std::signbit(x)){
-                (*strip)[v_num] = PI / 2 - z_asin;
-            }
-            else if(x != 0.0f){
-                (*strip)[v_num] = -PI / 2 + z_asin;
-            }
-            (*strip)[v_num + 2] = -S_RADIUS;                          
-        }
-    } 
+void dumpProfile(){
+    /* CSV for spreadsheets, JSON for chrome://tracing or Perfetto */
+    Utils::Profiler& profiler = Utils::Profiler::global();
+    if(profiler.writeCsv("profile.csv") && profiler.writeChromeTrace("profile.json")){
+        std::cout << "Profile written to profile.csv and profile.json\n";
+    }
 }
 
-void processInput(GLFWwindow *window, std::vector<std::vector<double>>& p_to_draw){
+void fill_strip_vector(Geometry::StrokeArena& strips){
+    /* The drawing starts with one empty strip that collects vertices while the left mouse button is held */
+    strips.addStroke();
+}
+
+void processInput(GLFWwindow *window){
     /* Esc - exit the program*/
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS){
         // saveImage("render.png", window);
         glfwSetWindowShouldClose(window, true);
     }
-    /* Left mouse button - draw*/
-    if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS){
-        bool push = true;
-        double x_pos, y_pos, z_pos, dir_lenght;
-
-        left_pressed = true;
-        dir_lenght = glm::length(cameraFront);
-        x_pos = cameraPos.x + cameraFront.x / dir_lenght * S_RADIUS;
-        y_pos = cameraPos.y + cameraFront.y / dir_lenght * S_RADIUS;
-        z_pos = cameraPos.z + cameraFront.z / dir_lenght * S_RADIUS; 
-        std::vector<double>& last_strip = p_to_draw[p_to_draw.size() - 1];
-        if(!last_strip.empty()){
-            push = false;
-            double last_x, last_y, last_z;
-            last_x = last_strip[last_strip.size() - 6];
-            last_y = last_strip[last_strip.size() - 5];
-            last_z = last_strip[last_strip.size() - 4];
-            /* Calculating distance to not to spam same vertices in the strip */
-            double distance = glm::distance(glm::vec3(x_pos, y_pos, z_pos), glm::vec3(last_x, last_y, last_z));
-            if (distance > 0.0001f){
-                push = true;
-            }
-        }
-        if(push){
-            last_strip.push_back(x_pos); // X
-            last_strip.push_back(y_pos); // Y
-            last_strip.push_back(z_pos); // Z
-
-            last_strip.push_back(1.f); // R
-            last_strip.push_back(1.0f); // G
-            last_strip.push_back(1.0f); // B
-        }
-    }
-    /* If the left mouse button was released - create a new line strip */
-    if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE && left_pressed){
-        left_pressed = false;
-        std::vector<double> new_strip;
-        p_to_draw.push_back(new_strip);
-    }
     /* If P button was pressed and released - change perspective(mode - will be changed)*/
     if(glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS){
        p_pressed = true; 
@@ -500,14 +1050,72 @@ void processInput(GLFWwindow *window, std::vector<std::vector<double>>& p_to_dra
     if(glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE && p_pressed){
        p_pressed = false;
        save_render = true; 
+       frameScheduler.markDirty(Renderer::FrameScheduler::Export);
+    }
+    /* F9 - start/stop frame profiling, stopping writes the profile */
+    if(glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS){
+        f9_pressed = true;
+    }
+    /* V - show/hide the unfolded preview */
+    if(glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS){
+        v_pressed = true;
+    }
+    if(glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE && v_pressed){
+        v_pressed = false;
+        split_view = !split_view;
+        frameScheduler.markDirty(Renderer::FrameScheduler::Window);
+    }
+    if(glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS){
+        m_pressed = true;
+    }
+    if(glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE && m_pressed){
+        m_pressed = false;
+        stroke_mode = (stroke_mode + 1) % 3;
+        frameScheduler.markDirty(Renderer::FrameScheduler::Strokes);
+    }
+    /* E - switch between drawing and erasing, not in the middle of a stroke */
+    if(glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS){
+        e_pressed = true;
+    }
+    if(glfwGetKey(window, GLFW_KEY_E) == GLFW_RELEASE && e_pressed){
+        e_pressed = false;
+        if(!left_pressed){
+            eraser_mode = !eraser_mode;
+            std::cout << (eraser_mode ? "Eraser\n" : "Pen\n");
+        }
+    }
+    /* Ctrl + Z - undo, Ctrl + Y or Ctrl + Shift + Z - redo */
+    bool ctrl = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS;
+    bool shift = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS;
+    if(glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS && ctrl && !z_pressed){
+        z_pressed = true;
+        history_step = shift ? 1 : -1;
+        frameScheduler.markDirty(Renderer::FrameScheduler::Strokes);
+    }
+    if(glfwGetKey(window, GLFW_KEY_Z) == GLFW_RELEASE){
+        z_pressed = false;
+    }
+    if(glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS && ctrl && !y_pressed){
+        y_pressed = true;
+        history_step = 1;
+        frameScheduler.markDirty(Renderer::FrameScheduler::Strokes);
+    }
+    if(glfwGetKey(window, GLFW_KEY_Y) == GLFW_RELEASE){
+        y_pressed = false;
+    }
+    if(glfwGetKey(window, GLFW_KEY_F9) == GLFW_RELEASE && f9_pressed){
+        f9_pressed = false;
+        toggle_profiler = true;
     }
     /* If C button pressed - reset the scene*/
     if(glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS){
         to_clear = true;
+        frameScheduler.markDirty(Renderer::FrameScheduler::All);
     }
     
     /* Speed of the camera movement depends not on the computer performance... But on... FPS? */
     float cameraSpeed = static_cast<float>(2.5 * deltaTime);
+    glm::vec3 lastCameraPos = cameraPos;
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         cameraPos += cameraSpeed * cameraFront;
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -516,4 +1124,10 @@ void processInput(GLFWwindow *window, std::vector<std::vector<double>>& p_to_dra
         cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+
+    /* A held key moves the camera every frame without any new events, the loop must not fall asleep then */
+    moving = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS ||
+             glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    if (moving || cameraPos != lastCameraPos)
+        frameScheduler.markDirty(Renderer::FrameScheduler::Camera);
 }
\ No newline at end of file